@@ -0,0 +1,98 @@
+#include "alloc_counter.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local bool counting = false;
+thread_local AllocationCounter::Counts counts;
+
+void* allocate(size_t size) {
+    if (counting) {
+        counts.allocations++;
+        counts.bytes += size;
+    }
+    if (void* p = std::malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* allocateAligned(size_t size, std::align_val_t alignment) {
+    if (counting) {
+        counts.allocations++;
+        counts.bytes += size;
+    }
+    const size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+#if defined(_WIN32)
+    if (void* p = _aligned_malloc(size > 0 ? size : 1, align)) {
+        return p;
+    }
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, align, size > 0 ? size : 1) == 0) {
+        return p;
+    }
+#endif
+    throw std::bad_alloc();
+}
+
+void deallocate(void* p) {
+    if (p != nullptr && counting) {
+        counts.deallocations++;
+    }
+    std::free(p);
+}
+
+void deallocateAligned(void* p) {
+    if (p != nullptr && counting) {
+        counts.deallocations++;
+    }
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+}
+
+namespace AllocationCounter {
+
+void begin() {
+    counts = Counts();
+    counting = true;
+}
+
+Counts end() {
+    counting = false;
+    return counts;
+}
+
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t) noexcept { deallocateAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { deallocateAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { deallocateAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { deallocateAligned(p); }
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts what the calling thread allocates and frees through operator new
+// and delete. Linking alloc_counter.cpp replaces the global operators for
+// the whole program; threads that have not called begin() are not counted.
+namespace AllocationCounter {
+
+struct Counts {
+    size_t allocations = 0;
+    size_t bytes = 0;
+    size_t deallocations = 0;
+};
+
+// Starts counting on the calling thread, from zero
+void begin();
+// Stops counting on the calling thread and returns what it counted
+Counts end();
+
+}
@@ -0,0 +1,351 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #include <x86intrin.h>
+ #define LPMORPH_BENCH_TSC 1
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+ #include <sys/resource.h>
+#endif
+#if defined(__APPLE__)
+ #include <mach/mach.h>
+#endif
+#if defined(__linux__)
+ #include <linux/perf_event.h>
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/ioctl.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+ #include <cerrno>
+ #include <cstring>
+#endif
+
+// Helpers shared by the benchmarks
+namespace BenchSupport {
+
+// The time stamp counter where there is one, which ticks at the processor's
+// nominal frequency, and nanoseconds from steady_clock elsewhere
+inline uint64_t ticks() {
+#if defined(LPMORPH_BENCH_TSC)
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Ticks per second, measured against steady_clock over about 100 ms
+inline double calibrateTicks() {
+#if defined(LPMORPH_BENCH_TSC)
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t startTicks = ticks();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100)) {
+    }
+    const uint64_t endTicks = ticks();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return (endTicks - startTicks)/seconds;
+#else
+    return 1e9;
+#endif
+}
+
+// Keeps the calling thread on one CPU, so that caches stay warm and the
+// clock does not move between cores. Returns the CPU, or -1 where threads
+// cannot be pinned.
+inline int pinThread(int cpu) {
+#if defined(__linux__)
+    if (cpu < 0) {
+        cpu = sched_getcpu();
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        return cpu;
+    }
+#endif
+    (void) cpu;
+    return -1;
+}
+
+// The process's resident set in bytes, or 0 where it cannot be read
+inline size_t residentBytes() {
+#if defined(__linux__)
+    size_t pages = 0, residentPages = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        const int read = std::fscanf(statm, "%zu %zu", &pages, &residentPages);
+        std::fclose(statm);
+        if (read == 2) {
+            return residentPages*static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        }
+    }
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS) {
+        return static_cast<size_t>(info.resident_size);
+    }
+#endif
+    return 0;
+}
+
+// Page faults of the whole process so far, minor (served from memory) and
+// major (read from disk)
+struct PageFaults {
+    long minor = 0;
+    long major = 0;
+};
+
+inline PageFaults pageFaults() {
+    PageFaults faults;
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        faults.minor = usage.ru_minflt;
+        faults.major = usage.ru_majflt;
+    }
+#endif
+    return faults;
+}
+
+// Hardware counters for the calling thread, through perf_event_open on
+// Linux. Each event is opened on its own, so that one the processor or the
+// kernel does not offer leaves the rest working, and counts are scaled up
+// when the kernel had to multiplex them. Counters cover user space only.
+// Where none can be opened, available() is false and reason() says why.
+class PerfCounters {
+public:
+    enum Event { cycles, instructions, l1dMisses, llcMisses, branchMisses, numEvents };
+
+    PerfCounters() {
+        for (auto& fd : fds) {
+            fd = -1;
+        }
+#if defined(__linux__)
+        const uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                     | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const struct { uint32_t type; uint64_t config; } events[numEvents] = {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HW_CACHE, l1dReadMiss },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        };
+        for (int e = 0; e < numEvents; e++) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[e].type;
+            attr.config = events[e].config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fds[e] < 0 && failure.empty()) {
+                failure = std::strerror(errno);
+                if (errno == EACCES || errno == EPERM) {
+                    failure += " (see /proc/sys/kernel/perf_event_paranoid)";
+                }
+                else if (errno == ENOENT || errno == EOPNOTSUPP) {
+                    failure += " (no hardware counters, as in most virtual machines)";
+                }
+            }
+        }
+#else
+        failure = "performance counters are only read on Linux";
+#endif
+    }
+
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::string& reason() const { return failure; }
+
+    // Clears the counts and starts counting
+    void start() {
+#if defined(__linux__)
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    void stop() {
+#if defined(__linux__)
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (int e = 0; e < numEvents; e++) {
+            uint64_t data[3] = {};
+            counts[e] = -1.0;
+            if (fds[e] >= 0 && read(fds[e], data, sizeof(data)) == static_cast<ssize_t>(sizeof(data)) && data[2] > 0) {
+                counts[e] = data[1] == data[2] ? static_cast<double>(data[0]) : static_cast<double>(data[0])*data[1]/data[2];
+            }
+        }
+#endif
+    }
+
+    // The count between the last start and stop, or -1 when the event could
+    // not be counted
+    double count(Event e) const { return counts[e]; }
+
+private:
+    int fds[numEvents];
+    double counts[numEvents] = { -1.0, -1.0, -1.0, -1.0, -1.0 };
+    std::string failure;
+};
+
+// Counts from one measurement, with the number of samples they cover, for
+// reporting next to the timings
+struct CounterReadings {
+    double counts[PerfCounters::numEvents] = { -1.0, -1.0, -1.0, -1.0, -1.0 };
+    double samples = 0.0;
+
+    CounterReadings() = default;
+    CounterReadings(const PerfCounters& counters, double numSamples) : samples(numSamples) {
+        for (int e = 0; e < PerfCounters::numEvents; e++) {
+            counts[e] = counters.count(static_cast<PerfCounters::Event>(e));
+        }
+    }
+
+    // Instructions per cycle, or -1
+    double ipc() const {
+        return counts[PerfCounters::cycles] > 0.0 && counts[PerfCounters::instructions] >= 0.0
+            ? counts[PerfCounters::instructions]/counts[PerfCounters::cycles] : -1.0;
+    }
+
+    double perSample(PerfCounters::Event e) const {
+        return counts[e] >= 0.0 && samples > 0.0 ? counts[e]/samples : -1.0;
+    }
+
+    static const char* header() { return "   ipc  l1d/smp  llc/smp   br/smp"; }
+
+    // Table columns lining up with header(), "-" for what was not counted
+    std::string columns() const {
+        const double values[] = { ipc(), perSample(PerfCounters::l1dMisses), perSample(PerfCounters::llcMisses),
+                                  perSample(PerfCounters::branchMisses) };
+        const int widths[] = { 6, 8, 8, 8 };
+        std::string text;
+        for (int i = 0; i < 4; i++) {
+            char column[32];
+            if (values[i] < 0.0) {
+                std::snprintf(column, sizeof(column), " %*s", widths[i], "-");
+            }
+            else {
+                std::snprintf(column, sizeof(column), " %*.*f", widths[i], i == 0 ? 2 : 4, values[i]);
+            }
+            text += column;
+        }
+        return text;
+    }
+
+    // JSON members following others in an object, null for what was not
+    // counted
+    std::string json() const {
+        const char* names[PerfCounters::numEvents] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses" };
+        std::ostringstream out;
+        const double ratio = ipc();
+        out << ", \"ipc\": ";
+        if (ratio < 0.0) {
+            out << "null";
+        }
+        else {
+            out << ratio;
+        }
+        for (int e = 0; e < PerfCounters::numEvents; e++) {
+            out << ", \"" << names[e] << "\": ";
+            if (counts[e] < 0.0) {
+                out << "null";
+            }
+            else {
+                out << counts[e];
+            }
+        }
+        return out.str();
+    }
+};
+
+// Voiced and unvoiced stretches with pauses, so that analysis runs on
+// material with formants, noise and silent frames
+inline void makeTestSignal(std::vector<float>& samples, double sampleRate, uint32_t seed) {
+    double phase = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        seed = seed*1664525u + 1013904223u;
+        const double noise = (seed >> 8)/16777216.0 - 0.5;
+        const double t = i/sampleRate;
+        const double section = std::fmod(t, 1.0);
+        phase += 2.0*M_PI*(110.0 + 30.0*std::sin(2.0*M_PI*0.5*t))/sampleRate;
+        double voiced = 0.0;
+        for (int h = 1; h <= 12; h++) {
+            voiced += std::sin(h*phase)/h;
+        }
+        double value = section < 0.5 ? 0.2*voiced + 0.01*noise : (section < 0.8 ? 0.3*noise : 0.0);
+        samples[i] = static_cast<float>(value);
+    }
+}
+
+template <typename T>
+bool parseList(const char* text, std::vector<T>& values) {
+    values.clear();
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        std::stringstream itemStream(item);
+        T value;
+        if (!(itemStream >> value)) {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+inline std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "lpc_engine.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// What the plugin runs around LPCEngine, for the programs that drive the
+// engine without JUCE: the automation benchmark and the real-time checks
+namespace BenchSupport {
+
+// Stand-ins for the factory excitations, seven of them as in the plugin, so
+// that exType covers tables, generators and MIDI. Noise and saws of
+// different lengths, so that loops of different sizes get built.
+const int numFactoryTables = 7;
+
+inline std::vector<std::vector<double>> makeFactoryTables(double sampleRate) {
+    std::vector<std::vector<double>> tables(numFactoryTables);
+    uint32_t seed = 7;
+    for (int t = 0; t < numFactoryTables; t++) {
+        tables[t].resize(static_cast<size_t>((0.5 + 0.25*t)*sampleRate));
+        for (size_t i = 0; i < tables[t].size(); i++) {
+            seed = seed*1664525u + 1013904223u;
+            const double noise = (seed >> 8)/16777216.0 - 0.5;
+            const double saw = std::fmod(i*(80.0 + 40.0*t)/sampleRate, 1.0) - 0.5;
+            tables[t][i] = t % 2 == 0 ? noise : saw;
+        }
+    }
+    return tables;
+}
+
+// As the plugin resolves the excitation: a factory table for the first
+// types, the generators and MIDI after them
+inline LPCExcitation factoryExcitation(const std::vector<std::vector<double>>& tables, int exType) {
+    LPCExcitation excitation;
+    excitation.table = exType >= 0 && exType < static_cast<int>(tables.size()) ? &tables[exType] : nullptr;
+    excitation.numFactoryTables = static_cast<int>(tables.size());
+    return excitation;
+}
+
+// The plugin's ExcitationSegmentBuilder: a thread that rebuilds the engine's
+// excitation loop whenever Start, Length or the excitation changes. write()
+// stores the parameters and marks the loop dirty without locking, as the
+// plugin's parameter listeners do on the audio thread, and the thread checks
+// the mark every pollIntervalMs.
+class SegmentBuilderThread {
+public:
+    // The table to loop for an excitation type, or nullptr for none
+    using TableFor = std::function<const std::vector<double>*(int exType)>;
+
+    static constexpr int pollIntervalMs = 10;
+
+    SegmentBuilderThread(LPCEngine& engineToBuild, TableFor tableForType)
+        : engine(engineToBuild), tableFor(std::move(tableForType)) {}
+
+    ~SegmentBuilderThread() {
+        stop();
+    }
+
+    SegmentBuilderThread(const SegmentBuilderThread&) = delete;
+    SegmentBuilderThread& operator=(const SegmentBuilderThread&) = delete;
+
+    // Starts rebuilding from params, whose loop the caller has built
+    void start(const LPCParameters& params) {
+        stop();
+        exLen = params.exLen;
+        exStartPos = params.exStartPos;
+        exType = params.exType;
+        dirty = false;
+        running = true;
+        thread = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        running = false;
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    // Real-time safe
+    void write(const LPCParameters& params) noexcept {
+        const bool lengthChanged = exLen.exchange(params.exLen) != params.exLen;
+        const bool startChanged = exStartPos.exchange(params.exStartPos) != params.exStartPos;
+        const bool typeChanged = exType.exchange(params.exType) != params.exType;
+        if (lengthChanged || startChanged || typeChanged) {
+            dirty = true;
+        }
+    }
+
+private:
+    void run() {
+        while (running) {
+            if (dirty.exchange(false)) {
+                LPCParameters params;
+                params.exLen = exLen;
+                params.exStartPos = exStartPos;
+                params.exType = exType;
+                engine.buildExcitationSegment(tableFor(params.exType), params);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(pollIntervalMs));
+        }
+    }
+
+    LPCEngine& engine;
+    TableFor tableFor;
+    std::atomic<float> exLen{1.f};
+    std::atomic<float> exStartPos{0.f};
+    std::atomic<int> exType{0};
+    std::atomic<bool> dirty{false};
+    std::atomic<bool> running{false};
+    std::thread thread;
+};
+
+}
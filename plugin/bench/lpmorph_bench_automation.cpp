@@ -0,0 +1,369 @@
+// Times blocks while every parameter is automated, the way a host drives the
+// plugin: before each block the parameter values move, and the block runs
+// through LPCEngine exactly as processBlock does, with a background thread
+// rebuilding the excitation loop as the plugin's segment builder does (see
+// engine_harness.h). Parameter changes reach the expensive paths this way: a
+// new order clears the synthesis history, a new excitation resets the
+// excitation pointers and a new Start or Length rebuilds the loop. The
+// engine holds the frame at 1024 samples whatever the frame duration, so
+// automating frameDur never reaches the window rewrite; the bench says so
+// when frameDur is automated.
+//
+//   lpmorph-bench-automation [options]
+//
+//   --patterns static,sweep,step,random
+//                          how parameters move from block to block: held,
+//                          slow sweeps at different rates, jumps between
+//                          the ends of each range, or random values
+//   --params wetGain,lpcMix,exLen,exStartPos,exType,lpcOrder,frameDur
+//                          the parameters automated; the rest stay at their
+//                          defaults
+//   --blocks 64,256,1024   host block sizes
+//   --channels 2           channel count
+//   --rate 48000           sample rate
+//   --seconds 4            audio rendered per combination
+//   --json FILE            also write the results as JSON
+//
+// Per combination: mean, 99th percentile and worst block time, the
+// parameters that changed before the worst block, the worst block against
+// the static pattern's at the same block size, and the allocations and
+// frees the audio thread made while processing. Any allocation is a
+// real-time safety bug.
+
+#include "lpc_engine.h"
+#include "denormals.h"
+#include "alloc_counter.h"
+#include "bench_support.h"
+#include "engine_harness.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+using namespace BenchSupport;
+
+const char* parameterNames[] = { "wetGain", "lpcMix", "exLen", "exStartPos", "exType", "lpcOrder", "frameDur" };
+const int numParameters = 7;
+
+struct Config {
+    vector<string> patterns = { "static", "sweep", "step", "random" };
+    vector<string> parameters = { parameterNames, parameterNames + numParameters };
+    vector<int> blockSizes = { 64, 256, 1024 };
+    int channels = 2;
+    double sampleRate = 48000.0;
+    double seconds = 4.0;
+    string jsonPath;
+};
+
+struct Result {
+    string pattern;
+    int blockSize;
+    int numBlocks;
+    double meanUs;
+    double p99Us;
+    double maxUs;
+    double budgetUs;
+    // Worst block over the static pattern's worst block at this size
+    double maxOverStatic;
+    string worstChanges;
+    AllocationCounter::Counts allocations;
+};
+
+// The value of parameter i at position x from 0 to 1 of its range, as
+// ParameterHelper declares it
+void setParameter(LPCParameters& p, int i, double x) {
+    switch (i) {
+        case 0: p.wetGain = static_cast<float>(-40.0 + 60.0*x); break;
+        case 1: p.lpcMix = static_cast<float>(x); break;
+        case 2: p.exLen = static_cast<float>(0.0001 + 0.9999*x); break;
+        case 3: p.exStartPos = static_cast<float>(x); break;
+        case 4: p.exType = static_cast<int>(std::lround(11.0*x)); break;
+        case 5: p.lpcOrder = 1 + static_cast<int>(std::lround((MAX_ORDER - 1)*x)); break;
+        case 6: p.frameDur = static_cast<float>(0.1 + (MAX_FRAME_DUR - 0.1)*x); break;
+    }
+}
+
+LPCParameters automate(const string& pattern, const vector<bool>& automated, int block, std::mt19937& rng) {
+    LPCParameters p;
+    p.lpcMix = 1.f;
+    if (pattern == "static") {
+        return p;
+    }
+    // Sweep periods in blocks, prime so that the parameters drift in and
+    // out of step with each other
+    const int periods[numParameters] = { 37, 41, 43, 47, 53, 59, 61 };
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (int i = 0; i < numParameters; i++) {
+        if (!automated[i]) {
+            continue;
+        }
+        double x;
+        if (pattern == "sweep") {
+            x = 0.5 + 0.5*std::sin(2.0*M_PI*block/periods[i]);
+        }
+        else if (pattern == "step") {
+            x = (block + i) % 2 == 0 ? 0.0 : 1.0;
+        }
+        else {
+            x = uniform(rng);
+        }
+        setParameter(p, i, x);
+    }
+    return p;
+}
+
+string changedParameters(const LPCParameters& a, const LPCParameters& b) {
+    const bool changed[numParameters] = { a.wetGain != b.wetGain, a.lpcMix != b.lpcMix, a.exLen != b.exLen,
+                                          a.exStartPos != b.exStartPos, a.exType != b.exType, a.lpcOrder != b.lpcOrder,
+                                          a.frameDur != b.frameDur };
+    string names;
+    for (int i = 0; i < numParameters; i++) {
+        if (changed[i]) {
+            names += (names.empty() ? "" : ",") + string(parameterNames[i]);
+        }
+    }
+    return names.empty() ? "none" : names;
+}
+
+Result run(const Config& config, const vector<bool>& automated, const vector<vector<double>>& tables, const string& pattern, int blockSize) {
+    const int numChannels = config.channels;
+    const double sampleRate = config.sampleRate;
+    const int warmupBlocks = std::max(1, static_cast<int>(0.5*sampleRate)/blockSize);
+    const int numBlocks = std::max(1, static_cast<int>(config.seconds*sampleRate)/blockSize);
+    const size_t length = static_cast<size_t>(warmupBlocks + numBlocks)*blockSize;
+
+    vector<vector<float>> inputs(numChannels, vector<float>(length));
+    vector<vector<float>> outputs(numChannels, vector<float>(length));
+    for (int ch = 0; ch < numChannels; ch++) {
+        makeTestSignal(inputs[ch], sampleRate, 1 + ch);
+    }
+
+    std::mt19937 rng(1);
+    LPCParameters params = automate(pattern, automated, 0, rng);
+    LPCEngine engine(numChannels);
+    engine.prepare(sampleRate, params, factoryExcitation(tables, params.exType));
+    engine.buildExcitationSegment(factoryExcitation(tables, params.exType).table, params);
+    engine.lpc.beginBlock();
+    engine.lpc.voices.noteOn(48, 0.8f);
+    engine.lpc.voices.noteOn(55, 0.6f);
+    SegmentBuilderThread segmentBuilder(engine, [&tables](int exType) { return factoryExcitation(tables, exType).table; });
+    segmentBuilder.start(params);
+
+    vector<double> times;
+    times.reserve(numBlocks);
+    double worst = -1.0;
+    string worstChanges;
+    Result result;
+    ScopedFlushDenormals noDenormals;
+    for (int b = 0; b < warmupBlocks + numBlocks; b++) {
+        const LPCParameters previous = params;
+        params = automate(pattern, automated, b, rng);
+        segmentBuilder.write(params);
+        const size_t offset = static_cast<size_t>(b)*blockSize;
+        const bool timed = b >= warmupBlocks;
+        if (timed) {
+            AllocationCounter::begin();
+        }
+        const auto start = std::chrono::steady_clock::now();
+        engine.beginBlock(params, factoryExcitation(tables, params.exType));
+        for (int ch = 0; ch < numChannels; ch++) {
+            engine.processChannel(&inputs[ch][offset], &outputs[ch][offset], blockSize, ch, nullptr);
+        }
+        engine.endBlock();
+        const auto end = std::chrono::steady_clock::now();
+        if (timed) {
+            const auto counts = AllocationCounter::end();
+            result.allocations.allocations += counts.allocations;
+            result.allocations.bytes += counts.bytes;
+            result.allocations.deallocations += counts.deallocations;
+            const double us = std::chrono::duration<double, std::micro>(end - start).count();
+            times.push_back(us);
+            if (us > worst) {
+                worst = us;
+                worstChanges = changedParameters(previous, params);
+            }
+        }
+    }
+    segmentBuilder.stop();
+
+    result.pattern = pattern;
+    result.blockSize = blockSize;
+    result.numBlocks = numBlocks;
+    double total = 0.0;
+    for (double t : times) {
+        total += t;
+    }
+    result.meanUs = total/times.size();
+    result.budgetUs = 1e6*blockSize/sampleRate;
+    std::sort(times.begin(), times.end());
+    result.p99Us = times[std::min(times.size() - 1, static_cast<size_t>(std::ceil(0.99*times.size())) - 1)];
+    result.maxUs = times.back();
+    result.maxOverStatic = 0.0;
+    result.worstChanges = worstChanges;
+    return result;
+}
+
+void writeJson(std::ostream& out, const Config& config, const vector<Result>& results) {
+    out << "{\n  \"benchmark\": \"lpmorph-bench-automation\",\n  \"version\": 1,\n";
+#if defined(__VERSION__)
+    out << "  \"compiler\": " << jsonString(__VERSION__) << ",\n";
+#endif
+    out << "  \"channels\": " << config.channels << ",\n  \"sample_rate\": " << config.sampleRate
+        << ",\n  \"seconds_per_run\": " << config.seconds << ",\n  \"parameters\": [";
+    for (size_t i = 0; i < config.parameters.size(); i++) {
+        out << (i > 0 ? ", " : "") << jsonString(config.parameters[i]);
+    }
+    out << "],\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        out << "    {\"pattern\": " << jsonString(r.pattern)
+            << ", \"block_size\": " << r.blockSize
+            << ", \"blocks\": " << r.numBlocks
+            << ", \"mean_us\": " << r.meanUs
+            << ", \"p99_us\": " << r.p99Us
+            << ", \"max_us\": " << r.maxUs
+            << ", \"budget_us\": " << r.budgetUs
+            << ", \"max_over_static\": " << r.maxOverStatic
+            << ", \"worst_block_changes\": " << jsonString(r.worstChanges)
+            << ", \"allocations\": " << r.allocations.allocations
+            << ", \"allocated_bytes\": " << r.allocations.bytes
+            << ", \"deallocations\": " << r.allocations.deallocations
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void printUsage() {
+    std::cout << "usage: lpmorph-bench-automation [--patterns LIST] [--params LIST] [--blocks LIST]\n"
+                 "                                [--channels N] [--rate HZ] [--seconds S] [--json FILE]\n"
+                 "patterns: static, sweep, step, random\n"
+                 "params: wetGain, lpcMix, exLen, exStartPos, exType, lpcOrder, frameDur\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool ok = hasValue;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if (arg == "--patterns" && hasValue) {
+            ok = parseList(argv[++i], config.patterns);
+        }
+        else if (arg == "--params" && hasValue) {
+            ok = parseList(argv[++i], config.parameters);
+        }
+        else if (arg == "--blocks" && hasValue) {
+            ok = parseList(argv[++i], config.blockSizes);
+        }
+        else if (arg == "--channels" && hasValue) {
+            config.channels = std::atoi(argv[++i]);
+            ok = config.channels > 0;
+        }
+        else if (arg == "--rate" && hasValue) {
+            config.sampleRate = std::atof(argv[++i]);
+            ok = config.sampleRate >= 8000.0;
+        }
+        else if (arg == "--seconds" && hasValue) {
+            config.seconds = std::atof(argv[++i]);
+            ok = config.seconds > 0.0;
+        }
+        else if (arg == "--json" && hasValue) {
+            config.jsonPath = argv[++i];
+        }
+        else {
+            ok = false;
+        }
+        if (!ok) {
+            printUsage();
+            return 1;
+        }
+    }
+    for (const auto& pattern : config.patterns) {
+        if (pattern != "static" && pattern != "sweep" && pattern != "step" && pattern != "random") {
+            std::cerr << "unknown pattern " << pattern << std::endl;
+            return 1;
+        }
+    }
+    vector<bool> automated(numParameters, false);
+    for (const auto& name : config.parameters) {
+        const auto* found = std::find(parameterNames, parameterNames + numParameters, name);
+        if (found == parameterNames + numParameters) {
+            std::cerr << "unknown parameter " << name << std::endl;
+            return 1;
+        }
+        automated[found - parameterNames] = true;
+    }
+    for (int blockSize : config.blockSizes) {
+        if (blockSize < 1) {
+            std::cerr << "block sizes must be positive" << std::endl;
+            return 1;
+        }
+    }
+
+    const vector<vector<double>> tables = makeFactoryTables(config.sampleRate);
+
+    if (automated[6]) {
+        std::printf("note: the engine holds the frame at 1024 samples, so frameDur moves without rewriting the window\n");
+    }
+
+    vector<Result> results;
+    std::printf("%-7s %5s %9s %9s %9s %9s %7s %7s %8s  %s\n",
+                "pattern", "block", "mean_us", "p99_us", "max_us", "budget", "/static", "allocs", "frees", "worst block changed");
+    for (int blockSize : config.blockSizes) {
+        vector<Result> sizeResults;
+        for (const auto& pattern : config.patterns) {
+            sizeResults.push_back(run(config, automated, tables, pattern, blockSize));
+        }
+        // The static pattern is the baseline wherever it comes in the list;
+        // without it there is nothing to compare with
+        double staticMax = 0.0;
+        for (const Result& r : sizeResults) {
+            if (r.pattern == "static") {
+                staticMax = r.maxUs;
+            }
+        }
+        for (Result& r : sizeResults) {
+            r.maxOverStatic = staticMax > 0.0 ? r.maxUs/staticMax : 0.0;
+            char ratio[16] = "-";
+            if (staticMax > 0.0) {
+                std::snprintf(ratio, sizeof(ratio), "%.2f", r.maxOverStatic);
+            }
+            std::printf("%-7s %5d %9.2f %9.2f %9.2f %9.2f %7s %7zu %8zu  %s\n",
+                        r.pattern.c_str(), r.blockSize, r.meanUs, r.p99Us, r.maxUs, r.budgetUs, ratio,
+                        r.allocations.allocations, r.allocations.deallocations, r.worstChanges.c_str());
+            results.push_back(r);
+        }
+        std::fflush(stdout);
+    }
+
+    bool allocated = false;
+    for (const Result& r : results) {
+        allocated = allocated || r.allocations.allocations > 0 || r.allocations.deallocations > 0;
+    }
+    if (allocated) {
+        std::printf("the audio thread allocated or freed memory while processing\n");
+    }
+
+    if (!config.jsonPath.empty()) {
+        std::ofstream json(config.jsonPath);
+        writeJson(json, config, results);
+        if (!json) {
+            std::cerr << "cannot write " << config.jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return allocated ? 2 : 0;
+}
@@ -0,0 +1,247 @@
+// What loading a project costs per plugin instance: constructs instances one
+// after another as a host loading a project does, keeping them all alive,
+// and times each instance's constructor, prepareToPlay, createEditor and
+// first processBlock with the page faults each of them takes. The first
+// instance is reported apart from the rest, since it also decodes the
+// factory excitations every later instance shares.
+//
+//   lpmorph-bench-coldstart [options]
+//
+//   --instances 100        instances loaded
+//   --rate 48000           sample rate passed to prepareToPlay
+//   --block 512            block size passed to prepareToPlay
+//   --no-editor            skip createEditor, e.g. without a display
+//   --json FILE            also write the results as JSON
+//
+// Per stage: the first instance, then the median, mean and worst of the
+// others, in milliseconds and page faults. The total is the wall time to
+// bring up all instances, with the resident memory they take. Faults are
+// the whole process's, so background work an instance starts (resampling
+// the excitations, the segment builder) counts towards the stage that
+// started it.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "bench_support.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace BenchSupport;
+
+enum Stage { construct, prepare, editor, firstBlock, numStages };
+const char* stageNames[numStages] = { "constructor", "prepareToPlay", "createEditor", "first processBlock" };
+const char* stageKeys[numStages] = { "constructor", "prepare_to_play", "create_editor", "first_process_block" };
+
+struct Config {
+    int instances = 100;
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    bool editor = true;
+    std::string jsonPath;
+};
+
+struct Sample {
+    double ms = 0.0;
+    long minorFaults = 0;
+    long majorFaults = 0;
+};
+
+// Times body, with the page faults taken meanwhile
+template <typename Body>
+Sample measure(Body&& body) {
+    const PageFaults faultsBefore = pageFaults();
+    const auto start = std::chrono::steady_clock::now();
+    body();
+    const auto end = std::chrono::steady_clock::now();
+    const PageFaults faultsAfter = pageFaults();
+    Sample sample;
+    sample.ms = std::chrono::duration<double, std::milli>(end - start).count();
+    sample.minorFaults = faultsAfter.minor - faultsBefore.minor;
+    sample.majorFaults = faultsAfter.major - faultsBefore.major;
+    return sample;
+}
+
+struct Summary {
+    Sample first;
+    double medianMs = 0.0;
+    double meanMs = 0.0;
+    double maxMs = 0.0;
+    double meanMinorFaults = 0.0;
+    double meanMajorFaults = 0.0;
+};
+
+Summary summarise(const std::vector<Sample>& samples) {
+    Summary summary;
+    summary.first = samples.front();
+    std::vector<double> rest;
+    for (size_t i = 1; i < samples.size(); i++) {
+        rest.push_back(samples[i].ms);
+        summary.meanMs += samples[i].ms;
+        summary.meanMinorFaults += samples[i].minorFaults;
+        summary.meanMajorFaults += samples[i].majorFaults;
+    }
+    if (!rest.empty()) {
+        summary.meanMs /= rest.size();
+        summary.meanMinorFaults /= rest.size();
+        summary.meanMajorFaults /= rest.size();
+        std::sort(rest.begin(), rest.end());
+        summary.medianMs = rest[rest.size()/2];
+        summary.maxMs = rest.back();
+    }
+    return summary;
+}
+
+void writeJson(std::ostream& out, const Config& config, const Summary* summaries, double totalMs, size_t residentBytesUsed) {
+    out << "{\n  \"benchmark\": \"lpmorph-bench-coldstart\",\n  \"version\": 1,\n";
+#if defined(__VERSION__)
+    out << "  \"compiler\": " << jsonString(__VERSION__) << ",\n";
+#endif
+    out << "  \"instances\": " << config.instances << ",\n  \"sample_rate\": " << config.sampleRate
+        << ",\n  \"block_size\": " << config.blockSize << ",\n  \"total_ms\": " << totalMs
+        << ",\n  \"resident_bytes\": " << residentBytesUsed << ",\n  \"stages\": {\n";
+    bool first = true;
+    for (int s = 0; s < numStages; s++) {
+        if (s == editor && !config.editor) {
+            continue;
+        }
+        const Summary& summary = summaries[s];
+        out << (first ? "" : ",\n") << "    " << jsonString(stageKeys[s])
+            << ": {\"first_ms\": " << summary.first.ms
+            << ", \"first_minor_faults\": " << summary.first.minorFaults
+            << ", \"first_major_faults\": " << summary.first.majorFaults
+            << ", \"median_ms\": " << summary.medianMs
+            << ", \"mean_ms\": " << summary.meanMs
+            << ", \"max_ms\": " << summary.maxMs
+            << ", \"mean_minor_faults\": " << summary.meanMinorFaults
+            << ", \"mean_major_faults\": " << summary.meanMajorFaults << "}";
+        first = false;
+    }
+    out << "\n  }\n}\n";
+}
+
+void printUsage() {
+    std::cout << "usage: lpmorph-bench-coldstart [--instances N] [--rate HZ] [--block N] [--no-editor] [--json FILE]\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool ok = hasValue;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if (arg == "--instances" && hasValue) {
+            config.instances = std::atoi(argv[++i]);
+            ok = config.instances > 0;
+        }
+        else if (arg == "--rate" && hasValue) {
+            config.sampleRate = std::atof(argv[++i]);
+            ok = config.sampleRate >= 8000.0;
+        }
+        else if (arg == "--block" && hasValue) {
+            config.blockSize = std::atoi(argv[++i]);
+            ok = config.blockSize > 0;
+        }
+        else if (arg == "--no-editor") {
+            config.editor = false;
+            ok = true;
+        }
+        else if (arg == "--json" && hasValue) {
+            config.jsonPath = argv[++i];
+        }
+        else {
+            ok = false;
+        }
+        if (!ok) {
+            printUsage();
+            return 1;
+        }
+    }
+
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::AudioBuffer<float> input(2, config.blockSize);
+    for (int ch = 0; ch < 2; ch++) {
+        std::vector<float> samples(config.blockSize);
+        makeTestSignal(samples, config.sampleRate, 1 + ch);
+        input.copyFrom(ch, 0, samples.data(), config.blockSize);
+    }
+
+    std::vector<std::unique_ptr<VoicemorphAudioProcessor>> instances;
+    std::vector<Sample> samples[numStages];
+    const size_t residentBefore = residentBytes();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < config.instances; i++) {
+        std::unique_ptr<VoicemorphAudioProcessor> processor;
+        samples[construct].push_back(measure([&] {
+            processor = std::make_unique<VoicemorphAudioProcessor>();
+        }));
+        if (auto* sidechain = processor->getBus(true, 1)) {
+            sidechain->enable(false);
+        }
+        samples[prepare].push_back(measure([&] {
+            processor->setRateAndBufferSizeDetails(config.sampleRate, config.blockSize);
+            processor->prepareToPlay(config.sampleRate, config.blockSize);
+        }));
+        if (config.editor) {
+            // Opened and closed again, as editors are while a project loads
+            samples[editor].push_back(measure([&] {
+                std::unique_ptr<juce::AudioProcessorEditor> view(processor->createEditorIfNeeded());
+            }));
+        }
+        juce::AudioBuffer<float> buffer(input);
+        juce::MidiBuffer midi;
+        samples[firstBlock].push_back(measure([&] {
+            processor->processBlock(buffer, midi);
+        }));
+        instances.push_back(std::move(processor));
+    }
+    const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const size_t residentAfter = residentBytes();
+    const size_t residentUsed = residentAfter > residentBefore ? residentAfter - residentBefore : 0;
+
+    Summary summaries[numStages];
+    std::printf("%-20s %9s %8s %8s %9s %9s %9s %9s\n", "stage", "first_ms", "faults", "major", "median_ms", "mean_ms", "max_ms",
+                "faults");
+    for (int s = 0; s < numStages; s++) {
+        if (samples[s].empty()) {
+            continue;
+        }
+        summaries[s] = summarise(samples[s]);
+        const Summary& summary = summaries[s];
+        std::printf("%-20s %9.3f %8ld %8ld %9.3f %9.3f %9.3f %9.1f\n", stageNames[s], summary.first.ms, summary.first.minorFaults,
+                    summary.first.majorFaults, summary.medianMs, summary.meanMs, summary.maxMs,
+                    summary.meanMinorFaults + summary.meanMajorFaults);
+    }
+    std::printf("%d instances in %.1f ms, %.2f ms each; %.1f MiB resident\n", config.instances, totalMs, totalMs/config.instances,
+                residentUsed/1048576.0);
+
+    // Released as a host closing the project would, before JUCE shuts down
+    for (auto& instance : instances) {
+        instance->releaseResources();
+    }
+    instances.clear();
+
+    if (!config.jsonPath.empty()) {
+        std::ofstream json(config.jsonPath);
+        writeJson(json, config, summaries, totalMs, residentUsed);
+        if (!json) {
+            std::cerr << "cannot write " << config.jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,341 @@
+// How many plugin instances fit on one core: hosts N VoicemorphAudioProcessor
+// instances in an in-process juce::AudioProcessorGraph, chained in series or
+// side by side in parallel, and renders a fixed workload through the graph
+// on one thread as a host's audio thread would. N grows until the graph
+// misses the block deadline, then is narrowed down to the largest N that
+// meets it.
+//
+//   lpmorph-bench-density [options]
+//
+//   --topologies series,parallel
+//   --block 64             host block size in samples
+//   --rate 48000           sample rate
+//   --order 25             LPC order of every instance
+//   --mix 1                LPC mix of every instance
+//   --max 512              largest N tried
+//   --seconds 2            audio rendered per N
+//   --json FILE            also write the results as JSON
+//
+// A graph meets the deadline when its 99th percentile block time is within
+// the block's real-time budget. For every N tried: mean, 99th percentile
+// and worst block time, the load on the core and the resident memory per
+// instance, which is the growth of the process's resident set over the
+// instances, with the factory excitations shared by all instances loaded
+// beforehand. As N grows, per-instance memory and shared caches both come
+// into play, which is what the single-instance benchmarks cannot show.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "ExcitationCache.h"
+#include "bench_support.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace BenchSupport;
+using Graph = juce::AudioProcessorGraph;
+
+struct Config {
+    std::vector<std::string> topologies = { "series", "parallel" };
+    int blockSize = 64;
+    double sampleRate = 48000.0;
+    int order = MAX_ORDER/2;
+    float mix = 1.f;
+    int maxInstances = 512;
+    double seconds = 2.0;
+    std::string jsonPath;
+};
+
+struct Trial {
+    std::string topology;
+    int instances;
+    int numBlocks;
+    double meanUs;
+    double p99Us;
+    double maxUs;
+    double budgetUs;
+    double residentPerInstance;
+    bool meetsDeadline;
+};
+
+void setParameter(VoicemorphAudioProcessor& processor, const char* id, float value) {
+    if (auto* parameter = processor.apvts.getParameter(id)) {
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+}
+
+std::unique_ptr<VoicemorphAudioProcessor> createInstance(const Config& config) {
+    auto processor = std::make_unique<VoicemorphAudioProcessor>();
+    // Main stereo input and output only, as on an insert
+    if (auto* sidechain = processor->getBus(true, 1)) {
+        sidechain->enable(false);
+    }
+    setParameter(*processor, "lpcMix", config.mix);
+    setParameter(*processor, "lpcOrder", static_cast<float>(config.order));
+    return processor;
+}
+
+Trial run(const Config& config, const std::string& topology, int numInstances, const juce::AudioBuffer<float>& input) {
+    const size_t residentBefore = residentBytes();
+    const int numChannels = 2;
+    Trial trial;
+    trial.topology = topology;
+    trial.instances = numInstances;
+    {
+        Graph graph;
+        graph.setPlayConfigDetails(numChannels, numChannels, config.sampleRate, config.blockSize);
+        auto inputNode = graph.addNode(std::make_unique<Graph::AudioGraphIOProcessor>(Graph::AudioGraphIOProcessor::audioInputNode));
+        auto outputNode = graph.addNode(std::make_unique<Graph::AudioGraphIOProcessor>(Graph::AudioGraphIOProcessor::audioOutputNode));
+        auto previous = inputNode;
+        for (int i = 0; i < numInstances; i++) {
+            auto node = graph.addNode(createInstance(config));
+            auto source = topology == "series" ? previous : inputNode;
+            for (int ch = 0; ch < numChannels; ch++) {
+                graph.addConnection({ { source->nodeID, ch }, { node->nodeID, ch } });
+                if (topology == "parallel") {
+                    graph.addConnection({ { node->nodeID, ch }, { outputNode->nodeID, ch } });
+                }
+            }
+            previous = node;
+        }
+        if (topology == "series") {
+            for (int ch = 0; ch < numChannels; ch++) {
+                graph.addConnection({ { previous->nodeID, ch }, { outputNode->nodeID, ch } });
+            }
+        }
+        graph.prepareToPlay(config.sampleRate, config.blockSize);
+
+        const int warmupBlocks = std::max(1, static_cast<int>(0.5*config.sampleRate)/config.blockSize);
+        const int numBlocks = std::max(1, static_cast<int>(config.seconds*config.sampleRate)/config.blockSize);
+        const int inputBlocks = input.getNumSamples()/config.blockSize;
+        juce::AudioBuffer<float> buffer(numChannels, config.blockSize);
+        juce::MidiBuffer midi;
+        std::vector<double> times;
+        times.reserve(numBlocks);
+        for (int b = 0; b < warmupBlocks + numBlocks; b++) {
+            const int offset = (b % inputBlocks)*config.blockSize;
+            for (int ch = 0; ch < numChannels; ch++) {
+                buffer.copyFrom(ch, 0, input, ch, offset, config.blockSize);
+            }
+            midi.clear();
+            const auto start = std::chrono::steady_clock::now();
+            graph.processBlock(buffer, midi);
+            const auto end = std::chrono::steady_clock::now();
+            if (b >= warmupBlocks) {
+                times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            }
+        }
+        const size_t residentAfter = residentBytes();
+        graph.releaseResources();
+
+        trial.numBlocks = numBlocks;
+        double total = 0.0;
+        for (double t : times) {
+            total += t;
+        }
+        trial.meanUs = total/times.size();
+        trial.budgetUs = 1e6*config.blockSize/config.sampleRate;
+        std::sort(times.begin(), times.end());
+        trial.p99Us = times[std::min(times.size() - 1, static_cast<size_t>(std::ceil(0.99*times.size())) - 1)];
+        trial.maxUs = times.back();
+        trial.meetsDeadline = trial.p99Us <= trial.budgetUs;
+        trial.residentPerInstance = residentBefore > 0 && residentAfter > residentBefore
+            ? static_cast<double>(residentAfter - residentBefore)/numInstances : 0.0;
+    }
+    return trial;
+}
+
+void print(const Trial& t) {
+    char resident[32] = "-";
+    if (t.residentPerInstance > 0.0) {
+        std::snprintf(resident, sizeof(resident), "%.1f", t.residentPerInstance/1024.0);
+    }
+    std::printf("%-8s %5d %9.2f %9.2f %9.2f %9.2f %6.1f%% %9s  %s\n", t.topology.c_str(), t.instances, t.meanUs, t.p99Us, t.maxUs,
+                t.budgetUs, 100.0*t.p99Us/t.budgetUs, resident, t.meetsDeadline ? "yes" : "no");
+    std::fflush(stdout);
+}
+
+// The largest N meeting the deadline: doubling until it is missed, then
+// bisecting between the last N that met it and the first that did not
+int findDensity(const Config& config, const std::string& topology, const juce::AudioBuffer<float>& input, std::vector<Trial>& trials) {
+    std::map<int, bool> tried;
+    auto meets = [&](int n) {
+        if (tried.count(n) == 0) {
+            Trial trial = run(config, topology, n, input);
+            print(trial);
+            trials.push_back(trial);
+            tried[n] = trial.meetsDeadline;
+        }
+        return tried[n];
+    };
+    if (!meets(1)) {
+        return 0;
+    }
+    int good = 1;
+    int bad = 0;
+    while (bad == 0 && good < config.maxInstances) {
+        const int next = std::min(2*good, config.maxInstances);
+        if (meets(next)) {
+            good = next;
+        }
+        else {
+            bad = next;
+        }
+    }
+    while (bad > good + 1) {
+        const int middle = good + (bad - good)/2;
+        if (meets(middle)) {
+            good = middle;
+        }
+        else {
+            bad = middle;
+        }
+    }
+    return good;
+}
+
+void writeJson(std::ostream& out, const Config& config, size_t sharedBytes, const std::map<std::string, int>& densities,
+               const std::vector<Trial>& trials) {
+    out << "{\n  \"benchmark\": \"lpmorph-bench-density\",\n  \"version\": 1,\n";
+#if defined(__VERSION__)
+    out << "  \"compiler\": " << jsonString(__VERSION__) << ",\n";
+#endif
+    out << "  \"block_size\": " << config.blockSize << ",\n  \"sample_rate\": " << config.sampleRate
+        << ",\n  \"order\": " << config.order << ",\n  \"mix\": " << config.mix
+        << ",\n  \"shared_resident_bytes\": " << sharedBytes << ",\n  \"max_instances\": {";
+    bool first = true;
+    for (const auto& density : densities) {
+        out << (first ? "" : ", ") << jsonString(density.first) << ": " << density.second;
+        first = false;
+    }
+    out << "},\n  \"trials\": [\n";
+    for (size_t i = 0; i < trials.size(); i++) {
+        const Trial& t = trials[i];
+        out << "    {\"topology\": " << jsonString(t.topology)
+            << ", \"instances\": " << t.instances
+            << ", \"blocks\": " << t.numBlocks
+            << ", \"mean_us\": " << t.meanUs
+            << ", \"p99_us\": " << t.p99Us
+            << ", \"max_us\": " << t.maxUs
+            << ", \"budget_us\": " << t.budgetUs
+            << ", \"resident_bytes_per_instance\": " << t.residentPerInstance
+            << ", \"meets_deadline\": " << (t.meetsDeadline ? "true" : "false")
+            << "}" << (i + 1 < trials.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void printUsage() {
+    std::cout << "usage: lpmorph-bench-density [--topologies LIST] [--block N] [--rate HZ] [--order N]\n"
+                 "                             [--mix M] [--max N] [--seconds S] [--json FILE]\n"
+                 "topologies: series, parallel\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool ok = hasValue;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if (arg == "--topologies" && hasValue) {
+            ok = parseList(argv[++i], config.topologies);
+        }
+        else if (arg == "--block" && hasValue) {
+            config.blockSize = std::atoi(argv[++i]);
+            ok = config.blockSize > 0;
+        }
+        else if (arg == "--rate" && hasValue) {
+            config.sampleRate = std::atof(argv[++i]);
+            ok = config.sampleRate >= 8000.0;
+        }
+        else if (arg == "--order" && hasValue) {
+            config.order = std::atoi(argv[++i]);
+            ok = config.order >= 1 && config.order <= MAX_ORDER;
+        }
+        else if (arg == "--mix" && hasValue) {
+            config.mix = static_cast<float>(std::atof(argv[++i]));
+            ok = config.mix >= 0.f && config.mix <= 1.f;
+        }
+        else if (arg == "--max" && hasValue) {
+            config.maxInstances = std::atoi(argv[++i]);
+            ok = config.maxInstances > 0;
+        }
+        else if (arg == "--seconds" && hasValue) {
+            config.seconds = std::atof(argv[++i]);
+            ok = config.seconds > 0.0;
+        }
+        else if (arg == "--json" && hasValue) {
+            config.jsonPath = argv[++i];
+        }
+        else {
+            ok = false;
+        }
+        if (!ok) {
+            printUsage();
+            return 1;
+        }
+    }
+    for (const auto& topology : config.topologies) {
+        if (topology != "series" && topology != "parallel") {
+            std::cerr << "unknown topology " << topology << std::endl;
+            return 1;
+        }
+    }
+
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    // Decode and resample the factory excitations once, before measuring, so
+    // that the instances share them as they do in a host
+    const size_t residentAtStart = residentBytes();
+    juce::SharedResourcePointer<ExcitationCache> excitationCache;
+    const auto* tables = excitationCache->request(config.sampleRate);
+    for (int i = 0; i < 1000 && !tables->ready; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const size_t sharedBytes = residentBytes() > residentAtStart ? residentBytes() - residentAtStart : 0;
+    std::printf("block %d at %.0f Hz, budget %.2f us; shared excitations %.1f MiB\n", config.blockSize, config.sampleRate,
+                1e6*config.blockSize/config.sampleRate, sharedBytes/1048576.0);
+
+    juce::AudioBuffer<float> input(2, static_cast<int>(4.0*config.sampleRate));
+    for (int ch = 0; ch < 2; ch++) {
+        std::vector<float> samples(input.getNumSamples());
+        makeTestSignal(samples, config.sampleRate, 1 + ch);
+        input.copyFrom(ch, 0, samples.data(), input.getNumSamples());
+    }
+
+    std::printf("%-8s %5s %9s %9s %9s %9s %7s %9s  %s\n", "topology", "n", "mean_us", "p99_us", "max_us", "budget", "load",
+                "KiB/inst", "meets");
+    std::map<std::string, int> densities;
+    std::vector<Trial> trials;
+    for (const auto& topology : config.topologies) {
+        densities[topology] = findDensity(config, topology, input, trials);
+    }
+    for (const auto& density : densities) {
+        std::printf("%s: %d instances at %d samples\n", density.first.c_str(), density.second, config.blockSize);
+    }
+
+    if (!config.jsonPath.empty()) {
+        std::ofstream json(config.jsonPath);
+        writeJson(json, config, sharedBytes, densities, trials);
+        if (!json) {
+            std::cerr << "cannot write " << config.jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
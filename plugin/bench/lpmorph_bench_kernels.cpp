@@ -0,0 +1,394 @@
+// Times the inner loops of LPC analysis and synthesis one at a time, on the
+// engine's own code in LPCKernels: autocorrelation of a frame, the
+// Levinson-Durbin recursion, windowing a frame out of the input ring, the
+// lattice synthesis filter, overlap-add into the output ring and the final
+// mix. Each kernel runs on a pinned thread with its data already in cache,
+// so the figures show the arithmetic cost, not the memory system's.
+//
+//   lpmorph-bench-kernels [options]
+//
+//   --orders 10,25,50     LPC orders for the order-dependent kernels
+//   --frame 1024          frame length in samples
+//   --repetitions 51      timed batches per kernel
+//   --cpu N               CPU to pin to; the current one by default
+//   --counters            also read hardware counters (Linux)
+//   --json FILE           also write the results as JSON
+//
+// Time is read from the time stamp counter on x86, calibrated against
+// steady_clock; these are reference cycles at the nominal frequency, not
+// core cycles, so turbo or power saving shifts them. Elsewhere steady_clock
+// nanoseconds are reported instead. Each kernel is warmed up, then timed
+// in batches long enough to hide the clock's overhead; the median and
+// minimum batch are reported per call and per sample. Floating-point
+// operations and bytes per call are counted from the code, with every
+// operand touched once, and give the arithmetic intensity for placing each
+// kernel on a roofline.
+//
+// With --counters, cycles, instructions, L1 data and last-level cache
+// misses and branch misses are counted over the timed batches through
+// perf_event_open, and IPC and misses per sample are printed after the
+// timings. Where the counters cannot be opened the timings are printed
+// alone, with the reason.
+
+#include "lpc_kernels.h"
+#include "lpc_limits.h"
+#include "denormals.h"
+#include "bench_support.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+using namespace BenchSupport;
+
+struct Config {
+    vector<int> orders = { 10, 25, 50 };
+    int frameLength = 1024;
+    int repetitions = 51;
+    int cpu = -1;
+    bool counters = false;
+    string jsonPath;
+};
+
+struct Result {
+    string kernel;
+    // 0 for kernels that do not depend on the order
+    int order;
+    string unit;
+    int samplesPerCall;
+    double medianTicks;
+    double minTicks;
+    double flops;
+    double bytes;
+    CounterReadings counters {};
+};
+
+// Everything one kernel reads and writes, laid out as the engine has it
+struct Workload {
+    int frameLength;
+    int hopSize;
+    int bufLen = 4096;
+    int order = 0;
+    vector<double> window;
+    vector<double> inRing;
+    vector<double> outRing;
+    vector<double> frame;
+    vector<double> excitation;
+    vector<double> phi;
+    vector<double> alphas;
+    vector<double> reflection;
+    vector<double> history;
+    vector<float> output;
+    int outRdPtr = 0;
+    size_t inRdPtr = 0;
+
+    explicit Workload(int length) : frameLength(length), hopSize(length/2) {
+        bufLen = std::max(bufLen, 4*length);
+        window.resize(frameLength);
+        for (int i = 0; i < frameLength; i++) {
+            window[i] = 0.5*(1.0-cos(2.0*M_PI*i/(double)(frameLength-1)));
+        }
+        vector<float> input(bufLen);
+        makeTestSignal(input, 48000.0, 1);
+        inRing.assign(input.begin(), input.end());
+        outRing.assign(bufLen, 0.0);
+        frame.resize(frameLength);
+        excitation.resize(frameLength);
+        uint32_t seed = 7;
+        for (auto& sample : excitation) {
+            seed = seed*1664525u + 1013904223u;
+            sample = (seed >> 8)/16777216.0 - 0.5;
+        }
+        phi.resize(MAX_ORDER + 1);
+        alphas.resize(MAX_ORDER + 1);
+        reflection.resize(MAX_ORDER);
+        history.resize(MAX_ORDER);
+        output.resize(hopSize);
+    }
+
+    // Analyses a voiced frame at this order, so that the synthesis kernels
+    // filter through a realistic, stable lattice
+    void setOrder(int newOrder) {
+        order = newOrder;
+        LPCKernels::windowFrame(inRing.data(), bufLen, frameLength, window.data(), frame.data(), frameLength);
+        for (int lag = 0; lag <= order; lag++) {
+            phi[lag] = LPCKernels::autocorrelate(frame.data(), frameLength, lag);
+        }
+        int clamps = 0;
+        LPCKernels::levinsonDurbin(phi.data(), alphas.data(), reflection.data(), order, clamps);
+        std::fill(history.begin(), history.end(), 0.0);
+    }
+};
+
+volatile double sink;
+
+PerfCounters* perfCounters = nullptr;
+
+// Median and minimum ticks per call of kernel, and the counters over all
+// timed calls
+void measure(const std::function<void()>& kernel, const Config& config, double ticksPerSecond, Result& result) {
+    // Warm up for 20 ms, and size batches to about 50 us from what that took
+    int warmupCalls = 0;
+    const uint64_t warmupStart = ticks();
+    const uint64_t warmupTicks = static_cast<uint64_t>(0.02*ticksPerSecond);
+    while (ticks() - warmupStart < warmupTicks) {
+        kernel();
+        warmupCalls++;
+    }
+    const double ticksPerCall = static_cast<double>(ticks() - warmupStart)/warmupCalls;
+    const int batch = std::max(1, static_cast<int>(50e-6*ticksPerSecond/ticksPerCall));
+
+    vector<double> perCall(config.repetitions);
+    if (perfCounters != nullptr) {
+        perfCounters->start();
+    }
+    for (auto& t : perCall) {
+        const uint64_t start = ticks();
+        for (int i = 0; i < batch; i++) {
+            kernel();
+        }
+        t = static_cast<double>(ticks() - start)/batch;
+    }
+    if (perfCounters != nullptr) {
+        perfCounters->stop();
+        result.counters = CounterReadings(*perfCounters, static_cast<double>(config.repetitions)*batch*result.samplesPerCall);
+    }
+    std::sort(perCall.begin(), perCall.end());
+    result.medianTicks = perCall[perCall.size()/2];
+    result.minTicks = perCall.front();
+}
+
+void runOrderIndependent(Workload& w, const Config& config, double ticksPerSecond, vector<Result>& results) {
+    const double F = w.frameLength;
+    const double hop = w.hopSize;
+
+    Result window { "window", 0, "frame", w.frameLength, 0, 0, F, 24.0*F };
+    int end = w.frameLength;
+    measure([&] {
+        LPCKernels::windowFrame(w.inRing.data(), w.bufLen, end, w.window.data(), w.frame.data(), w.frameLength);
+        end = (end + w.hopSize)%w.bufLen;
+    }, config, ticksPerSecond, window);
+    results.push_back(window);
+
+    // Reads the frame and the overlapping hop of the ring, writes the frame
+    Result ola { "overlap-add", 0, "frame", w.frameLength, 0, 0, hop, 16.0*F + 8.0*hop };
+    int writePos = 0;
+    measure([&] {
+        LPCKernels::overlapAdd(w.frame.data(), w.outRing.data(), w.bufLen, writePos, w.frameLength, w.hopSize);
+        writePos = (writePos + w.hopSize)%w.bufLen;
+    }, config, ticksPerSecond, ola);
+    results.push_back(ola);
+
+    // Per sample: the gain ramp (2), wet (2) and dry (2) scaling and their
+    // sum; reads both rings, clears the output ring and writes a float
+    Result mix { "mix", 0, "hop", w.hopSize, 0, 0, 7.0*hop, 28.0*hop };
+    std::fill(w.outRing.begin(), w.outRing.end(), 0.25);
+    measure([&] {
+        sink = LPCKernels::mixOutput(w.outRing.data(), w.outRdPtr, w.inRing.data(), w.inRdPtr, w.bufLen, w.frameLength,
+                                     w.output.data(), 1, w.hopSize, 0.7f, 0.9f, 1e-5, 0).clippedSamples;
+    }, config, ticksPerSecond, mix);
+    results.push_back(mix);
+}
+
+void runOrder(Workload& w, int order, const Config& config, double ticksPerSecond, vector<Result>& results) {
+    w.setOrder(order);
+    const double F = w.frameLength;
+    const double P = order;
+
+    // Multiply and add per product, over lags 0 to order
+    double autocorrelationFlops = 0.0;
+    for (int lag = 0; lag <= order; lag++) {
+        autocorrelationFlops += 2.0*(F - lag);
+    }
+    Result autocorrelation { "autocorrelation", order, "frame", w.frameLength, 0, 0, autocorrelationFlops, 8.0*F + 8.0*(P + 1) };
+    measure([&] {
+        for (int lag = 0; lag <= order; lag++) {
+            w.phi[lag] = LPCKernels::autocorrelate(w.frame.data(), w.frameLength, lag);
+        }
+    }, config, ticksPerSecond, autocorrelation);
+    results.push_back(autocorrelation);
+
+    // Per step k: the inner product (2(k+1)), the division, the symmetric
+    // update (4 per pair) and the error update (3)
+    double levinsonFlops = 0.0;
+    for (int k = 0; k < order; k++) {
+        levinsonFlops += 2.0*(k + 1) + 1.0 + 4.0*((k + 1)/2 + 1) + 3.0;
+    }
+    Result levinson { "levinson-durbin", order, "frame", 0, 0, 0, levinsonFlops, 8.0*(P + 1) + 16.0*(P + 1) + 8.0*P };
+    int clamps = 0;
+    measure([&] {
+        sink = LPCKernels::levinsonDurbin(w.phi.data(), w.alphas.data(), w.reflection.data(), order, clamps);
+    }, config, ticksPerSecond, levinson);
+    results.push_back(levinson);
+
+    // Two multiply-adds per stage and sample. The frame is refilled from the
+    // excitation each call, as the engine does, so the filter cannot run
+    // away; the copy is a small part of the time.
+    Result lattice { "lattice", order, "frame", w.frameLength, 0, 0, 4.0*P*F, 16.0*F + 8.0*P + 16.0*P };
+    measure([&] {
+        std::copy(w.excitation.begin(), w.excitation.end(), w.frame.begin());
+        LPCKernels::latticeSynthesise(w.frame.data(), w.frameLength, w.reflection.data(), w.history.data(), order);
+    }, config, ticksPerSecond, lattice);
+    results.push_back(lattice);
+}
+
+void writeJson(std::ostream& out, const Config& config, double ticksPerSecond, int cpu, const vector<Result>& results) {
+    out << "{\n  \"benchmark\": \"lpmorph-bench-kernels\",\n  \"version\": 1,\n";
+#if defined(__VERSION__)
+    out << "  \"compiler\": " << jsonString(__VERSION__) << ",\n";
+#endif
+#if defined(LPMORPH_BENCH_TSC)
+    out << "  \"clock\": \"tsc\",\n";
+#else
+    out << "  \"clock\": \"steady_clock\",\n";
+#endif
+    out << "  \"ticks_per_second\": " << ticksPerSecond << ",\n  \"cpu\": " << cpu
+        << ",\n  \"frame_length\": " << config.frameLength << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        const double seconds = r.medianTicks/ticksPerSecond;
+        out << "    {\"kernel\": " << jsonString(r.kernel)
+            << ", \"order\": " << r.order
+            << ", \"unit\": " << jsonString(r.unit)
+            << ", \"samples_per_call\": " << r.samplesPerCall
+            << ", \"ticks_per_call\": " << r.medianTicks
+            << ", \"min_ticks_per_call\": " << r.minTicks
+            << ", \"ticks_per_sample\": " << (r.samplesPerCall > 0 ? r.medianTicks/r.samplesPerCall : 0.0)
+            << ", \"ns_per_call\": " << 1e9*seconds
+            << ", \"flops_per_call\": " << r.flops
+            << ", \"bytes_per_call\": " << r.bytes
+            << ", \"flops_per_byte\": " << r.flops/r.bytes
+            << ", \"gflops\": " << 1e-9*r.flops/seconds
+            << ", \"gbytes_per_second\": " << 1e-9*r.bytes/seconds
+            << (config.counters ? r.counters.json() : "")
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void printUsage() {
+    std::cout << "usage: lpmorph-bench-kernels [--orders LIST] [--frame N] [--repetitions N]\n"
+                 "                             [--cpu N] [--counters] [--json FILE]\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool ok = hasValue;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if (arg == "--orders" && hasValue) {
+            ok = parseList(argv[++i], config.orders);
+        }
+        else if (arg == "--frame" && hasValue) {
+            config.frameLength = std::atoi(argv[++i]);
+            ok = config.frameLength >= 16;
+        }
+        else if (arg == "--repetitions" && hasValue) {
+            config.repetitions = std::atoi(argv[++i]);
+            ok = config.repetitions > 0;
+        }
+        else if (arg == "--cpu" && hasValue) {
+            config.cpu = std::atoi(argv[++i]);
+            ok = config.cpu >= 0;
+        }
+        else if (arg == "--counters") {
+            config.counters = true;
+            ok = true;
+        }
+        else if (arg == "--json" && hasValue) {
+            config.jsonPath = argv[++i];
+        }
+        else {
+            ok = false;
+        }
+        if (!ok) {
+            printUsage();
+            return 1;
+        }
+    }
+    for (int order : config.orders) {
+        if (order < 1 || order > MAX_ORDER) {
+            std::cerr << "orders must be between 1 and " << MAX_ORDER << std::endl;
+            return 1;
+        }
+    }
+
+    const int cpu = pinThread(config.cpu);
+    if (config.cpu >= 0 && cpu != config.cpu) {
+        std::cerr << "cannot pin to CPU " << config.cpu << std::endl;
+        return 1;
+    }
+    const double ticksPerSecond = calibrateTicks();
+#if defined(LPMORPH_BENCH_TSC)
+    std::printf("clock: TSC, %.3f GHz reference cycles; cpu %d\n", 1e-9*ticksPerSecond, cpu);
+    const char* tickName = "cyc";
+#else
+    std::printf("clock: steady_clock, nanoseconds; cpu %d\n", cpu);
+    const char* tickName = "ns";
+#endif
+
+    PerfCounters counters;
+    if (config.counters) {
+        if (counters.available()) {
+            perfCounters = &counters;
+        }
+        else {
+            std::printf("counters: unavailable, %s; timing only\n", counters.reason().c_str());
+            config.counters = false;
+        }
+    }
+
+    ScopedFlushDenormals noDenormals;
+    Workload workload(config.frameLength);
+    vector<Result> results;
+    runOrderIndependent(workload, config, ticksPerSecond, results);
+    for (int order : config.orders) {
+        runOrder(workload, order, config, ticksPerSecond, results);
+    }
+
+    std::printf("%-16s %5s %6s %10s %10s %8s %9s %10s %8s %8s %8s%s\n", "kernel", "order", "unit",
+                (string(tickName) + "/call").c_str(), (string("min ") + tickName).c_str(), (string(tickName) + "/smp").c_str(),
+                "ns/call", "flops", "flop/B", "GFLOP/s", "GB/s", config.counters ? CounterReadings::header() : "");
+    for (const Result& r : results) {
+        const double seconds = r.medianTicks/ticksPerSecond;
+        char order[16] = "-";
+        if (r.order > 0) {
+            std::snprintf(order, sizeof(order), "%d", r.order);
+        }
+        char perSample[16] = "-";
+        if (r.samplesPerCall > 0) {
+            std::snprintf(perSample, sizeof(perSample), "%.2f", r.medianTicks/r.samplesPerCall);
+        }
+        std::printf("%-16s %5s %6s %10.0f %10.0f %8s %9.1f %10.0f %8.3f %8.2f %8.2f%s\n", r.kernel.c_str(), order, r.unit.c_str(),
+                    r.medianTicks, r.minTicks, perSample, 1e9*seconds, r.flops, r.flops/r.bytes,
+                    1e-9*r.flops/seconds, 1e-9*r.bytes/seconds, config.counters ? r.counters.columns().c_str() : "");
+    }
+
+    if (!config.jsonPath.empty()) {
+        std::ofstream json(config.jsonPath);
+        writeJson(json, config, ticksPerSecond, cpu, results);
+        if (!json) {
+            std::cerr << "cannot write " << config.jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
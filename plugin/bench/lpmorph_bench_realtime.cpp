@@ -0,0 +1,360 @@
+// Times the engine the way a host drives it in real time: one thread calling
+// beginBlock, processChannel for every channel and endBlock for each block,
+// over a sweep of engine settings and host configurations. Every combination
+// renders the same synthetic input and reports the time per block against
+// the block's real-time budget.
+//
+//   lpmorph-bench-realtime [options]
+//
+// Each sweep option takes a comma-separated list:
+//   --orders 10,25,50           LPC order
+//   --frames 10                 frame duration in ms
+//   --blocks 32,64,...,4096     host block size in samples
+//   --channels 1,2              channel count
+//   --rates 44100,48000,96000   sample rate
+//   --excitations table,noise,pulse,glottal,midi,midi16,sidechain
+//   --seconds 2                 audio rendered per combination
+//   --counters                  also read hardware counters (Linux)
+//   --json FILE                 also write the results as JSON
+//
+// The engine currently analyses 1024-sample frames whatever the frame
+// duration, so durations that come to a frame length already swept at a rate
+// are skipped there rather than timing the same work twice.
+//
+// Per combination: mean, 99th percentile and maximum block time, the
+// real-time factor (audio time over processing time) and the headroom left
+// in the block's budget at the 99th percentile. The first half second is
+// rendered before timing starts, so that excitation state and caches are
+// warm. midi holds a three-note chord; midi16 holds VoicePool::maxVoices
+// notes, every voice the pool has, for its worst case.
+//
+// With --counters, cycles, instructions, L1 data and last-level cache
+// misses and branch misses are counted over the timed blocks through
+// perf_event_open, and IPC and misses per sample (per channel) are printed
+// after the timings. Where the counters cannot be opened the timings are
+// printed alone, with the reason.
+
+#include "lpc_engine.h"
+#include "denormals.h"
+#include "bench_support.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using namespace BenchSupport;
+
+struct Config {
+    vector<int> orders = { 10, 25, 50 };
+    vector<double> frameDurations = { 10.0 };
+    vector<int> blockSizes = { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    vector<int> channelCounts = { 1, 2 };
+    vector<double> sampleRates = { 44100.0, 48000.0, 96000.0 };
+    vector<string> excitations = { "table", "noise", "pulse", "glottal", "midi", "midi16", "sidechain" };
+    double seconds = 2.0;
+    bool counters = false;
+    string jsonPath;
+};
+
+struct Result {
+    int order;
+    double frameDuration;
+    int frameLength;
+    int blockSize;
+    int channels;
+    double sampleRate;
+    string excitation;
+    int numBlocks;
+    double meanUs;
+    double p99Us;
+    double maxUs;
+    double budgetUs;
+    double realtimeFactor;
+    double headroom;
+    CounterReadings counters;
+};
+
+// Excitation list positions without factory tables: generators after "Off",
+// then the MIDI voices
+int exTypeFor(const string& excitation) {
+    if (excitation == "noise" || excitation == "sidechain") {
+        return ExcitationGenerator::noise;
+    }
+    if (excitation == "pulse") {
+        return ExcitationGenerator::pulseTrain;
+    }
+    if (excitation == "glottal") {
+        return ExcitationGenerator::glottalPulse;
+    }
+    if (excitation == "midi" || excitation == "midi16") {
+        return ExcitationGenerator::glottalPulse + 1;
+    }
+    return 0;
+}
+
+// The frame length the engine analyses for a duration at a rate
+int frameLengthFor(double frameDuration, double sampleRate) {
+    LPCParameters params;
+    params.frameDur = static_cast<float>(frameDuration);
+    LPCEngine engine(1);
+    engine.prepare(sampleRate, params, LPCExcitation());
+    return engine.lpc.FRAMELEN;
+}
+
+Result run(const Config& config, PerfCounters* counters, int order, double frameDuration, int blockSize, int numChannels, double sampleRate, const string& excitation) {
+    const int warmupSamples = static_cast<int>(0.5*sampleRate);
+    const int numBlocks = std::max(1, static_cast<int>(config.seconds*sampleRate)/blockSize);
+    const int numWarmupBlocks = (warmupSamples + blockSize - 1)/blockSize;
+    const int totalBlocks = numWarmupBlocks + numBlocks;
+    const size_t length = static_cast<size_t>(totalBlocks)*blockSize;
+
+    vector<vector<float>> inputs(numChannels, vector<float>(length));
+    vector<vector<float>> sidechains(numChannels, vector<float>(length));
+    vector<vector<float>> outputs(numChannels, vector<float>(length));
+    for (int ch = 0; ch < numChannels; ch++) {
+        makeTestSignal(inputs[ch], sampleRate, 1 + ch);
+        makeTestSignal(sidechains[ch], sampleRate, 101 + ch);
+    }
+    vector<double> table(static_cast<size_t>(sampleRate));
+    uint32_t seed = 7;
+    for (auto& sample : table) {
+        seed = seed*1664525u + 1013904223u;
+        sample = (seed >> 8)/16777216.0 - 0.5;
+    }
+
+    LPCParameters params;
+    params.lpcMix = 1.f;
+    params.lpcOrder = order;
+    params.frameDur = static_cast<float>(frameDuration);
+    params.exType = exTypeFor(excitation);
+    params.useSidechain = excitation == "sidechain";
+    LPCExcitation ex;
+    if (excitation == "table") {
+        ex.table = &table;
+        ex.custom = true;
+    }
+
+    LPCEngine engine(numChannels);
+    engine.prepare(sampleRate, params, ex);
+    engine.buildExcitationSegment(ex.table, params);
+    engine.lpc.beginBlock();
+    if (excitation == "midi") {
+        engine.lpc.voices.noteOn(48, 0.8f);
+        engine.lpc.voices.noteOn(55, 0.6f);
+        engine.lpc.voices.noteOn(64, 0.5f);
+    }
+    if (excitation == "midi16") {
+        for (int v = 0; v < VoicePool::maxVoices; v++) {
+            engine.lpc.voices.noteOn(36 + 3*v, 0.4f + 0.03f*v);
+        }
+    }
+
+    vector<double> times;
+    times.reserve(numBlocks);
+    ScopedFlushDenormals noDenormals;
+    for (int b = 0; b < totalBlocks; b++) {
+        if (counters != nullptr && b == numWarmupBlocks) {
+            counters->start();
+        }
+        const size_t offset = static_cast<size_t>(b)*blockSize;
+        const auto start = std::chrono::steady_clock::now();
+        engine.beginBlock(params, ex);
+        for (int ch = 0; ch < numChannels; ch++) {
+            engine.processChannel(&inputs[ch][offset], &outputs[ch][offset], blockSize, ch,
+                                  params.useSidechain ? &sidechains[ch][offset] : nullptr);
+        }
+        engine.endBlock();
+        const auto end = std::chrono::steady_clock::now();
+        if (b >= numWarmupBlocks) {
+            times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        }
+    }
+
+    Result result;
+    if (counters != nullptr) {
+        counters->stop();
+        result.counters = CounterReadings(*counters, static_cast<double>(numBlocks)*blockSize*numChannels);
+    }
+    result.order = order;
+    result.frameDuration = frameDuration;
+    result.frameLength = engine.lpc.FRAMELEN;
+    result.blockSize = blockSize;
+    result.channels = numChannels;
+    result.sampleRate = sampleRate;
+    result.excitation = excitation;
+    result.numBlocks = numBlocks;
+    double total = 0.0;
+    for (double t : times) {
+        total += t;
+    }
+    result.meanUs = total/times.size();
+    result.budgetUs = 1e6*blockSize/sampleRate;
+    result.realtimeFactor = result.budgetUs*times.size()/total;
+    std::sort(times.begin(), times.end());
+    result.p99Us = times[std::min(times.size() - 1, static_cast<size_t>(std::ceil(0.99*times.size())) - 1)];
+    result.maxUs = times.back();
+    result.headroom = 1.0 - result.p99Us/result.budgetUs;
+    return result;
+}
+
+void writeJson(std::ostream& out, const Config& config, const vector<Result>& results) {
+    out << "{\n  \"benchmark\": \"lpmorph-bench-realtime\",\n  \"version\": 1,\n";
+#if defined(__VERSION__)
+    out << "  \"compiler\": " << jsonString(__VERSION__) << ",\n";
+#endif
+#if defined(NDEBUG)
+    out << "  \"assertions\": false,\n";
+#else
+    out << "  \"assertions\": true,\n";
+#endif
+    out << "  \"seconds_per_run\": " << config.seconds << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        out << "    {\"order\": " << r.order
+            << ", \"frame_duration_ms\": " << r.frameDuration
+            << ", \"frame_length\": " << r.frameLength
+            << ", \"block_size\": " << r.blockSize
+            << ", \"channels\": " << r.channels
+            << ", \"sample_rate\": " << r.sampleRate
+            << ", \"excitation\": " << jsonString(r.excitation)
+            << ", \"blocks\": " << r.numBlocks
+            << ", \"mean_us\": " << r.meanUs
+            << ", \"p99_us\": " << r.p99Us
+            << ", \"max_us\": " << r.maxUs
+            << ", \"budget_us\": " << r.budgetUs
+            << ", \"realtime_factor\": " << r.realtimeFactor
+            << ", \"headroom\": " << r.headroom
+            << (config.counters ? r.counters.json() : "")
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void printUsage() {
+    std::cout << "usage: lpmorph-bench-realtime [--orders LIST] [--frames LIST] [--blocks LIST]\n"
+                 "                              [--channels LIST] [--rates LIST] [--excitations LIST]\n"
+                 "                              [--seconds S] [--counters] [--json FILE]\n"
+                 "excitations: table, noise, pulse, glottal, midi, midi16, sidechain\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool ok = hasValue;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if (arg == "--orders" && hasValue) {
+            ok = parseList(argv[++i], config.orders);
+        }
+        else if (arg == "--frames" && hasValue) {
+            ok = parseList(argv[++i], config.frameDurations);
+        }
+        else if (arg == "--blocks" && hasValue) {
+            ok = parseList(argv[++i], config.blockSizes);
+        }
+        else if (arg == "--channels" && hasValue) {
+            ok = parseList(argv[++i], config.channelCounts);
+        }
+        else if (arg == "--rates" && hasValue) {
+            ok = parseList(argv[++i], config.sampleRates);
+        }
+        else if (arg == "--excitations" && hasValue) {
+            ok = parseList(argv[++i], config.excitations);
+        }
+        else if (arg == "--seconds" && hasValue) {
+            config.seconds = std::atof(argv[++i]);
+            ok = config.seconds > 0.0;
+        }
+        else if (arg == "--counters") {
+            config.counters = true;
+            ok = true;
+        }
+        else if (arg == "--json" && hasValue) {
+            config.jsonPath = argv[++i];
+        }
+        else {
+            ok = false;
+        }
+        if (!ok) {
+            printUsage();
+            return 1;
+        }
+    }
+    for (const auto& excitation : config.excitations) {
+        if (excitation != "table" && exTypeFor(excitation) == 0) {
+            std::cerr << "unknown excitation " << excitation << std::endl;
+            return 1;
+        }
+    }
+    for (int order : config.orders) {
+        if (order < 1 || order > MAX_ORDER) {
+            std::cerr << "orders must be between 1 and " << MAX_ORDER << std::endl;
+            return 1;
+        }
+    }
+
+    PerfCounters perfCounters;
+    if (config.counters && !perfCounters.available()) {
+        std::printf("counters: unavailable, %s; timing only\n", perfCounters.reason().c_str());
+        config.counters = false;
+    }
+
+    vector<Result> results;
+    std::printf("%5s %6s %6s %5s %3s %6s %-9s %9s %9s %9s %9s %8s %8s%s\n",
+                "order", "frame", "len", "block", "ch", "rate", "exc", "mean_us", "p99_us", "max_us", "budget", "rtf", "headroom",
+                config.counters ? CounterReadings::header() : "");
+    for (double sampleRate : config.sampleRates) {
+        vector<double> frameDurations;
+        vector<int> frameLengths;
+        for (double frameDuration : config.frameDurations) {
+            const int frameLength = frameLengthFor(frameDuration, sampleRate);
+            if (std::find(frameLengths.begin(), frameLengths.end(), frameLength) != frameLengths.end()) {
+                std::printf("frame %.1f ms at %.0f Hz skipped, its %d-sample frame is already swept\n", frameDuration, sampleRate, frameLength);
+                continue;
+            }
+            frameDurations.push_back(frameDuration);
+            frameLengths.push_back(frameLength);
+        }
+        for (int numChannels : config.channelCounts) {
+            for (const auto& excitation : config.excitations) {
+                for (int order : config.orders) {
+                    for (double frameDuration : frameDurations) {
+                        for (int blockSize : config.blockSizes) {
+                            Result r = run(config, config.counters ? &perfCounters : nullptr, order, frameDuration, blockSize, numChannels, sampleRate, excitation);
+                            std::printf("%5d %6.1f %6d %5d %3d %6.0f %-9s %9.2f %9.2f %9.2f %9.2f %8.1f %7.1f%%%s\n",
+                                        r.order, r.frameDuration, r.frameLength, r.blockSize, r.channels, r.sampleRate, r.excitation.c_str(),
+                                        r.meanUs, r.p99Us, r.maxUs, r.budgetUs, r.realtimeFactor, 100.0*r.headroom,
+                                        config.counters ? r.counters.columns().c_str() : "");
+                            std::fflush(stdout);
+                            results.push_back(r);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (!config.jsonPath.empty()) {
+        std::ofstream json(config.jsonPath);
+        writeJson(json, config, results);
+        if (!json) {
+            std::cerr << "cannot write " << config.jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include "lpmorph_dsp.h"
+#include "lpc_engine.h"
+#include "denormals.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+static_assert(LPMORPH_MAX_ORDER == MAX_ORDER, "lpmorph_dsp.h is out of step with lpc_limits.h");
+static_assert(LPMORPH_MAX_FRAME_DURATION_MS == MAX_FRAME_DUR, "lpmorph_dsp.h is out of step with lpc_limits.h");
+
+namespace {
+const int maxChannels = 64;
+}
+
+struct lpmorph_engine {
+    explicit lpmorph_engine(int numChannels) : engine(numChannels), numChannels(numChannels) {}
+
+    LPCEngine engine;
+    int numChannels;
+    bool prepared = false;
+    vector<double> table;
+
+    // Written by the setters from any thread, read at the start of each block
+    std::atomic<float> wetGain{0.f};
+    std::atomic<float> mix{0.f};
+    std::atomic<int> order{MAX_ORDER/2};
+    std::atomic<float> frameDuration{10.f};
+    std::atomic<int> excitation{LPMORPH_EXCITATION_NOISE};
+    std::atomic<float> exStart{0.f};
+    std::atomic<float> exLength{1.f};
+
+    LPCParameters readParameters() const {
+        LPCParameters params;
+        params.wetGain = wetGain.load(std::memory_order_relaxed);
+        params.lpcMix = mix.load(std::memory_order_relaxed);
+        params.exLen = exLength.load(std::memory_order_relaxed);
+        params.exStartPos = exStart.load(std::memory_order_relaxed);
+        params.lpcOrder = order.load(std::memory_order_relaxed);
+        params.frameDur = frameDuration.load(std::memory_order_relaxed);
+        // Without factory tables, exType indexes straight into the generators
+        // that follow "Off", then the MIDI voices
+        const int type = excitation.load(std::memory_order_relaxed);
+        params.exType = type == LPMORPH_EXCITATION_TABLE ? 0 : type;
+        return params;
+    }
+
+    LPCExcitation readExcitation() const {
+        LPCExcitation ex;
+        if (excitation.load(std::memory_order_relaxed) == LPMORPH_EXCITATION_TABLE) {
+            ex.table = table.empty() ? nullptr : &table;
+            ex.custom = true;
+        }
+        return ex;
+    }
+
+    void buildSegment() {
+        if (!table.empty()) {
+            engine.buildExcitationSegment(&table, readParameters());
+        }
+    }
+};
+
+extern "C" {
+
+lpmorph_engine* lpmorph_create(int num_channels) {
+    if (num_channels < 1 || num_channels > maxChannels) {
+        return nullptr;
+    }
+    try {
+        return new lpmorph_engine(num_channels);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void lpmorph_destroy(lpmorph_engine* engine) {
+    delete engine;
+}
+
+int lpmorph_prepare(lpmorph_engine* engine, double sample_rate) {
+    if (engine == nullptr || !(sample_rate >= 8000.0 && sample_rate <= 384000.0)) {
+        return LPMORPH_ERROR_INVALID_ARGUMENT;
+    }
+    try {
+        engine->engine.prepare(sample_rate, engine->readParameters(), engine->readExcitation());
+        engine->buildSegment();
+        engine->engine.lpc.beginBlock();
+    }
+    catch (const std::bad_alloc&) {
+        engine->prepared = false;
+        return LPMORPH_ERROR_OUT_OF_MEMORY;
+    }
+    engine->prepared = true;
+    return LPMORPH_OK;
+}
+
+int lpmorph_process(lpmorph_engine* engine, const float* const* inputs, float* const* outputs, const float* const* sidechains, int num_samples) {
+    return lpmorph_process_strided(engine, inputs, outputs, sidechains, num_samples, 1, 1);
+}
+
+int lpmorph_process_strided(lpmorph_engine* engine, const float* const* inputs, float* const* outputs, const float* const* sidechains, int num_samples, int input_stride, int output_stride) {
+    if (engine == nullptr || inputs == nullptr || outputs == nullptr || num_samples < 0 || input_stride == 0 || output_stride == 0) {
+        return LPMORPH_ERROR_INVALID_ARGUMENT;
+    }
+    if (!engine->prepared) {
+        return LPMORPH_ERROR_NOT_PREPARED;
+    }
+    if (num_samples == 0) {
+        return LPMORPH_OK;
+    }
+    // The plugin renders with denormals flushed, and so must we to match it
+    ScopedFlushDenormals noDenormals;
+    LPCEngine& lpcEngine = engine->engine;
+    lpcEngine.beginBlock(engine->readParameters(), engine->readExcitation());
+    const LPC& lpc = lpcEngine.lpc;
+    const bool hasExcitation = lpc.noise != nullptr || lpc.generator != ExcitationGenerator::none || lpc.midiExcitation;
+    bool clipped = false;
+    for (int ch = 0; ch < engine->numChannels; ch++) {
+        if (!hasExcitation) {
+            // The engine leaves the block alone, which is a pass-through only in place
+            if (outputs[ch] == inputs[ch] && output_stride == input_stride) {
+                continue;
+            }
+            if (input_stride == 1 && output_stride == 1) {
+                memcpy(outputs[ch], inputs[ch], sizeof(float)*num_samples);
+            }
+            else {
+                for (int i = 0; i < num_samples; i++) {
+                    outputs[ch][i*output_stride] = inputs[ch][i*input_stride];
+                }
+            }
+            continue;
+        }
+        const float* sidechain = sidechains != nullptr ? sidechains[ch] : nullptr;
+        if (lpcEngine.processChannel(inputs[ch], outputs[ch], num_samples, ch, sidechain, input_stride, output_stride)) {
+            clipped = true;
+        }
+    }
+    lpcEngine.endBlock();
+    return clipped ? LPMORPH_CLIPPED : LPMORPH_OK;
+}
+
+int lpmorph_get_latency(const lpmorph_engine* engine) {
+    return engine != nullptr ? engine->engine.lpc.FRAMELEN : 0;
+}
+
+int lpmorph_get_hop_size(const lpmorph_engine* engine) {
+    return engine != nullptr ? engine->engine.lpc.HOPSIZE : 0;
+}
+
+void lpmorph_set_wet_gain(lpmorph_engine* engine, float decibels) {
+    if (engine == nullptr) {
+        return;
+    }
+    engine->wetGain.store(std::min(std::max(decibels, -40.f), 20.f), std::memory_order_relaxed);
+}
+
+void lpmorph_set_mix(lpmorph_engine* engine, float mix) {
+    if (engine == nullptr) {
+        return;
+    }
+    engine->mix.store(std::min(std::max(mix, 0.f), 1.f), std::memory_order_relaxed);
+}
+
+void lpmorph_set_order(lpmorph_engine* engine, int order) {
+    if (engine == nullptr) {
+        return;
+    }
+    engine->order.store(std::min(std::max(order, 1), MAX_ORDER), std::memory_order_relaxed);
+}
+
+void lpmorph_set_frame_duration(lpmorph_engine* engine, float milliseconds) {
+    if (engine == nullptr) {
+        return;
+    }
+    engine->frameDuration.store(std::min(std::max(milliseconds, 0.1f), (float)MAX_FRAME_DUR), std::memory_order_relaxed);
+}
+
+void lpmorph_set_excitation(lpmorph_engine* engine, lpmorph_excitation excitation) {
+    if (engine == nullptr) {
+        return;
+    }
+    int type = std::min(std::max(static_cast<int>(excitation), 0), static_cast<int>(LPMORPH_EXCITATION_TABLE));
+    engine->excitation.store(type, std::memory_order_relaxed);
+}
+
+int lpmorph_set_excitation_table(lpmorph_engine* engine, const float* samples, size_t num_samples) {
+    if (engine == nullptr || (samples == nullptr && num_samples > 0)) {
+        return LPMORPH_ERROR_INVALID_ARGUMENT;
+    }
+    try {
+        // Swapped rather than assigned, so that the segment sees a table at a
+        // new address and rebuilds from it
+        vector<double> table(samples, samples + num_samples);
+        engine->table.swap(table);
+        engine->buildSegment();
+    }
+    catch (const std::bad_alloc&) {
+        engine->table.clear();
+        return LPMORPH_ERROR_OUT_OF_MEMORY;
+    }
+    return LPMORPH_OK;
+}
+
+void lpmorph_set_excitation_loop(lpmorph_engine* engine, float start, float length) {
+    if (engine == nullptr) {
+        return;
+    }
+    engine->exStart.store(std::min(std::max(start, 0.f), 1.f), std::memory_order_relaxed);
+    engine->exLength.store(std::min(std::max(length, 0.0001f), 1.f), std::memory_order_relaxed);
+    try {
+        engine->buildSegment();
+    }
+    catch (const std::bad_alloc&) {
+        // The segment keeps the loop it was built with
+    }
+}
+
+void lpmorph_note_on(lpmorph_engine* engine, int note, float velocity) {
+    if (engine == nullptr) {
+        return;
+    }
+    engine->engine.lpc.voices.noteOn(note, velocity);
+}
+
+void lpmorph_note_off(lpmorph_engine* engine, int note) {
+    if (engine == nullptr) {
+        return;
+    }
+    engine->engine.lpc.voices.noteOff(note);
+}
+
+void lpmorph_all_notes_off(lpmorph_engine* engine) {
+    if (engine == nullptr) {
+        return;
+    }
+    engine->engine.lpc.voices.allNotesOff();
+}
+
+}
@@ -0,0 +1,120 @@
+#ifndef LPMORPH_DSP_H
+#define LPMORPH_DSP_H
+
+/*
+ * C interface to the LP Morph engine, for programs that embed it without
+ * JUCE. An engine processes planar float channels exactly as the plugin
+ * does with the same parameters, except that the factory excitations are
+ * not included: excitations are the procedural sources, MIDI notes, the
+ * sidechain or a table supplied by the caller.
+ *
+ * Memory is allocated only by lpmorph_create, lpmorph_prepare,
+ * lpmorph_set_excitation_table, and lpmorph_set_excitation_loop when the
+ * loop grows. lpmorph_process, the other parameter setters and the note
+ * functions never allocate, lock or block, and those setters can be called
+ * from any thread. Every function taking an engine accepts NULL and does
+ * nothing, or returns LPMORPH_ERROR_INVALID_ARGUMENT or 0.
+ */
+
+#include <stddef.h>
+
+#if defined(LPMORPH_DSP_SHARED) && defined(_WIN32)
+ #if defined(LPMORPH_DSP_BUILDING)
+  #define LPMORPH_DSP_API __declspec(dllexport)
+ #else
+  #define LPMORPH_DSP_API __declspec(dllimport)
+ #endif
+#elif defined(LPMORPH_DSP_SHARED) && defined(__GNUC__)
+ #define LPMORPH_DSP_API __attribute__((visibility("default")))
+#else
+ #define LPMORPH_DSP_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lpmorph_engine lpmorph_engine;
+
+enum {
+    LPMORPH_OK = 0,
+    /* lpmorph_process: samples were clipped or NaN, and replaced */
+    LPMORPH_CLIPPED = 1,
+    LPMORPH_ERROR_INVALID_ARGUMENT = -1,
+    LPMORPH_ERROR_NOT_PREPARED = -2,
+    LPMORPH_ERROR_OUT_OF_MEMORY = -3
+};
+
+typedef enum {
+    /* No excitation: audio passes through unchanged */
+    LPMORPH_EXCITATION_OFF = 0,
+    LPMORPH_EXCITATION_NOISE,
+    LPMORPH_EXCITATION_PULSE_TRAIN,
+    LPMORPH_EXCITATION_GLOTTAL_PULSE,
+    /* Sawtooth voices played with lpmorph_note_on and lpmorph_note_off */
+    LPMORPH_EXCITATION_MIDI,
+    /* The table given to lpmorph_set_excitation_table */
+    LPMORPH_EXCITATION_TABLE
+} lpmorph_excitation;
+
+/* The plugin's parameter ranges; setters clamp to them */
+#define LPMORPH_MAX_ORDER 50
+#define LPMORPH_MAX_FRAME_DURATION_MS 50.0f
+
+/* Returns NULL when num_channels is out of range or memory runs out */
+LPMORPH_DSP_API lpmorph_engine* lpmorph_create(int num_channels);
+LPMORPH_DSP_API void lpmorph_destroy(lpmorph_engine* engine);
+
+/* Sets the sample rate and clears all audio state, as a host preparing the
+   plugin does. Call before the first lpmorph_process. */
+LPMORPH_DSP_API int lpmorph_prepare(lpmorph_engine* engine, double sample_rate);
+
+/* Processes num_samples of every channel, in place if outputs alias inputs.
+   sidechains is NULL, or holds a pointer per channel used as the excitation
+   in place of the selected one; NULL entries process without. Not to be
+   called concurrently with itself or the functions that allocate. */
+LPMORPH_DSP_API int lpmorph_process(lpmorph_engine* engine, const float* const* inputs, float* const* outputs, const float* const* sidechains, int num_samples);
+
+/* As lpmorph_process, with sample i of channel ch at inputs[ch][i*input_stride]
+   and outputs[ch][i*output_stride], so that interleaved or otherwise strided
+   audio is processed where it is. Sidechains share the input stride. */
+LPMORPH_DSP_API int lpmorph_process_strided(lpmorph_engine* engine, const float* const* inputs, float* const* outputs, const float* const* sidechains, int num_samples, int input_stride, int output_stride);
+
+/* Delay of the dry signal in samples, and the analysis hop size. Blocks of
+   any length are accepted, but hop-sized blocks add no further latency. */
+LPMORPH_DSP_API int lpmorph_get_latency(const lpmorph_engine* engine);
+LPMORPH_DSP_API int lpmorph_get_hop_size(const lpmorph_engine* engine);
+
+/* Parameters, taking effect from the next lpmorph_process. Defaults match
+   the plugin's, but for the excitation, which is noise. */
+LPMORPH_DSP_API void lpmorph_set_wet_gain(lpmorph_engine* engine, float decibels);
+LPMORPH_DSP_API void lpmorph_set_mix(lpmorph_engine* engine, float mix);
+LPMORPH_DSP_API void lpmorph_set_order(lpmorph_engine* engine, int order);
+/* Currently ignored: the engine, like the plugin, always analyses frames of
+   1024 samples, which lpmorph_get_latency reports. Kept so that callers
+   written against the plugin's parameters need no change. */
+LPMORPH_DSP_API void lpmorph_set_frame_duration(lpmorph_engine* engine, float milliseconds);
+LPMORPH_DSP_API void lpmorph_set_excitation(lpmorph_engine* engine, lpmorph_excitation excitation);
+
+/* Copies samples into the engine as the table excitation. Allocates; not
+   to be called concurrently with lpmorph_process or
+   lpmorph_set_excitation_loop. */
+LPMORPH_DSP_API int lpmorph_set_excitation_table(lpmorph_engine* engine, const float* samples, size_t num_samples);
+
+/* The loop played from the table, as fractions of its length; the length
+   also sets the period of the pulse excitations. Rebuilds the loop without
+   blocking lpmorph_process, so it can run alongside it from one other
+   thread, but allocates when the loop grows; if memory runs out, the
+   previous loop keeps playing. */
+LPMORPH_DSP_API void lpmorph_set_excitation_loop(lpmorph_engine* engine, float start, float length);
+
+/* MIDI excitation, from the thread calling lpmorph_process */
+LPMORPH_DSP_API void lpmorph_note_on(lpmorph_engine* engine, int note, float velocity);
+LPMORPH_DSP_API void lpmorph_note_off(lpmorph_engine* engine, int note);
+LPMORPH_DSP_API void lpmorph_all_notes_off(lpmorph_engine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP > 0)
+ #include <xmmintrin.h>
+ #define LPC_DENORMALS_SSE 1
+#endif
+
+// Flushes denormals to zero on the current thread for the lifetime of the
+// object, as juce::ScopedNoDenormals does, for code that runs the engine
+// without JUCE. Rendering with the same flags keeps results bit-identical to
+// the plugin.
+class ScopedFlushDenormals {
+public:
+    ScopedFlushDenormals() {
+#if defined(LPC_DENORMALS_SSE)
+        previous = _mm_getcsr();
+        // Flush to zero and denormals are zero
+        _mm_setcsr(previous | 0x8040);
+#elif defined(__aarch64__)
+        uint64_t fpcr;
+        asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+        previous = static_cast<uint32_t>(fpcr);
+        asm volatile("msr fpcr, %0" : : "r"(fpcr | (1 << 24)));
+#endif
+    }
+
+    ~ScopedFlushDenormals() {
+#if defined(LPC_DENORMALS_SSE)
+        _mm_setcsr(previous);
+#elif defined(__aarch64__)
+        asm volatile("msr fpcr, %0" : : "r"(static_cast<uint64_t>(previous)));
+#endif
+    }
+
+    ScopedFlushDenormals(const ScopedFlushDenormals&) = delete;
+    ScopedFlushDenormals& operator=(const ScopedFlushDenormals&) = delete;
+
+private:
+    uint32_t previous = 0;
+};
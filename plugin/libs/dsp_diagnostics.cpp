@@ -0,0 +1,37 @@
+#include "dsp_diagnostics.h"
+
+DSPDiagnostics::Snapshot DSPDiagnostics::Snapshot::since(const Snapshot& earlier) const noexcept {
+    Snapshot difference;
+    for (int c = 0; c < numCounters; c++) {
+        difference.counts[c] = counts[c] - earlier.counts[c];
+    }
+    return difference;
+}
+
+void DSPDiagnostics::add(const Snapshot& snapshot) noexcept {
+    for (int c = 0; c < numCounters; c++) {
+        if (snapshot.counts[c] != 0) {
+            add(static_cast<Counter>(c), snapshot.counts[c]);
+        }
+    }
+}
+
+void DSPDiagnostics::read(Snapshot& snapshot) const noexcept {
+    for (int c = 0; c < numCounters; c++) {
+        snapshot.counts[c] = counts[c].load(std::memory_order_relaxed);
+    }
+}
+
+const char* DSPDiagnostics::key(Counter counter) noexcept {
+    static const char* const keys[numCounters] = {
+        "reflection_clamps", "nan_frames", "nan_samples", "clipped_samples", "zero_energy_frames", "excitation_wraps"
+    };
+    return counter >= 0 && counter < numCounters ? keys[counter] : "";
+}
+
+const char* DSPDiagnostics::label(Counter counter) noexcept {
+    static const char* const labels[numCounters] = {
+        "reflection clamps", "NaN frames", "NaN samples", "clipped samples", "silent frames", "excitation wraps"
+    };
+    return counter >= 0 && counter < numCounters ? labels[counter] : "";
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// How often the DSP ran into something it had to correct or skip. Counting
+// takes one relaxed atomic add where it happens, from any thread, and never
+// waits; any other thread can read at any time, and the difference between
+// two snapshots is what happened in between.
+class DSPDiagnostics {
+public:
+    enum Counter {
+        // Reflection coefficients clamped to keep the synthesis filter stable
+        reflectionClamps,
+        // Frames whose analysis came out NaN or infinite
+        nanFrames,
+        // Output samples replaced because they were NaN, or scaled down
+        // because they were beyond full scale
+        nanSamples,
+        clippedSamples,
+        // Frames without energy, which are neither analysed nor synthesised
+        zeroEnergyFrames,
+        // Frames that read past the end of the excitation loop and wrapped
+        excitationWraps,
+        numCounters
+    };
+
+    struct Snapshot {
+        uint64_t counts[numCounters] = {};
+
+        uint64_t operator[](Counter counter) const noexcept { return counts[counter]; }
+        // What happened between earlier and this snapshot
+        Snapshot since(const Snapshot& earlier) const noexcept;
+    };
+
+    void add(Counter counter, uint64_t amount = 1) noexcept {
+        counts[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+    // Adds every count of snapshot, to gather several instances' counts
+    void add(const Snapshot& snapshot) noexcept;
+
+    void read(Snapshot& snapshot) const noexcept;
+
+    // snake_case, for files and other programs
+    static const char* key(Counter counter) noexcept;
+    // Lower case words, for people
+    static const char* label(Counter counter) noexcept;
+
+private:
+    std::atomic<uint64_t> counts[numCounters] = {};
+};
@@ -0,0 +1,180 @@
+#include "dsp_trace.h"
+#if defined(_WIN32)
+ #include <windows.h>
+#else
+ #include <pthread.h>
+ #include <unistd.h>
+ #if defined(__linux__)
+  #include <sys/syscall.h>
+ #endif
+#endif
+
+namespace {
+
+const char* const spanNames[DSPTrace::numNames] = { "processBlock", "applyLPC", "analysis", "synthesis" };
+
+// What count means for each span
+const char* const countNames[DSPTrace::numNames] = { "samples", "samples", "hops", "hops" };
+
+// Cheap to query on Windows and macOS. On Linux it takes a system call, so
+// each thread makes it once, on its first span. The initial-exec model puts
+// the cached ID in the static TLS that every thread gets when it is
+// created, whereas a thread_local in a dynamically loaded plugin's own TLS
+// block is allocated on its first use, which would be on the audio thread.
+uint32_t currentThreadId() noexcept {
+#if defined(_WIN32)
+    return static_cast<uint32_t>(GetCurrentThreadId());
+#elif defined(__linux__)
+    static thread_local uint32_t id __attribute__((tls_model("initial-exec"))) = 0;
+    if (id == 0) {
+        id = static_cast<uint32_t>(syscall(SYS_gettid));
+    }
+    return id;
+#elif defined(__APPLE__)
+    uint64_t id = 0;
+    pthread_threadid_np(nullptr, &id);
+    return static_cast<uint32_t>(id);
+#else
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(pthread_self()));
+#endif
+}
+
+uint32_t currentProcessId() {
+#if defined(_WIN32)
+    return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+}
+
+DSPTrace::~DSPTrace() {
+    stop();
+}
+
+bool DSPTrace::start(const std::string& path, size_t capacity) {
+    stop();
+    file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    size_t numSlots = 1;
+    while (numSlots < capacity) {
+        numSlots <<= 1;
+    }
+    slots.reset(new Slot[numSlots]);
+    for (size_t i = 0; i < numSlots; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    slotMask = numSlots - 1;
+    writePosition = 0;
+    readPosition = 0;
+    droppedSpans = 0;
+    threads.clear();
+    processId = currentProcessId();
+
+    fprintf(file, "[\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %u, \"args\": {\"name\": \"LP Morph\"}}", processId);
+    fflush(file);
+    running = true;
+    writer = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+void DSPTrace::stop() {
+    if (file == nullptr) {
+        return;
+    }
+    running = false;
+    if (writer.joinable()) {
+        writer.join();
+    }
+    drain();
+    writeThreadNames();
+    fprintf(file, "\n]\n");
+    fclose(file);
+    file = nullptr;
+}
+
+void DSPTrace::record(Name name, Clock::time_point begin, Clock::time_point end, int channel, int count) noexcept {
+    // Claims the next slot unless the reader has yet to free it
+    size_t position = writePosition.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots[position & slotMask];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const auto lag = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (lag == 0) {
+            if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (lag < 0) {
+            droppedSpans.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else {
+            position = writePosition.load(std::memory_order_relaxed);
+        }
+    }
+    slot->beginNs = std::chrono::duration_cast<std::chrono::nanoseconds>(begin.time_since_epoch()).count();
+    slot->durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    slot->threadId = currentThreadId();
+    slot->channel = channel;
+    slot->count = count;
+    slot->name = name;
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void DSPTrace::writerLoop() {
+    while (running) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
+
+void DSPTrace::drain() {
+    bool wrote = false;
+    for (;;) {
+        Slot& slot = slots[readPosition & slotMask];
+        if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1) {
+            break;
+        }
+        // Complete events, in microseconds
+        fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"dsp\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %u, \"tid\": %u, \"args\": {",
+                spanNames[slot.name], slot.beginNs/1000.0, slot.durationNs/1000.0, processId, slot.threadId);
+        if (slot.channel >= 0) {
+            fprintf(file, "\"channel\": %d, ", slot.channel);
+        }
+        fprintf(file, "\"%s\": %d}}", countNames[slot.name], slot.count);
+
+        auto thread = threads.begin();
+        while (thread != threads.end() && thread->first != slot.threadId) {
+            ++thread;
+        }
+        if (thread == threads.end()) {
+            threads.emplace_back(slot.threadId, false);
+            thread = threads.end() - 1;
+        }
+        thread->second = thread->second || slot.name == processBlock;
+
+        slot.sequence.store(readPosition + slotMask + 1, std::memory_order_release);
+        readPosition++;
+        wrote = true;
+    }
+    if (wrote) {
+        fflush(file);
+    }
+}
+
+void DSPTrace::writeThreadNames() {
+    const uint64_t dropped = droppedSpans.load();
+    for (const auto& thread : threads) {
+        fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %u, \"tid\": %u, \"args\": {\"name\": \"%s\"}}", processId,
+                thread.first, thread.second ? "LP Morph audio" : "LP Morph worker");
+    }
+    if (dropped > 0) {
+        fprintf(file, ",\n{\"name\": \"process_labels\", \"ph\": \"M\", \"pid\": %u, \"args\": {\"labels\": \"%llu spans dropped\"}}",
+                processId, static_cast<unsigned long long>(dropped));
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Spans of DSP work, written out as a Chrome trace that chrome://tracing and
+// ui.perfetto.dev open next to a trace of the host. Tracing is opt-in: code
+// holding a null DSPTrace* records nothing and pays one branch per span.
+//
+// Any thread can record, the audio thread and the bounce workers alike, into
+// a preallocated ring without locks or allocation; a writer thread drains it
+// to the file. When the ring is full, spans are dropped and counted. Spans
+// are timed with steady_clock and tagged with the OS thread ID, so on Linux
+// they line up with the thread IDs and monotonic clock of a system trace.
+//
+// The file is in the JSON array format, whose closing bracket is optional,
+// so a trace cut short by a crash still loads.
+class DSPTrace {
+public:
+    enum Name : uint8_t { processBlock, applyLPC, analysis, synthesis, numNames };
+
+    using Clock = std::chrono::steady_clock;
+
+    ~DSPTrace();
+
+    // Not real-time safe. capacity is the number of spans the ring holds.
+    bool start(const std::string& path, size_t capacity = 1 << 16);
+    void stop();
+    bool isRecording() const noexcept { return file != nullptr; }
+    uint64_t getDroppedSpans() const noexcept { return droppedSpans.load(); }
+
+    // Any thread. channel is -1 for spans over every channel; count is the
+    // samples of a block or the hops of a chunk.
+    void record(Name name, Clock::time_point begin, Clock::time_point end, int channel, int count) noexcept;
+
+    // Records the enclosing scope, if trace is not null
+    class Span {
+    public:
+        Span(DSPTrace* to, Name spanName, int spanChannel = -1, int spanCount = 0) noexcept
+            : trace(to), name(spanName), channel(spanChannel), count(spanCount) {
+            if (trace != nullptr) {
+                begin = Clock::now();
+            }
+        }
+        ~Span() {
+            if (trace != nullptr) {
+                trace->record(name, begin, Clock::now(), channel, count);
+            }
+        }
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        DSPTrace* trace;
+        Name name;
+        int channel;
+        int count;
+        Clock::time_point begin;
+    };
+
+private:
+    // A span in the ring. sequence says whose turn the slot is: the writer's
+    // when it equals the ring position, the reader's one after that.
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        int64_t beginNs = 0;
+        int64_t durationNs = 0;
+        uint32_t threadId = 0;
+        int32_t channel = 0;
+        int32_t count = 0;
+        Name name = processBlock;
+    };
+
+    void writerLoop();
+    void drain();
+    void writeThreadNames();
+
+    FILE* file = nullptr;
+    std::thread writer;
+    std::atomic<bool> running{false};
+    std::unique_ptr<Slot[]> slots;
+    size_t slotMask = 0;
+    std::atomic<size_t> writePosition{0};
+    size_t readPosition = 0;
+    std::atomic<uint64_t> droppedSpans{0};
+    uint32_t processId = 0;
+    // Threads seen by the writer, and whether each ran processBlock
+    std::vector<std::pair<uint32_t, bool>> threads;
+};
@@ -0,0 +1,140 @@
+#include "excitation_gen.h"
+#include <cmath>
+#include <cstring>
+
+static uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void ExcitationGenerator::prepare(int numChannels, uint64_t seed) {
+    baseSeed = seed;
+    channels.resize(numChannels);
+    for (int ch = 0; ch < numChannels; ch++) {
+        reset(ch);
+    }
+}
+
+void ExcitationGenerator::reset(int ch) {
+    ChannelState& state = channels[ch];
+    // Every channel and lane draws its xorshift state from a different point
+    // of the splitmix sequence, so no two streams are correlated
+    uint64_t x = baseSeed + 0x632be59bd9b4e019ull*(uint64_t)(ch+1);
+    for (int l = 0; l < numLanes; l++) {
+        state.s0[l] = splitmix64(x);
+        state.s1[l] = splitmix64(x);
+    }
+    state.phase = 0.0;
+}
+
+void ExcitationGenerator::generate(Type type, int ch, double* out, int numSamples, double period, int advance) {
+    ChannelState& state = channels[ch];
+    period = period < 2.0 ? 2.0 : period;
+    switch (type) {
+        case noise:
+            generateNoise(state, out, numSamples);
+            break;
+        case pulseTrain:
+            generatePulseTrain(state, out, numSamples, period, advance);
+            break;
+        case glottalPulse:
+            generateGlottalPulse(state, out, numSamples, period, advance);
+            break;
+        default:
+            memset(out, 0, sizeof(double)*numSamples);
+            break;
+    }
+}
+
+void ExcitationGenerator::skip(Type type, int ch, int numSamples, double period, int advance, long long count) {
+    ChannelState& state = channels[ch];
+    period = period < 2.0 ? 2.0 : period;
+    const double inc = 1.0/period;
+    for (long long k = 0; k < count; k++) {
+        if (type == noise) {
+            for (int i = 0; i < numSamples; i += numLanes) {
+                for (int l = 0; l < numLanes; l++) {
+                    uint64_t x = state.s0[l];
+                    const uint64_t y = state.s1[l];
+                    state.s0[l] = y;
+                    x ^= x << 23;
+                    state.s1[l] = x ^ y ^ (x >> 18) ^ (y >> 5);
+                }
+            }
+        }
+        else if (type == pulseTrain || type == glottalPulse) {
+            // Same arithmetic as the generators, so the phase matches exactly
+            state.phase = state.phase + advance*inc;
+            state.phase -= std::floor(state.phase);
+        }
+    }
+}
+
+// xorshift128+ over numLanes independent streams. The top 52 bits are placed
+// in the mantissa of a double in [1, 2), avoiding an integer to float
+// conversion that most SIMD units lack.
+void ExcitationGenerator::generateNoise(ChannelState& state, double* out, int numSamples) {
+    uint64_t s0[numLanes];
+    uint64_t s1[numLanes];
+    memcpy(s0, state.s0, sizeof(s0));
+    memcpy(s1, state.s1, sizeof(s1));
+    for (int i = 0; i < numSamples; i += numLanes) {
+        double block[numLanes];
+        for (int l = 0; l < numLanes; l++) {
+            uint64_t x = s0[l];
+            const uint64_t y = s1[l];
+            const uint64_t result = x + y;
+            s0[l] = y;
+            x ^= x << 23;
+            s1[l] = x ^ y ^ (x >> 18) ^ (y >> 5);
+            const uint64_t bits = (result >> 12) | 0x3ff0000000000000ull;
+            memcpy(&block[l], &bits, sizeof(double));
+        }
+        const int n = numSamples - i < numLanes ? numSamples - i : numLanes;
+        for (int l = 0; l < n; l++) {
+            out[i + l] = 2.0*block[l] - 3.0;
+        }
+    }
+    memcpy(state.s0, s0, sizeof(s0));
+    memcpy(state.s1, s1, sizeof(s1));
+}
+
+// Band-limited impulse train: the closed form of a sum of M = 2*floor(P/2)+1
+// harmonics, normalised so that each pulse peaks at 1
+void ExcitationGenerator::generatePulseTrain(ChannelState& state, double* out, int numSamples, double period, int advance) {
+    const double inc = 1.0/period;
+    const double M = 2.0*std::floor(0.5*period) + 1.0;
+    const double phase0 = state.phase;
+    for (int n = 0; n < numSamples; n++) {
+        double phi = phase0 + n*inc;
+        phi -= std::floor(phi);
+        double num = std::sin(M_PI*M*phi);
+        double den = M*std::sin(M_PI*phi);
+        bool atPulse = std::fabs(den) < 1e-9;
+        out[n] = atPulse ? 1.0 : num/(atPulse ? 1.0 : den);
+    }
+    state.phase = phase0 + advance*inc;
+    state.phase -= std::floor(state.phase);
+}
+
+// Derivative of a Rosenberg glottal flow pulse: a raised-cosine opening over
+// 40% of the period, a quarter-cosine closing over 16%, closed otherwise.
+// Scaled so that the closing excitation peaks at -1.
+void ExcitationGenerator::generateGlottalPulse(ChannelState& state, double* out, int numSamples, double period, int advance) {
+    const double Tp = 0.4;
+    const double Tn = 0.16;
+    const double inc = 1.0/period;
+    const double openScale = (Tn/Tp);
+    const double phase0 = state.phase;
+    for (int n = 0; n < numSamples; n++) {
+        double t = phase0 + n*inc;
+        t -= std::floor(t);
+        double opening = openScale*std::sin(M_PI*t/Tp);
+        double closing = -std::sin(0.5*M_PI*(t - Tp)/Tn);
+        out[n] = t < Tp ? opening : (t < Tp + Tn ? closing : 0.0);
+    }
+    state.phase = phase0 + advance*inc;
+    state.phase -= std::floor(state.phase);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Procedural excitations that need no table memory. Each call fills a whole
+// frame of excitation in one branch-free pass over independent lanes, so the
+// loops vectorize, and each channel runs from its own decorrelated seed.
+class ExcitationGenerator {
+public:
+    enum Type { none = 0, noise, pulseTrain, glottalPulse };
+    static constexpr int numLanes = 8;
+
+    void prepare(int numChannels, uint64_t seed = 0x4c504d6f72706821ull);
+    void reset(int ch);
+    // period is the pulse period in samples, ignored by the noise source.
+    // Renders numSamples, then moves the pulse phase on by advance samples;
+    // advancing by the hop size keeps overlapping frames phase coherent.
+    // The noise source draws fresh samples on every call.
+    void generate(Type type, int ch, double* out, int numSamples, double period, int advance);
+    // Leaves a channel as count calls to generate would, without the samples
+    void skip(Type type, int ch, int numSamples, double period, int advance, long long count);
+
+private:
+    struct ChannelState {
+        uint64_t s0[numLanes];
+        uint64_t s1[numLanes];
+        double phase = 0.0;
+    };
+
+    void generateNoise(ChannelState& state, double* out, int numSamples);
+    void generatePulseTrain(ChannelState& state, double* out, int numSamples, double period, int advance);
+    void generateGlottalPulse(ChannelState& state, double* out, int numSamples, double period, int advance);
+
+    vector<ChannelState> channels;
+    uint64_t baseSeed = 0;
+};
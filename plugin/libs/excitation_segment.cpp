@@ -0,0 +1,57 @@
+#include "excitation_segment.h"
+#include <algorithm>
+
+ExcitationSegment::ExcitationSegment() {
+}
+
+bool ExcitationSegment::rebuild(const vector<double>* table, int start, int length, int padding) {
+    if (table == nullptr || table->empty()) {
+        return false;
+    }
+    const int tableSize = static_cast<int>(table->size());
+    start = std::min(std::max(start, 0), tableSize) % tableSize;
+    length = std::min(std::max(length, 1), tableSize);
+    if (table->data() == builtTableData && table->size() == builtTableSize && start == builtStart && length == builtLength && padding == builtPadding) {
+        return false;
+    }
+
+    Buffer& b = buffers[producerIdx];
+    // Only the part of the loop this buffer does not already hold is copied,
+    // so nudging Length re-copies the tail rather than the whole loop
+    int copyFrom = 0;
+    if (b.tableData == table->data() && b.tableSize == table->size() && b.start == start) {
+        copyFrom = std::min(b.length, length);
+    }
+    b.samples.resize(length + padding);
+    const double* src = table->data();
+    for (int j = copyFrom; j < length;) {
+        int idx = (start + j) % tableSize;
+        int run = std::min(length - j, tableSize - idx);
+        std::copy(src + idx, src + idx + run, b.samples.begin() + j);
+        j += run;
+    }
+    for (int j = 0; j < padding;) {
+        int run = std::min(padding - j, length);
+        std::copy(b.samples.begin(), b.samples.begin() + run, b.samples.begin() + length + j);
+        j += run;
+    }
+    b.tableData = table->data();
+    b.tableSize = table->size();
+    b.start = start;
+    b.length = length;
+    b.padding = padding;
+
+    producerIdx = middleIdx.exchange(producerIdx | dirtyFlag) & ~dirtyFlag;
+    builtTableData = table->data();
+    builtTableSize = table->size();
+    builtStart = start;
+    builtLength = length;
+    builtPadding = padding;
+    return true;
+}
+
+void ExcitationSegment::refresh() noexcept {
+    if (middleIdx.load() & dirtyFlag) {
+        consumerIdx = middleIdx.exchange(consumerIdx) & ~dirtyFlag;
+    }
+}
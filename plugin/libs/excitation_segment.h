@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+using namespace std;
+
+// The active excitation loop (start, length, wrap at the end of the table)
+// copied into a contiguous buffer, padded with the first samples of the loop
+// so that any frame starting inside the loop can be read without wrapping.
+//
+// Three buffers are rotated lock-free: the builder owns one, the audio thread
+// owns another and the third is exchanged between them, so rebuilding never
+// blocks synthesis and synthesis never sees a half-written segment.
+class ExcitationSegment {
+public:
+    ExcitationSegment();
+
+    // Builder side, one thread at a time. Allocates only when the loop grows.
+    // Returns true when a new segment was published.
+    bool rebuild(const vector<double>* table, int start, int length, int padding);
+
+    // Audio thread: picks up the most recently published segment.
+    void refresh() noexcept;
+    const double* data() const noexcept { return buffers[consumerIdx].samples.data(); }
+    int length() const noexcept { return buffers[consumerIdx].length; }
+    int start() const noexcept { return buffers[consumerIdx].start; }
+    int tableSize() const noexcept { return static_cast<int>(buffers[consumerIdx].tableSize); }
+    // The table the segment was cut from
+    const double* tableData() const noexcept { return buffers[consumerIdx].tableData; }
+
+private:
+    struct Buffer {
+        vector<double> samples;
+        const double* tableData = nullptr;
+        size_t tableSize = 0;
+        int start = 0;
+        int length = 0;
+        int padding = 0;
+    };
+    static constexpr int dirtyFlag = 4;
+
+    Buffer buffers[3];
+    std::atomic<int> middleIdx{2};
+    int producerIdx = 0;
+    int consumerIdx = 1;
+    // What was last published, to skip rebuilding an unchanged loop
+    const double* builtTableData = nullptr;
+    size_t builtTableSize = 0;
+    int builtStart = -1;
+    int builtLength = -1;
+    int builtPadding = -1;
+};
@@ -1,4 +1,5 @@
 #include "lpc.h"
+#include "lpc_kernels.h"
 #include <fstream>
 
 LPC::LPC(int numChannels) {
@@ -14,24 +15,19 @@ LPC::LPC(int numChannels) {
     outWtPtrs.resize(numChannels);
     outRdPtrs.resize(numChannels);
     exPtrs.resize(numChannels);
-    histPtrs.resize(numChannels);
     exCntPtrs.resize(numChannels);
+    tracks.assign(numChannels, nullptr);
+    hopCounts.assign(numChannels, 0);
     for (int ch = 0; ch < numChannels; ch++) {
         inWtPtrs[ch] = 0;
         smpCnts[ch] = 0;
         outWtPtrs[ch] = HOPSIZE;
         outRdPtrs[ch] = 0;
         exPtrs[ch] = 0;
-        histPtrs[ch] = 0;
         exCntPtrs[ch] = 0;
         inRdPtrs[ch] = 0;
     }
-    phi.resize(ORDER+1);
-    alphas.resize(ORDER+1);
-    alphasPrev.resize(ORDER+1);
-    reflectionCoeffs.resize(ORDER);
-    orderedInBuf.resize(FRAMELEN);
-    orderedScBuf.resize(FRAMELEN);
+    prepareChunks();
     window.resize(FRAMELEN);
     inBuf.resize(numChannels);
     outBuf.resize(numChannels);
@@ -53,57 +49,19 @@ LPC::LPC(int numChannels) {
     for (int i = 0; i < FRAMELEN; i++) {
         window[i] = 0.5*(1.0-cos(2.0*M_PI*i/(double)(FRAMELEN-1)));
     }
-    for (int i = 0; i < orderedInBuf.size(); i++) {
-        orderedInBuf[i] = 0.0;
-        orderedScBuf[i] = 0.0;
-    }
-    for (int i = 0; i < ORDER; i++) {
-        phi[i] = 0.0;
-    }
-    phi[ORDER] = 0.0;
-    reset_a();
-    DBG("DEBUGGING MODE");
+    exGenerator.prepare(numChannels);
+    voices.prepare(numChannels, SAMPLERATE);
 }
 
-//http://www.emptyloop.com/technotes/A%20tutorial%20on%20linear%20prediction%20and%20Levinson-Durbin.pdf
-double LPC::levinson_durbin() {
-    reset_a();
-    double E = phi[0];
-    for (int k = 0; k < ORDER; k++) {
-        double lbda = 0.0;
-        for (int j = 0; j <= k; j++) {
-            lbda += alphas[j] * phi[k + 1 - j];
-        }
-        lbda = -lbda / E;
-        reflectionCoeffs[k] = lbda;  // Store reflection coefficient
-        // Clamp reflection coefficient for stability
-        if (reflectionCoeffs[k] >= 1.0) {
-            reflectionCoeffs[k] = 0.999;
-            std::cout<<"clamped"<<std::endl;
-        }
-        if (reflectionCoeffs[k] <= -1.0) {
-            reflectionCoeffs[k] = -0.999;
-            std::cout<<"clamped"<<std::endl;
-        }
-        int half = (k + 1) / 2;
-        for (int n = 0; n <= half; n++) {
-            double tmp = alphas[k + 1 - n] + lbda * alphas[n];
-            alphas[n] += lbda * alphas[k + 1 - n];
-            alphas[k + 1 - n] = tmp;
-        }
-        E *= (1.0 - lbda * lbda);
+double LPC::levinson_durbin(LPCFrameScratch &scratch, double *reflectionCoeffs) {
+    int clamps = 0;
+    double E = LPCKernels::levinsonDurbin(scratch.phi.data(), scratch.alphas.data(), reflectionCoeffs, ORDER, clamps);
+    if (clamps > 0) {
+        diagnostics.add(DSPDiagnostics::reflectionClamps, clamps);
     }
     return E;
 }
 
-double LPC::autocorrelate(const vector<double>& x, int frameSize, int lag) {
-    double res = 0.0;
-    for (int n = 0; n < frameSize-lag; n++) {
-        res += x[n]*x[n+lag];
-    }
-    return res;
-}
-
 void LPC::prepareToPlay() {
     inWtPtrs.resize(totalNumChannels);
     inRdPtrs.resize(totalNumChannels);
@@ -111,8 +69,11 @@ void LPC::prepareToPlay() {
     outWtPtrs.resize(totalNumChannels);
     outRdPtrs.resize(totalNumChannels);
     exPtrs.resize(totalNumChannels);
-    histPtrs.resize(totalNumChannels);
     exCntPtrs.resize(totalNumChannels);
+    tracks.resize(totalNumChannels, nullptr);
+    hopCounts.assign(totalNumChannels, 0);
+    exGenerator.prepare(totalNumChannels);
+    voices.prepare(totalNumChannels, SAMPLERATE);
     HOPSIZE = FRAMELEN/2;
     prevFrameLen = FRAMELEN;
     for (int i = 0; i < FRAMELEN; i++) {
@@ -124,191 +85,293 @@ void LPC::prepareToPlay() {
         outWtPtrs[ch] = HOPSIZE;
         outRdPtrs[ch] = 0;
         exPtrs[ch] = 0;
-        histPtrs[ch] = 0;
         exCntPtrs[ch] = 0;
         inRdPtrs[ch] = 0;
     }
+    prepareChunks();
     inBuf.resize(totalNumChannels);
     outBuf.resize(totalNumChannels);
     out_hist.resize(totalNumChannels);
+    scBuf.resize(totalNumChannels);
+    // Start from silence, so that a prepared instance renders exactly like a
+    // newly constructed one
     for (int ch = 0; ch < totalNumChannels; ch++) {
-        inBuf[ch].resize(BUFLEN);
-        outBuf[ch].resize(BUFLEN);
-        out_hist[ch].resize(MAX_ORDER);
+        inBuf[ch].assign(BUFLEN, 0.0);
+        scBuf[ch].assign(BUFLEN, 0.0);
+        outBuf[ch].assign(BUFLEN, 0.0);
+        out_hist[ch].assign(MAX_ORDER, 0.0);
+    }
+}
+
+bool LPC::buildExcitationSegment(const vector<double>* table, float exStartPos, float exPercentage) {
+    if (table == nullptr || table->empty()) {
+        return false;
+    }
+    int tableLen = static_cast<int>(table->size());
+    int loopStart = static_cast<int>(exStartPos*tableLen);
+    int loopLen = static_cast<int>(exPercentage*tableLen);
+    return buildExcitationSegmentAt(table, loopStart, loopLen);
+}
+
+bool LPC::buildExcitationSegmentAt(const vector<double>* table, int loopStart, int loopLength) {
+    if (table == nullptr || table->empty()) {
+        return false;
+    }
+    // Padding by the longest frame lets every frame be read in one run
+    return exSegment.rebuild(table, loopStart, loopLength, static_cast<int>(window.size()));
+}
+
+void LPC::prepareChunks() {
+    chunks.resize(totalNumChannels);
+    for (auto& chunk : chunks) {
+        // Sized for the longest frame, so that no stage allocates
+        int maxFrameLen = static_cast<int>(window.size()) > FRAMELEN ? static_cast<int>(window.size()) : FRAMELEN;
+        chunk.scratch.prepare(maxFrameLen);
+        chunk.hops.resize(maxChunkHops, MAX_ORDER);
+        chunk.hopEnds.assign(maxChunkHops, 0);
+        chunk.orderedScBuf.assign(maxFrameLen, 0.0);
+        chunk.exFrame.assign(maxFrameLen, 0.0);
+        chunk.firstHop = 0;
+        chunk.numSamples = 0;
+        chunk.numHops = 0;
+    }
+}
+
+bool LPC::isActiveFrame(const float *frame) {
+    LPCFrameScratch& scratch = chunks[0].scratch;
+    for (int i = 0; i < FRAMELEN; i++) {
+        scratch.frame[i] = window[i]*(double)frame[i];
+    }
+    return LPCKernels::autocorrelate(scratch.frame.data(), FRAMELEN, 0) != 0;
+}
+
+bool LPC::analyseOrderedFrame(LPCFrameScratch &scratch, double *reflection, double &gain) {
+    for (int lag = 0; lag < ORDER+1; lag++) {
+        scratch.phi[lag] = LPCKernels::autocorrelate(scratch.frame.data(), FRAMELEN, lag);
+    }
+    if (scratch.phi[0] == 0) {
+        diagnostics.add(DSPDiagnostics::zeroEnergyFrames);
+        return false;
+    }
+    gain = sqrt(levinson_durbin(scratch, reflection));
+    if (!std::isfinite(gain)) {
+        diagnostics.add(DSPDiagnostics::nanFrames);
     }
+    return true;
+}
+
+bool LPC::analyseFrame(const float *frame, double *reflection, double &gain) {
+    LPCFrameScratch& scratch = chunks[0].scratch;
+    for (int i = 0; i < FRAMELEN; i++) {
+        scratch.frame[i] = window[i]*(double)frame[i];
+    }
+    return analyseOrderedFrame(scratch, reflection, gain);
+}
+
+void LPC::setCoefficientTrack(int ch, const LPCCoefficientTrack *track) {
+    tracks[ch] = track;
+    hopCounts[ch] = 0;
 }
 
-bool LPC::applyLPC(const float *input, float *output, int numSamples, float lpcMix, float exPercentage, int ch, float exStartPos, const float *sidechain, float previousGain, float currentGain) {
+void LPC::seek(int ch, const float *history, int historyLength, long long activeFrames) {
+    int n = historyLength < BUFLEN ? historyLength : BUFLEN;
+    history += historyLength - n;
+    for (int i = 0; i < n; i++) {
+        inBuf[ch][(inWtPtrs[ch] - n + i + BUFLEN)%BUFLEN] = (double)history[i];
+    }
+    // Advance the excitation source as applyLPC does for every synthesised frame
+    if (midiExcitation) {
+        for (long long k = 0; k < activeFrames; k++) {
+            voices.render(ch, chunks[ch].exFrame.data(), FRAMELEN, HOPSIZE);
+        }
+    }
+    else if (generator != ExcitationGenerator::none) {
+        exGenerator.skip(generator, ch, FRAMELEN, generatorPeriod, HOPSIZE, activeFrames);
+    }
+    else if (exSegment.length() > 0) {
+        long long segLen = exSegment.length();
+        exCntPtrs[ch] = static_cast<int>((exCntPtrs[ch]%segLen + (activeFrames%segLen)*FRAMELEN)%segLen);
+        exPtrs[ch] = (exSegment.start() + exCntPtrs[ch])%exSegment.tableSize();
+    }
+}
+
+void LPC::beginBlock() {
+    exSegment.refresh();
+}
+
+bool LPC::applyLPC(const float *input, float *output, int numSamples, float lpcMix, int ch, const float *sidechain, float previousGain, float currentGain, int inputStride, int outputStride) {
     bool audioWarning = false;
-    if (noise == nullptr) {
+    DSPTrace::Span span(trace, DSPTrace::applyLPC, ch, numSamples);
+    if (!beginChannel(ch)) {
         return audioWarning;
     }
-    inWtPtr = inWtPtrs[ch];
-    inRdPtr = inRdPtrs[ch];
-    smpCnt = smpCnts[ch];
-    outRdPtr = outRdPtrs[ch];
-    outWtPtr = (outRdPtr+HOPSIZE)%BUFLEN;
-    int exStart = static_cast<int>(exStartPos*EXLEN);
+    double slope = (currentGain-previousGain)/numSamples;
+    ChunkState& chunk = chunks[ch];
+    for (int offset = 0; offset < numSamples; offset += chunk.numSamples) {
+        int n = std::min(maxChunkSize(), numSamples - offset);
+        const auto t0 = StageTiming::Clock::now();
+        int numHops = ingestChunk(ch, input + offset*inputStride, sidechain != nullptr ? sidechain + offset*inputStride : nullptr, n, inputStride);
+        const auto t1 = StageTiming::Clock::now();
+        analyseChunk(ch, 0, numHops, chunk.scratch);
+        const auto t2 = StageTiming::Clock::now();
+        synthesiseChunk(ch, sidechain != nullptr);
+        const auto t3 = StageTiming::Clock::now();
+        if (outputChunk(ch, output + offset*outputStride, lpcMix, previousGain, slope, offset, outputStride)) {
+            audioWarning = true;
+        }
+        const auto t4 = StageTiming::Clock::now();
+        timing.addStage(StageTiming::ingest, t1 - t0);
+        timing.addStage(StageTiming::analysis, t2 - t1);
+        timing.addStage(StageTiming::synthesis, t3 - t2);
+        timing.addStage(StageTiming::output, t4 - t3);
+    }
+    return audioWarning;
+}
+
+bool LPC::beginChannel(int ch) {
+    if (noise == nullptr && generator == ExcitationGenerator::none && !midiExcitation) {
+        return false;
+    }
+    outWtPtrs[ch] = (outRdPtrs[ch]+HOPSIZE)%BUFLEN;
     if (exTypeChanged) {
-        exPtrs[ch] = exStart;
+        exGenerator.reset(ch);
         exCntPtrs[ch] = 0;
-        histPtrs[ch] = 0;
     }
     if (orderChanged) {
-        for (int i = 0; i < out_hist[ch].size(); i++) {
-            out_hist[ch][i] = 0;
-        }
-        histPtrs[ch] = 0;
+        std::fill(out_hist[ch].begin(), out_hist[ch].end(), 0.0);
     }
-    exPtr = exPtrs[ch];
-    exCntPtr = exCntPtrs[ch];
-    histPtr = histPtrs[ch];
-    double slope = (currentGain-previousGain)/numSamples;
+    return true;
+}
+
+// A chunk never exceeds BUFLEN-FRAMELEN-HOPSIZE samples, so neither the
+// frames analysed nor the dry samples read back are overwritten before the
+// later stages get to them, and synthesis only writes ahead of the samples
+// that the output stage reads.
+int LPC::ingestChunk(int ch, const float *input, const float *sidechain, int numSamples, int inputStride) {
+    ChunkState& chunk = chunks[ch];
+    int inWtPtr = inWtPtrs[ch];
+    int smpCnt = smpCnts[ch];
+    chunk.firstHop = hopCounts[ch];
+    chunk.numSamples = numSamples;
+    chunk.numHops = 0;
     for (int s = 0; s < numSamples; s++) {
-        inBuf[ch][inWtPtr] = (double)input[s];
+        inBuf[ch][inWtPtr] = (double)input[s*inputStride];
         if (sidechain != nullptr) {
-            scBuf[ch][inWtPtr] = sidechain[s];
+            scBuf[ch][inWtPtr] = sidechain[s*inputStride];
         }
         inWtPtr++;
         if (inWtPtr >= BUFLEN) {
             inWtPtr = 0;
         }
-        double out = outBuf[ch][outRdPtr];
-        double in = inBuf[ch][(inRdPtr+BUFLEN-FRAMELEN)%BUFLEN];
-        inRdPtr++;
-        if (inRdPtr >= BUFLEN) {
-            inRdPtr = 0;
-        }
-        double gainFactor = previousGain+slope*(double)s;
-        float final_out = lpcMix*gainFactor*out+(1-lpcMix)*in;
-        if (isnan(final_out)) {
-            audioWarning = true;
-            final_out = 0.f;
-        }
-        else if (fabsf(final_out) > 1.f) {
-            audioWarning = true;
-            final_out /= (2.f*fabsf(final_out));
-        }
-        output[s] = final_out;
-        outBuf[ch][outRdPtr] = 0;
-        outRdPtr++;
-        if (outRdPtr >= BUFLEN) {
-            outRdPtr = 0;
-        }
         smpCnt++;
         if (smpCnt >= HOPSIZE) {
             smpCnt = 0;
+            chunk.hopEnds[chunk.numHops++] = inWtPtr;
+        }
+    }
+    inWtPtrs[ch] = inWtPtr;
+    smpCnts[ch] = smpCnt;
+    hopCounts[ch] += chunk.numHops;
+    return chunk.numHops;
+}
+
+void LPC::analyseChunk(int ch, int firstHop, int numHops, LPCFrameScratch &scratch) {
+    DSPTrace::Span span(numHops > 0 ? trace : nullptr, DSPTrace::analysis, ch, numHops);
+    ChunkState& chunk = chunks[ch];
+    const LPCCoefficientTrack* track = tracks[ch];
+    for (int h = firstHop; h < firstHop + numHops; h++) {
+        double* reflection = chunk.hops.reflection.data() + h*chunk.hops.order;
+        double G = 0.0;
+        bool active = false;
+        long long hop = chunk.firstHop + h;
+        if (track != nullptr && hop < (long long)track->active.size()) {
+            active = track->active[hop] != 0;
+            if (active) {
+                G = track->gains[hop];
+                const double* k = track->reflection.data() + hop*track->order;
+                for (int i = 0; i < ORDER; i++) {
+                    reflection[i] = k[i];
+                }
+            }
+        }
+        else {
+            LPCKernels::windowFrame(inBuf[ch].data(), BUFLEN, chunk.hopEnds[h], window.data(), scratch.frame.data(), FRAMELEN);
+            active = analyseOrderedFrame(scratch, reflection, G);
+        }
+        chunk.hops.active[h] = active;
+        chunk.hops.gains[h] = G;
+    }
+}
+
+void LPC::synthesiseChunk(int ch, bool useSidechain) {
+    ChunkState& chunk = chunks[ch];
+    DSPTrace::Span span(chunk.numHops > 0 ? trace : nullptr, DSPTrace::synthesis, ch, chunk.numHops);
+    vector<double>& exFrame = chunk.exFrame;
+    int outWtPtr = outWtPtrs[ch];
+    int exPtr = exPtrs[ch];
+    int exCntPtr = exCntPtrs[ch];
+    int wraps = 0;
+    for (int h = 0; h < chunk.numHops; h++) {
+        if (useSidechain) {
             for (int i = 0; i < FRAMELEN; i++) {
-                int inBufIdx = (inWtPtr+i-FRAMELEN+BUFLEN)%BUFLEN;
-                orderedInBuf[i] = window[i]*inBuf[ch][inBufIdx];
+                int inBufIdx = (chunk.hopEnds[h]+i-FRAMELEN+BUFLEN)%BUFLEN;
+                chunk.orderedScBuf[i] = scBuf[ch][inBufIdx];
             }
-            if (sidechain != nullptr) {
-                for (int i = 0; i < FRAMELEN; i++) {
-                    int inBufIdx = (inWtPtr+i-FRAMELEN+BUFLEN)%BUFLEN;
-                    orderedScBuf[i] = scBuf[ch][inBufIdx];
-                }
+        }
+        if (chunk.hops.active[h]) {
+            const double G = chunk.hops.gains[h];
+            const double* reflectionCoeffs = chunk.hops.reflection.data() + h*chunk.hops.order;
+            const double* exSrc = nullptr;
+            if (useSidechain) {
+                exSrc = chunk.orderedScBuf.data();
             }
-            for (int lag = 0; lag < ORDER+1; lag++) {
-                phi[lag] = autocorrelate(orderedInBuf, FRAMELEN, lag);
+            else if (midiExcitation) {
+                voices.render(ch, exFrame.data(), FRAMELEN, HOPSIZE);
+                exSrc = exFrame.data();
             }
-            if (phi[0] != 0) {
-                double G = sqrt(levinson_durbin());
-                if (sidechain == nullptr) {
-                    for (int n = 0; n < FRAMELEN; n++) {
-                        double ex = (*noise)[exPtr];
-                        exCntPtr++;
-                        exPtr++;
-                        if (exCntPtr >= static_cast<int>(exPercentage*EXLEN)) {
-                            exCntPtr = 0;
-                            exPtr = exStart;
-                        }
-                        if (exPtr >= EXLEN) {
-                            exPtr = 0;
-                        }
-                        // Lattice filter synthesis
-                        double f = G*ex;
-                        for (int i = ORDER - 1; i >= 0; --i) {
-                            const double ki = reflectionCoeffs[i];
-                            const double bPrev = out_hist[ch][i];      // ẽ^(i-1)[n-1] - backward delay state
-
-                            // Equation 11.100b: e^(i-1)[n] = e^(i)[n] + k_i * ẽ^(i-1)[n-1]
-                            const double fPrev = f + ki * bPrev;
-                            // Equation 11.100c: ẽ^(i)[n] = ẽ^(i-1)[n-1] - k_i * e^(i-1)[n]
-                            const double bNew = bPrev - ki * fPrev;
-
-                            out_hist[ch][i] = bNew;
-                            f = fPrev;
-                        }
-                        double out_n = f;
-                        unsigned long wtIdx = (outWtPtr+n)%BUFLEN;
-                        double preOlaVal = outBuf[ch][wtIdx];
-                        // Change of frame length can cause OLA to add with unwanted audio
-                        // in a correct scenario, OLA with 50% overlap will always be adding with 0s in
-                        // the last HOPSIZE-many samples, so just set the last HOPSIZE-many outputs to
-                        // be equal to out_n
-                        if (n < HOPSIZE) {
-                            outBuf[ch][wtIdx] += out_n;
-                        }
-                        else {
-                            outBuf[ch][wtIdx] = out_n;
-                        }
-                    }
-                }
-                else {
-                    for (int n = 0; n < FRAMELEN; n++) {
-                        double ex = orderedScBuf[n];
-                        // Lattice filter synthesis
-                        double f = G*ex;
-                        for (int i = ORDER - 1; i >= 0; --i) {
-                            const double ki = reflectionCoeffs[i];
-                            const double bPrev = out_hist[ch][i];      // ẽ^(i-1)[n-1] - backward delay state
-
-                            // Equation 11.100b: e^(i-1)[n] = e^(i)[n] + k_i * ẽ^(i-1)[n-1]
-                            const double fPrev = f + ki * bPrev;
-                            // Equation 11.100c: ẽ^(i)[n] = ẽ^(i-1)[n-1] - k_i * e^(i-1)[n]
-                            const double bNew = bPrev - ki * fPrev;
-
-                            out_hist[ch][i] = bNew;
-                            f = fPrev;
-                        }
-                        double out_n = f;
-                        unsigned long wtIdx = (outWtPtr+n)%BUFLEN;
-                        double preOlaVal = outBuf[ch][wtIdx];
-                        if (n < HOPSIZE) {
-                            outBuf[ch][wtIdx] += out_n;
-                        }
-                        else {
-                            outBuf[ch][wtIdx] = out_n;
-                        }
-                    }
-                }
-//                for (int i = 0; i < out_hist[ch].size(); i++) {
-//                    out_hist[ch][i] = 0;
-//                }
-                histPtrs[ch] = 0;
+            else if (generator != ExcitationGenerator::none) {
+                exGenerator.generate(generator, ch, exFrame.data(), FRAMELEN, generatorPeriod, HOPSIZE);
+                exSrc = exFrame.data();
             }
-            outWtPtr += HOPSIZE;
-            if (outWtPtr >= BUFLEN) {
-                outWtPtr -= BUFLEN;
+            else if (exSegment.length() > 0) {
+                // The segment is padded past the loop end, so a whole frame
+                // is one linear read and the loop wraps once per frame
+                int segLen = exSegment.length();
+                exCntPtr %= segLen;
+                exSrc = exSegment.data() + exCntPtr;
+                wraps += (exCntPtr + FRAMELEN)/segLen;
+                exCntPtr = (exCntPtr + FRAMELEN) % segLen;
+                exPtr = (exSegment.start() + exCntPtr) % exSegment.tableSize();
             }
+            if (exSrc != nullptr) {
+                for (int n = 0; n < FRAMELEN; n++) {
+                    exFrame[n] = G*exSrc[n];
+                }
+                LPCKernels::latticeSynthesise(exFrame.data(), FRAMELEN, reflectionCoeffs, out_hist[ch].data(), ORDER);
+                LPCKernels::overlapAdd(exFrame.data(), outBuf[ch].data(), BUFLEN, outWtPtr, FRAMELEN, HOPSIZE);
+            }
+        }
+        outWtPtr += HOPSIZE;
+        if (outWtPtr >= BUFLEN) {
+            outWtPtr -= BUFLEN;
         }
     }
-    inRdPtrs[ch] = inRdPtr;
-    inWtPtrs[ch] = inWtPtr;
-    smpCnts[ch] = smpCnt;
     outWtPtrs[ch] = outWtPtr;
-    outRdPtrs[ch] = outRdPtr;
     exPtrs[ch] = exPtr;
     exCntPtrs[ch] = exCntPtr;
-    histPtrs[ch] = histPtr;
-    return audioWarning;
+    if (wraps > 0) {
+        diagnostics.add(DSPDiagnostics::excitationWraps, wraps);
+    }
 }
 
-void LPC::reset_a() {
-    alphas[0] = 1.0;
-    alphasPrev[0] = 1.0;
-    for (int i = 1; i < ORDER+1; i++) {
-        alphas[i] = 0.0;
-        alphasPrev[i] = 0.0;
+bool LPC::outputChunk(int ch, float *output, float lpcMix, float previousGain, double slope, int offset, int outputStride) {
+    auto counts = LPCKernels::mixOutput(outBuf[ch].data(), outRdPtrs[ch], inBuf[ch].data(), inRdPtrs[ch], BUFLEN, FRAMELEN,
+                                        output, outputStride, chunks[ch].numSamples, lpcMix, previousGain, slope, offset);
+    if (counts.nanSamples > 0) {
+        diagnostics.add(DSPDiagnostics::nanSamples, counts.nanSamples);
+    }
+    if (counts.clippedSamples > 0) {
+        diagnostics.add(DSPDiagnostics::clippedSamples, counts.clippedSamples);
     }
+    return counts.nanSamples > 0 || counts.clippedSamples > 0;
 }
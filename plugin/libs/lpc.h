@@ -1,35 +1,78 @@
+#pragma once
+
 #include <iostream>
+#include <algorithm>
 #include <array>
 #include <random>
 #include <cmath>
-#include <JuceHeader.h>
-#include "../src/ParameterHelper.h"
+#include "lpc_limits.h"
+#include "excitation_segment.h"
+#include "excitation_gen.h"
+#include "voice_pool.h"
+#include "stage_timing.h"
+#include "dsp_diagnostics.h"
+#include "dsp_trace.h"
 
 using namespace std;
 
-class LPC {
-private:
+// The gain and reflection coefficients of every hop's frame, analysed ahead of
+// synthesis for offline rendering. Entry j is the frame of hop j+1 after
+// prepareToPlay.
+struct LPCCoefficientTrack {
+    int order = 0;
+    vector<char> active;
+    vector<double> gains;
+    vector<double> reflection;
+
+    void resize(long long numHops, int trackOrder) {
+        order = trackOrder;
+        active.assign(numHops, 0);
+        gains.assign(numHops, 0.0);
+        reflection.assign(numHops*trackOrder, 0.0);
+    }
+};
+
+// Working memory for analysing one frame. Threads analysing frames at the
+// same time each need their own.
+struct LPCFrameScratch {
+    vector<double> frame;
     vector<double> phi;
     vector<double> alphas;
-    vector<double> alphasPrev;
-    vector<double> reflectionCoeffs;
-    int inWtPtr;
-    int outWtPtr;
-    int outRdPtr;
-    int smpCnt;
-    int exPtr;
-    int histPtr;
-    int exCntPtr;
-    size_t inRdPtr;
+
+    void prepare(int frameLength) {
+        frame.assign(frameLength, 0.0);
+        phi.assign(MAX_ORDER+1, 0.0);
+        alphas.assign(MAX_ORDER+1, 0.0);
+    }
+};
+
+class LPC {
+private:
+    // What the stages of one channel pass on to each other
+    struct ChunkState {
+        LPCFrameScratch scratch;
+        // Analysis of every hop completed in the chunk
+        LPCCoefficientTrack hops;
+        // inBuf write position just after each of those hops' frames
+        vector<int> hopEnds;
+        vector<double> orderedScBuf;
+        vector<double> exFrame;
+        long long firstHop = 0;
+        int numSamples = 0;
+        int numHops = 0;
+    };
+    static constexpr int maxChunkHops = 16;
+
     vector<vector<double>> inBuf;
     vector<vector<double>> scBuf;
-    vector<double> orderedInBuf;
-    vector<double> orderedScBuf;
+    ExcitationSegment exSegment;
+    ExcitationGenerator exGenerator;
     vector<vector<double>> outBuf;
+    vector<ChunkState> chunks;
     
-    double levinson_durbin();
-    double autocorrelate(const vector<double>& x, int frameSize, int lag);
-    void reset_a();
+    double levinson_durbin(LPCFrameScratch &scratch, double *reflection);
+    bool analyseOrderedFrame(LPCFrameScratch &scratch, double *reflection, double &gain);
+    void prepareChunks();
     vector<vector<double>> out_hist;
     
     vector<int> inWtPtrs;
@@ -39,17 +82,62 @@ private:
     vector<int> outRdPtrs;
     vector<int> exPtrs;
     vector<int> exCntPtrs;
-    vector<int> histPtrs;
+    vector<const LPCCoefficientTrack*> tracks;
+    vector<long long> hopCounts;
     int totalNumChannels;
 public:
     LPC(int numChannels);
     bool start = false;
-    bool applyLPC(const float *input, float *output, int numSamples, float lpcMix, float exPercentage, int ch, float exStartPos, const float *sidechain, float previousGain, float currentGain);
+    // Any thread but the audio thread: materialises the loop selected by
+    // Start and Length so that synthesis can read it without wrapping.
+    bool buildExcitationSegment(const vector<double>* table, float exStartPos, float exPercentage);
+    // As above with the loop in samples, for replaying the loop a captured
+    // session was synthesised from
+    bool buildExcitationSegmentAt(const vector<double>* table, int loopStart, int loopLength);
+    // Audio thread: the loop synthesis reads in this block
+    const ExcitationSegment& getExcitationSegment() const { return exSegment; }
+    // Audio thread, once per block before applyLPC
+    void beginBlock();
+    // The strides step through interleaved input and sidechain, and output
+    bool applyLPC(const float *input, float *output, int numSamples, float lpcMix, int ch, const float *sidechain, float previousGain, float currentGain, int inputStride = 1, int outputStride = 1);
+
+    // applyLPC split into stages, for callers spreading a block over threads.
+    // Per channel and block: beginChannel, then for each chunk of at most
+    // maxChunkSize() samples ingestChunk, analyseChunk over all of the
+    // chunk's hops, synthesiseChunk and outputChunk, in that order. Channels
+    // are independent of each other, and the hops of a chunk can be analysed
+    // by several threads at once, each with its own scratch. The result is
+    // bit-identical to applyLPC, which runs the same stages.
+    // Returns false when there is no excitation and the block is left alone.
+    bool beginChannel(int ch);
+    int maxChunkSize() const { return std::min(BUFLEN - FRAMELEN - HOPSIZE, maxChunkHops*HOPSIZE); }
+    // Returns the number of hops completed in the chunk
+    int ingestChunk(int ch, const float *input, const float *sidechain, int numSamples, int inputStride = 1);
+    void analyseChunk(int ch, int firstHop, int numHops, LPCFrameScratch &scratch);
+    void synthesiseChunk(int ch, bool useSidechain);
+    // offset is the chunk's position in the block, for the gain ramp
+    bool outputChunk(int ch, float *output, float lpcMix, float previousGain, double slope, int offset, int outputStride = 1);
+    // Whether applyLPC would synthesise the FRAMELEN samples starting at
+    // frame, i.e. the windowed frame has energy
+    bool isActiveFrame(const float *frame);
+    // Analyses the FRAMELEN samples starting at frame as a hop of applyLPC
+    // would, into ORDER reflection coefficients and a gain. Returns false for
+    // a frame without energy, which is not synthesised.
+    bool analyseFrame(const float *frame, double *reflection, double &gain);
+    // Offline: synthesise channel ch from a precomputed track instead of
+    // analysing the input, or from the input again with nullptr. The track's
+    // order must match ORDER.
+    void setCoefficientTrack(int ch, const LPCCoefficientTrack *track);
+    // Puts a prepared channel in the state it would have after the input
+    // ending with history, during which activeFrames frames were synthesised.
+    // Input history and excitation position are restored exactly; the
+    // synthesis filter memory and overlap-add buffer are not, and settle after
+    // a pre-roll of a few frames.
+    void seek(int ch, const float *history, int historyLength, long long activeFrames);
     void set_exlen(int val) {EXLEN = val;}
     int get_exlen() {return EXLEN;}
     int get_max_exlen() {return MAX_EXLEN;}
-    int getCurrentExPtr(int channel = 0) const { return channel < exPtrs.size() ? exPtrs[channel] : 0; }
-    const std::vector<double>& getAlphas() const { return alphas; }
+    int getCurrentExPtr(int channel = 0) const { return channel < static_cast<int>(exPtrs.size()) ? exPtrs[channel] : 0; }
     const std::vector<double>* noise = nullptr;
     int FRAMELEN;
     int prevFrameLen;
@@ -60,10 +148,21 @@ public:
     int EXLEN = MAX_EXLEN;
     int ORDER;
     int exType = 0;
+    // Takes precedence over the table excitation when not none
+    ExcitationGenerator::Type generator = ExcitationGenerator::none;
+    double generatorPeriod = MAX_EXLEN;
+    // MIDI notes played through the oscillator bank
+    VoicePool voices;
+    // Time spent in each stage of applyLPC; the caller brackets blocks
+    StageTiming timing;
+    // What applyLPC and its stages corrected or skipped
+    DSPDiagnostics diagnostics;
+    // Receives spans of applyLPC, analysis and synthesis when set; owned by
+    // the caller and set only while no block is processed
+    DSPTrace* trace = nullptr;
+    bool midiExcitation = false;
     bool orderChanged = false;
     bool exTypeChanged = false;
-    bool exStartChanged = false;
-    float exStart = 0.f;
     vector<double> window;
     void prepareToPlay();
 };
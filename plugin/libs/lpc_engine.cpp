@@ -0,0 +1,183 @@
+#include "lpc_engine.h"
+#include <cmath>
+#include <limits>
+
+// As juce::Decibels::decibelsToGain and juce::approximatelyEqual, which the
+// plugin used before the engine stopped depending on JUCE
+static float decibelsToGain(float decibels) {
+    return decibels > -100.f ? std::pow(10.f, decibels*0.05f) : 0.f;
+}
+
+static bool approximatelyEqual(float a, float b) {
+    if (!(std::isfinite(a) && std::isfinite(b))) {
+        return a == b;
+    }
+    const float difference = std::abs(a - b);
+    return difference <= std::numeric_limits<float>::min()
+        || difference <= std::numeric_limits<float>::epsilon()*std::max(std::abs(a), std::abs(b));
+}
+
+// One task per hop of the current chunk, over all channels
+class LPCEngine::AnalysisJob : public WorkerPool::Job {
+public:
+    AnalysisJob(LPCEngine& e, int numChannels) : engine(e), firstTasks(numChannels + 1, 0) {}
+
+    void run(int task, int thread) override {
+        int ch = 0;
+        while (task >= firstTasks[ch + 1]) {
+            ch++;
+        }
+        engine.lpc.analyseChunk(channels[ch], task - firstTasks[ch], 1, engine.threadScratch[thread]);
+    }
+
+    LPCEngine& engine;
+    // Channels taking part in the block, and where each one's tasks start
+    vector<int> channels;
+    vector<int> firstTasks;
+};
+
+// One task per channel, synthesising and writing out the current chunk
+class LPCEngine::SynthesisJob : public WorkerPool::Job {
+public:
+    SynthesisJob(LPCEngine& e) : engine(e) {}
+
+    void run(int task, int) override {
+        int ch = channels[task];
+        engine.lpc.synthesiseChunk(ch, sidechains[ch] != nullptr);
+        if (engine.lpc.outputChunk(ch, outputs[ch] + offset, engine.parameters.lpcMix, engine.previousGain, slope, offset)) {
+            audioWarning = true;
+        }
+    }
+
+    LPCEngine& engine;
+    const int* channels = nullptr;
+    float* const* outputs = nullptr;
+    const float* const* sidechains = nullptr;
+    double slope = 0.0;
+    int offset = 0;
+    std::atomic<bool> audioWarning{false};
+};
+
+LPCEngine::LPCEngine(int numChannels) : lpc(numChannels) {
+    analysisJob = std::make_unique<AnalysisJob>(*this, numChannels);
+    analysisJob->channels.reserve(numChannels);
+    synthesisJob = std::make_unique<SynthesisJob>(*this);
+}
+
+LPCEngine::~LPCEngine() {
+}
+
+void LPCEngine::prepare(double sampleRate, const LPCParameters& params, const LPCExcitation& excitation) {
+    lpc.SAMPLERATE = static_cast<int>(sampleRate);
+    previousGain = decibelsToGain(params.wetGain);
+    setParameters(params, excitation);
+    lpc.prepareToPlay();
+}
+
+bool LPCEngine::buildExcitationSegment(const vector<double>* table, const LPCParameters& params) {
+    return lpc.buildExcitationSegment(table, params.exStartPos, params.exLen);
+}
+
+void LPCEngine::beginBlock(const LPCParameters& params, const LPCExcitation& excitation) {
+    lpc.timing.beginBlock();
+    blockSamples = 0;
+    setParameters(params, excitation);
+    lpc.beginBlock();
+    currentGain = decibelsToGain(parameters.wetGain);
+}
+
+bool LPCEngine::processChannel(const float *input, float *output, int numSamples, int ch, const float *sidechain, int inputStride, int outputStride) {
+    blockSamples = numSamples;
+    return lpc.applyLPC(input, output, numSamples, parameters.lpcMix, ch, sidechain, previousGain, currentGain, inputStride, outputStride);
+}
+
+void LPCEngine::prepareThreads(int numThreads) {
+    threadScratch.resize(numThreads);
+    for (auto& scratch : threadScratch) {
+        scratch.prepare(static_cast<int>(lpc.window.size()));
+    }
+}
+
+bool LPCEngine::processChannels(const float* const* inputs, float* const* outputs, const float* const* sidechains, int numChannels, int numSamples, WorkerPool& pool) {
+    auto& channels = analysisJob->channels;
+    channels.clear();
+    for (int ch = 0; ch < numChannels; ch++) {
+        if (lpc.beginChannel(ch)) {
+            channels.push_back(ch);
+        }
+    }
+    // Same expression as applyLPC, so that the gain ramp matches bit for bit
+    synthesisJob->slope = (currentGain-previousGain)/numSamples;
+    synthesisJob->channels = channels.data();
+    synthesisJob->outputs = outputs;
+    synthesisJob->sidechains = sidechains;
+    synthesisJob->audioWarning = false;
+    blockSamples = numSamples;
+    for (int offset = 0; offset < numSamples; offset += lpc.maxChunkSize()) {
+        int n = std::min(lpc.maxChunkSize(), numSamples - offset);
+        int numHops = 0;
+        const auto t0 = StageTiming::Clock::now();
+        for (size_t i = 0; i < channels.size(); i++) {
+            int ch = channels[i];
+            analysisJob->firstTasks[i] = numHops;
+            numHops += lpc.ingestChunk(ch, inputs[ch] + offset, sidechains[ch] != nullptr ? sidechains[ch] + offset : nullptr, n);
+        }
+        analysisJob->firstTasks[channels.size()] = numHops;
+        const auto t1 = StageTiming::Clock::now();
+        pool.run(*analysisJob, numHops);
+        const auto t2 = StageTiming::Clock::now();
+        synthesisJob->offset = offset;
+        pool.run(*synthesisJob, static_cast<int>(channels.size()));
+        // Each synthesis task also outputs its channel, so output is
+        // counted as synthesis here
+        lpc.timing.addStage(StageTiming::ingest, t1 - t0);
+        lpc.timing.addStage(StageTiming::analysis, t2 - t1);
+        lpc.timing.addStage(StageTiming::synthesis, StageTiming::Clock::now() - t2);
+    }
+    return synthesisJob->audioWarning;
+}
+
+void LPCEngine::endBlock() {
+    lpc.timing.endBlock(lpc.SAMPLERATE > 0 ? static_cast<double>(blockSamples)/lpc.SAMPLERATE : 0.0);
+    if (metrics != nullptr) {
+        metrics->endBlock(lpc.timing, lpc.diagnostics, lpc.SAMPLERATE, blockSamples);
+    }
+    if (!approximatelyEqual(currentGain, previousGain)) {
+        previousGain = currentGain;
+    }
+}
+
+void LPCEngine::setParameters(const LPCParameters& params, const LPCExcitation& excitation) {
+    parameters = params;
+    int prevExType = lpc.exType;
+    const vector<double>* prevNoise = lpc.noise;
+    lpc.exType = params.exType;
+    lpc.noise = excitation.table;
+    lpc.EXLEN = lpc.noise != nullptr ? (*lpc.noise).size() : 0;
+    // The generated excitations follow "Off" in the excitation list
+    int generatorIndex = lpc.exType - excitation.numFactoryTables;
+    if (excitation.custom || generatorIndex < ExcitationGenerator::noise || generatorIndex > ExcitationGenerator::glottalPulse) {
+        lpc.generator = ExcitationGenerator::none;
+    }
+    else {
+        lpc.generator = static_cast<ExcitationGenerator::Type>(generatorIndex);
+    }
+    // followed by the MIDI oscillator bank
+    lpc.midiExcitation = !excitation.custom && generatorIndex == ExcitationGenerator::glottalPulse + 1;
+    // Length sets the pulse period, over the same range as a table loop
+    lpc.generatorPeriod = params.exLen*lpc.SAMPLERATE/6.0;
+
+    int prevOrder = lpc.ORDER;
+    lpc.ORDER = params.lpcOrder;
+    lpc.orderChanged = prevOrder != lpc.ORDER;
+    lpc.exTypeChanged = prevExType != lpc.exType || prevNoise != lpc.noise;
+    lpc.prevFrameLen = lpc.FRAMELEN;
+    lpc.FRAMELEN = static_cast<int>(params.frameDur*lpc.SAMPLERATE/1000.0);
+    lpc.FRAMELEN = 1024;
+    if (lpc.prevFrameLen != lpc.FRAMELEN) {
+        for (int i = 0; i < lpc.FRAMELEN; i++) {
+            lpc.window[i] = 0.5*(1.0-cos(2.0*M_PI*i/(double)(lpc.FRAMELEN-1)));
+        }
+        lpc.HOPSIZE = lpc.FRAMELEN/2;
+    }
+}
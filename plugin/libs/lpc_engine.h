@@ -0,0 +1,74 @@
+#pragma once
+
+#include "lpc.h"
+#include "worker_pool.h"
+#include "metrics_export.h"
+
+// Parameter values in the units the plugin exposes them
+struct LPCParameters {
+    float wetGain = 0.f;        // dB
+    float lpcMix = 0.f;
+    float exLen = 1.f;
+    float exStartPos = 0.f;
+    int exType = 6;
+    int lpcOrder = MAX_ORDER/2;
+    float frameDur = 10.f;      // ms
+    bool useSidechain = false;
+};
+
+// The excitation selected for a block: a table (factory or custom) or nullptr.
+// Types past the factory tables select the generators, unless a custom
+// excitation is in use.
+struct LPCExcitation {
+    const vector<double>* table = nullptr;
+    int numFactoryTables = 0;
+    bool custom = false;
+};
+
+// Drives an LPC instance block by block, turning parameter snapshots into
+// engine state and ramping the wet gain across each block. The plugin and the
+// offline tools both go through this, so that they render identically.
+class LPCEngine {
+public:
+    LPCEngine(int numChannels);
+    ~LPCEngine();
+    LPC lpc;
+    // Receives the timing and diagnostics at the end of each block when set;
+    // owned by the caller and set only while no block is processed
+    MetricsPublisher* metrics = nullptr;
+
+    // Not real-time safe
+    void prepare(double sampleRate, const LPCParameters& params, const LPCExcitation& excitation);
+    // Any thread but the audio thread, see LPC::buildExcitationSegment
+    bool buildExcitationSegment(const vector<double>* table, const LPCParameters& params);
+
+    // Audio thread: beginBlock, processChannel for every channel, endBlock
+    void beginBlock(const LPCParameters& params, const LPCExcitation& excitation);
+    bool processChannel(const float *input, float *output, int numSamples, int ch, const float *sidechain, int inputStride = 1, int outputStride = 1);
+    void endBlock();
+
+    // Non-realtime alternative to processChannel: every channel of the block
+    // at once, with the analysis of each chunk's hops and the synthesis of
+    // each channel spread over the pool. Bit-identical to processChannel.
+    // sidechains holds a pointer per channel, nullptr without a sidechain.
+    // prepareThreads must have been given the pool's number of threads.
+    void prepareThreads(int numThreads);
+    bool processChannels(const float* const* inputs, float* const* outputs, const float* const* sidechains, int numChannels, int numSamples, WorkerPool& pool);
+
+    const LPCParameters& getParameters() const { return parameters; }
+
+private:
+    class AnalysisJob;
+    class SynthesisJob;
+
+    void setParameters(const LPCParameters& params, const LPCExcitation& excitation);
+
+    LPCParameters parameters;
+    float previousGain = 0.f;
+    float currentGain = 0.f;
+    // Samples per channel in the current block, for its timing budget
+    int blockSamples = 0;
+    vector<LPCFrameScratch> threadScratch;
+    unique_ptr<AnalysisJob> analysisJob;
+    unique_ptr<SynthesisJob> synthesisJob;
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+// The inner loops of LPC analysis and synthesis, as LPC runs them. They live
+// here rather than inside LPC so that the kernel benchmarks time exactly the
+// code the engine runs. Rings are the engine's BUFLEN-long circular buffers.
+namespace LPCKernels {
+
+inline double autocorrelate(const double *x, int frameSize, int lag) {
+    double res = 0.0;
+    for (int n = 0; n < frameSize-lag; n++) {
+        res += x[n]*x[n+lag];
+    }
+    return res;
+}
+
+// Prediction coefficients into alphas[0..order] and reflection coefficients
+// into reflection[0..order-1] from the autocorrelation phi[0..order].
+// Returns the prediction error, and counts the reflection coefficients
+// clamped for stability into clamps.
+//http://www.emptyloop.com/technotes/A%20tutorial%20on%20linear%20prediction%20and%20Levinson-Durbin.pdf
+inline double levinsonDurbin(const double *phi, double *alphas, double *reflectionCoeffs, int order, int &clamps) {
+    alphas[0] = 1.0;
+    for (int i = 1; i < order+1; i++) {
+        alphas[i] = 0.0;
+    }
+    double E = phi[0];
+    for (int k = 0; k < order; k++) {
+        double lbda = 0.0;
+        for (int j = 0; j <= k; j++) {
+            lbda += alphas[j] * phi[k + 1 - j];
+        }
+        lbda = -lbda / E;
+        reflectionCoeffs[k] = lbda;  // Store reflection coefficient
+        // Clamp reflection coefficient for stability
+        if (reflectionCoeffs[k] >= 1.0) {
+            reflectionCoeffs[k] = 0.999;
+            clamps++;
+        }
+        if (reflectionCoeffs[k] <= -1.0) {
+            reflectionCoeffs[k] = -0.999;
+            clamps++;
+        }
+        int half = (k + 1) / 2;
+        for (int n = 0; n <= half; n++) {
+            double tmp = alphas[k + 1 - n] + lbda * alphas[n];
+            alphas[n] += lbda * alphas[k + 1 - n];
+            alphas[k + 1 - n] = tmp;
+        }
+        E *= (1.0 - lbda * lbda);
+    }
+    return E;
+}
+
+// The frameLength samples of ring ending just before end, windowed
+inline void windowFrame(const double *ring, int bufLen, int end, const double *window, double *frame, int frameLength) {
+    for (int i = 0; i < frameLength; i++) {
+        int inBufIdx = (end+i-frameLength+bufLen)%bufLen;
+        frame[i] = window[i]*ring[inBufIdx];
+    }
+}
+
+// Filters a frame of excitation in place through the all-pole lattice
+// given by reflection, carrying the backward errors in history across frames
+inline void latticeSynthesise(double *frame, int frameLength, const double *reflectionCoeffs, double *history, int order) {
+    for (int n = 0; n < frameLength; n++) {
+        // Lattice filter synthesis
+        double f = frame[n];
+        for (int i = order - 1; i >= 0; --i) {
+            const double ki = reflectionCoeffs[i];
+            const double bPrev = history[i];      // ẽ^(i-1)[n-1] - backward delay state
+
+            // Equation 11.100b: e^(i-1)[n] = e^(i)[n] + k_i * ẽ^(i-1)[n-1]
+            const double fPrev = f + ki * bPrev;
+            // Equation 11.100c: ẽ^(i)[n] = ẽ^(i-1)[n-1] - k_i * e^(i-1)[n]
+            const double bNew = bPrev - ki * fPrev;
+
+            history[i] = bNew;
+            f = fPrev;
+        }
+        frame[n] = f;
+    }
+}
+
+inline void overlapAdd(const double *frame, double *ring, int bufLen, int writePos, int frameLength, int hopSize) {
+    for (int n = 0; n < frameLength; n++) {
+        unsigned long wtIdx = (writePos+n)%bufLen;
+        // Change of frame length can cause OLA to add with unwanted audio
+        // in a correct scenario, OLA with 50% overlap will always be adding with 0s in
+        // the last HOPSIZE-many samples, so just set the last HOPSIZE-many outputs to
+        // be equal to out_n
+        if (n < hopSize) {
+            ring[wtIdx] += frame[n];
+        }
+        else {
+            ring[wtIdx] = frame[n];
+        }
+    }
+}
+
+// Mixes numSamples of synthesis from outRing with the input from inRing,
+// delayed by frameLength, ramping the wet gain by slope from offset on.
+// Clears the synthesis it consumed and advances both read positions.
+// Returns the samples replaced because they were NaN or clipped.
+struct MixCounts {
+    int nanSamples = 0;
+    int clippedSamples = 0;
+};
+
+inline MixCounts mixOutput(double *outRing, int &outRdPtr, const double *inRing, size_t &inRdPtr, int bufLen, int frameLength,
+                      float *output, int outputStride, int numSamples, float lpcMix, float previousGain, double slope, int offset) {
+    MixCounts counts;
+    for (int s = 0; s < numSamples; s++) {
+        double out = outRing[outRdPtr];
+        double in = inRing[(inRdPtr+bufLen-frameLength)%bufLen];
+        inRdPtr++;
+        if (inRdPtr >= static_cast<size_t>(bufLen)) {
+            inRdPtr = 0;
+        }
+        double gainFactor = previousGain+slope*(double)(offset+s);
+        float final_out = lpcMix*gainFactor*out+(1-lpcMix)*in;
+        if (std::isnan(final_out)) {
+            counts.nanSamples++;
+            final_out = 0.f;
+        }
+        else if (std::fabs(final_out) > 1.f) {
+            counts.clippedSamples++;
+            final_out /= (2.f*std::fabs(final_out));
+        }
+        output[s*outputStride] = final_out;
+        outRing[outRdPtr] = 0;
+        outRdPtr++;
+        if (outRdPtr >= bufLen) {
+            outRdPtr = 0;
+        }
+    }
+    return counts;
+}
+
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Upper bounds the engine allocates for, shared with the plugin's parameter
+// ranges
+#define MAX_ORDER 50
+#define MAX_FRAME_DUR 50
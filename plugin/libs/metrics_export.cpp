@@ -0,0 +1,266 @@
+#include "metrics_export.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#if !defined(_WIN32)
+ #include <cerrno>
+ #include <dirent.h>
+ #include <fcntl.h>
+ #include <signal.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+
+namespace {
+
+const char* const segmentPrefix = "lpmorph-";
+
+std::string segmentName(const std::string& name) {
+    return name.empty() || name[0] == '/' ? name : "/" + name;
+}
+
+}
+
+MetricsPublisher::~MetricsPublisher() {
+    stop();
+}
+
+bool MetricsPublisher::start(const std::string& label, double updatesPerSecond) {
+    stop();
+    static std::atomic<int> numSegments{0};
+    const std::string segment = "/" + std::string(segmentPrefix) + std::to_string(getpid()) + "-" + std::to_string(numSegments++);
+
+    const int fd = shm_open(segment.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    void* memory = MAP_FAILED;
+    if (ftruncate(fd, sizeof(SharedMetrics)) == 0) {
+        memory = mmap(nullptr, sizeof(SharedMetrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(segment.c_str());
+        return false;
+    }
+
+    // Still invisible to readers until magic is set, last
+    metrics = static_cast<SharedMetrics*>(memory);
+    memset(metrics, 0, sizeof(SharedMetrics));
+    metrics->version = SharedMetrics::currentVersion;
+    metrics->size = sizeof(SharedMetrics);
+    metrics->processId = static_cast<uint32_t>(getpid());
+    strncpy(metrics->label, label.c_str(), SharedMetrics::labelSize - 1);
+    __atomic_store_n(&metrics->magic, SharedMetrics::magicValue, __ATOMIC_RELEASE);
+
+    name = segment;
+    secondsPerUpdate = updatesPerSecond > 0.0 ? 1.0/updatesPerSecond : 0.0;
+    secondsSinceUpdate = 0.0;
+    previousTiming = StageTiming::Snapshot();
+    return true;
+}
+
+void MetricsPublisher::stop() {
+    if (metrics == nullptr) {
+        return;
+    }
+    munmap(metrics, sizeof(SharedMetrics));
+    metrics = nullptr;
+    shm_unlink(name.c_str());
+    name.clear();
+}
+
+void MetricsPublisher::endBlock(const StageTiming& timing, const DSPDiagnostics& diagnostics, double sampleRate, int numSamples) noexcept {
+    if (metrics == nullptr || sampleRate <= 0.0) {
+        return;
+    }
+    secondsSinceUpdate += numSamples/sampleRate;
+    if (secondsSinceUpdate >= secondsPerUpdate) {
+        secondsSinceUpdate = 0.0;
+        update(timing, diagnostics, sampleRate);
+    }
+}
+
+void MetricsPublisher::update(const StageTiming& timing, const DSPDiagnostics& diagnostics, double sampleRate) noexcept {
+    timing.read(currentTiming);
+    diagnostics.read(counters);
+    const StageTiming::Snapshot interval = currentTiming.since(previousTiming);
+    previousTiming = currentTiming;
+
+    uint64_t overruns = 0;
+    for (int b = 100; b < StageTiming::numLoadBins; b++) {
+        overruns += currentTiming.loadBins[b];
+    }
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+
+    // Odd while writing; the fence keeps the writes below from being seen
+    // before the counter turns odd
+    const uint64_t sequence = __atomic_load_n(&metrics->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&metrics->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    metrics->updatedNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+    metrics->sampleRate = sampleRate;
+    metrics->blocks = currentTiming.blocks;
+    metrics->processingNs = currentTiming.blockNs;
+    metrics->audioNs = currentTiming.budgetNs;
+    metrics->overruns = overruns;
+    for (int s = 0; s < StageTiming::numStages; s++) {
+        metrics->stageNs[s] = currentTiming.stageNs[s];
+    }
+    for (int c = 0; c < DSPDiagnostics::numCounters; c++) {
+        metrics->diagnostics[c] = counters.counts[c];
+    }
+
+    metrics->load = interval.meanLoad();
+    metrics->loadP50 = interval.loadPercentile(0.5);
+    metrics->loadP99 = interval.loadPercentile(0.99);
+    metrics->loadMax = interval.peakLoad();
+    for (int s = 0; s < StageTiming::numStages; s++) {
+        const auto stage = static_cast<StageTiming::Stage>(s);
+        metrics->stageLoad[s] = interval.stageLoad(stage);
+        metrics->stageP50Ns[s] = interval.stagePercentileNs(stage, 0.5);
+        metrics->stageP99Ns[s] = interval.stagePercentileNs(stage, 0.99);
+        metrics->stageMaxNs[s] = interval.stagePercentileNs(stage, 1.0);
+    }
+
+    __atomic_store_n(&metrics->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+MetricsReader::~MetricsReader() {
+    close();
+}
+
+bool MetricsReader::open(const std::string& name, std::string& error) {
+    close();
+    const std::string segment = segmentName(name);
+    const int fd = shm_open(segment.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        error = segment + ": " + strerror(errno);
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(SharedMetrics))) {
+        ::close(fd);
+        error = segment + ": too small for metrics version " + std::to_string(SharedMetrics::currentVersion);
+        return false;
+    }
+    void* memory = mmap(nullptr, sizeof(SharedMetrics), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        error = segment + ": " + strerror(errno);
+        return false;
+    }
+
+    const auto* mapped = static_cast<const SharedMetrics*>(memory);
+    if (__atomic_load_n(&mapped->magic, __ATOMIC_ACQUIRE) != SharedMetrics::magicValue) {
+        error = segment + ": not LP Morph metrics";
+    }
+    else if (mapped->version != SharedMetrics::currentVersion || mapped->size != sizeof(SharedMetrics)) {
+        error = segment + ": metrics version " + std::to_string(mapped->version) + ", expected " + std::to_string(SharedMetrics::currentVersion);
+    }
+    else {
+        metrics = mapped;
+        return true;
+    }
+    munmap(memory, sizeof(SharedMetrics));
+    return false;
+}
+
+void MetricsReader::close() {
+    if (metrics != nullptr) {
+        munmap(const_cast<SharedMetrics*>(metrics), sizeof(SharedMetrics));
+        metrics = nullptr;
+    }
+}
+
+bool MetricsReader::read(SharedMetrics& copy) const {
+    if (metrics == nullptr) {
+        return false;
+    }
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        const uint64_t before = __atomic_load_n(&metrics->sequence, __ATOMIC_ACQUIRE);
+        if ((before & 1) != 0) {
+            continue;
+        }
+        memcpy(&copy, metrics, sizeof(SharedMetrics));
+        // Keeps the copy from being read after the counter below
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&metrics->sequence, __ATOMIC_RELAXED) == before) {
+            copy.sequence = before;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> MetricsReader::list() {
+    std::vector<std::string> names;
+#if defined(__linux__)
+    if (DIR* directory = opendir("/dev/shm")) {
+        while (const dirent* entry = readdir(directory)) {
+            if (strncmp(entry->d_name, segmentPrefix, strlen(segmentPrefix)) == 0) {
+                names.push_back(std::string("/") + entry->d_name);
+            }
+        }
+        closedir(directory);
+    }
+    std::sort(names.begin(), names.end());
+#endif
+    return names;
+}
+
+bool MetricsReader::isPublisherAlive(const SharedMetrics& copy) {
+    return kill(static_cast<pid_t>(copy.processId), 0) == 0 || errno == EPERM;
+}
+
+bool MetricsReader::remove(const std::string& name) {
+    return shm_unlink(segmentName(name).c_str()) == 0;
+}
+
+#else
+
+// No POSIX shared memory: nothing is published, and there is nothing to read
+
+MetricsPublisher::~MetricsPublisher() {}
+
+bool MetricsPublisher::start(const std::string&, double) {
+    return false;
+}
+
+void MetricsPublisher::stop() {}
+
+void MetricsPublisher::endBlock(const StageTiming&, const DSPDiagnostics&, double, int) noexcept {}
+
+void MetricsPublisher::update(const StageTiming&, const DSPDiagnostics&, double) noexcept {}
+
+MetricsReader::~MetricsReader() {}
+
+bool MetricsReader::open(const std::string&, std::string& error) {
+    error = "shared-memory metrics are not supported on this platform";
+    return false;
+}
+
+void MetricsReader::close() {}
+
+bool MetricsReader::read(SharedMetrics&) const {
+    return false;
+}
+
+std::vector<std::string> MetricsReader::list() {
+    return {};
+}
+
+bool MetricsReader::isPublisherAlive(const SharedMetrics&) {
+    return false;
+}
+
+bool MetricsReader::remove(const std::string&) {
+    return false;
+}
+
+#endif
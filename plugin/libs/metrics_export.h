@@ -0,0 +1,125 @@
+#pragma once
+
+#include "stage_timing.h"
+#include "dsp_diagnostics.h"
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Metrics of an engine published into a POSIX shared-memory segment, for
+// monitoring headless renders without a GUI. lpmorph-metrics reads every
+// segment and writes them out for Prometheus.
+//
+// Each publishing engine gets its own segment, named /lpmorph-<pid>-<n>. The
+// publisher updates it from the audio thread a few times a second without
+// locking, allocating or making system calls: the writes go straight to the
+// mapped memory, bracketed by a sequence counter that is odd while they are
+// under way, so a reader copies the whole struct and retries if the counter
+// moved. The only thing it asks of the system is the time of the update,
+// read like StageTiming's clock through the vDSO on Linux. Memory use is
+// left to the reader, which can read it from /proc. Counters are totals
+// since the publisher started; loads and percentiles cover the interval
+// since the previous update.
+//
+// The layout only changes along with version. Readers check magic, version
+// and size before trusting anything else.
+struct SharedMetrics {
+    static constexpr uint32_t magicValue = 0x4d4d504c;  // "LPMM"
+    static constexpr uint32_t currentVersion = 2;
+    static constexpr int numStages = 4;
+    static constexpr int numCounters = 8;
+    static constexpr int labelSize = 64;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t processId;
+    char label[labelSize];
+    // Odd while the publisher writes; only accessed atomically
+    uint64_t sequence;
+
+    // Wall clock time of the update, in ns since the Unix epoch
+    uint64_t updatedNs;
+    double sampleRate;
+    uint64_t blocks;
+    // Time spent processing, and the duration of the audio processed
+    uint64_t processingNs;
+    uint64_t audioNs;
+    // Blocks that took longer to process than their audio lasts, which
+    // underrun a real-time host
+    uint64_t overruns;
+    uint64_t stageNs[numStages];
+    // DSPDiagnostics counters, in their order; the rest stay zero
+    uint64_t diagnostics[numCounters];
+
+    // Over the interval: processing time over the audio's duration, and
+    // percentiles of each block's load and each stage's time per block
+    double load;
+    double loadP50;
+    double loadP99;
+    double loadMax;
+    double stageLoad[numStages];
+    double stageP50Ns[numStages];
+    double stageP99Ns[numStages];
+    double stageMaxNs[numStages];
+};
+
+static_assert(SharedMetrics::numStages == StageTiming::numStages, "bump SharedMetrics::currentVersion along with the stages");
+static_assert(SharedMetrics::numCounters >= DSPDiagnostics::numCounters, "bump SharedMetrics::currentVersion along with the counters");
+static_assert(std::is_trivially_copyable<SharedMetrics>::value, "readers copy SharedMetrics byte for byte");
+
+class MetricsPublisher {
+public:
+    MetricsPublisher() = default;
+    ~MetricsPublisher();
+    MetricsPublisher(const MetricsPublisher&) = delete;
+    MetricsPublisher& operator=(const MetricsPublisher&) = delete;
+
+    // Not real-time safe. label tells publishers apart for people, e.g. the
+    // host or job; it is cut to SharedMetrics::labelSize - 1 bytes.
+    bool start(const std::string& label, double updatesPerSecond = 4.0);
+    void stop();
+    bool isPublishing() const noexcept { return metrics != nullptr; }
+    const std::string& getName() const noexcept { return name; }
+
+    // Audio thread, after each block with the duration of its audio. Only
+    // updates the segment once enough audio has gone by.
+    void endBlock(const StageTiming& timing, const DSPDiagnostics& diagnostics, double sampleRate, int numSamples) noexcept;
+
+private:
+    void update(const StageTiming& timing, const DSPDiagnostics& diagnostics, double sampleRate) noexcept;
+
+    SharedMetrics* metrics = nullptr;
+    std::string name;
+    double secondsPerUpdate = 0.25;
+    double secondsSinceUpdate = 0.0;
+    StageTiming::Snapshot previousTiming;
+    StageTiming::Snapshot currentTiming;
+    DSPDiagnostics::Snapshot counters;
+};
+
+// Reads a segment published by another process
+class MetricsReader {
+public:
+    MetricsReader() = default;
+    ~MetricsReader();
+    MetricsReader(const MetricsReader&) = delete;
+    MetricsReader& operator=(const MetricsReader&) = delete;
+
+    // name as getName() returns it, with or without the leading slash
+    bool open(const std::string& name, std::string& error);
+    void close();
+    // A consistent copy of the segment; false if the publisher kept
+    // updating it throughout
+    bool read(SharedMetrics& copy) const;
+
+    // The segments on this machine, where the system can list them (Linux)
+    static std::vector<std::string> list();
+    // Whether the process that published copy is still running
+    static bool isPublisherAlive(const SharedMetrics& copy);
+    static bool remove(const std::string& name);
+
+private:
+    const SharedMetrics* metrics = nullptr;
+};
@@ -0,0 +1,322 @@
+#include "session_capture.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+static const char captureMagic[8] = { 'L', 'P', 'M', 'C', 'A', 'P', '0', '1' };
+// Everything in a block record before the MIDI events and the audio
+static constexpr size_t blockFixedBytes = 76;
+static constexpr size_t parameterBytes = 32;
+
+static void encodeParameters(const LPCParameters& p, uint8_t* out) {
+    const int32_t exType = p.exType;
+    const int32_t lpcOrder = p.lpcOrder;
+    const uint32_t useSidechain = p.useSidechain ? 1 : 0;
+    memcpy(out, &p.wetGain, 4);
+    memcpy(out + 4, &p.lpcMix, 4);
+    memcpy(out + 8, &p.exLen, 4);
+    memcpy(out + 12, &p.exStartPos, 4);
+    memcpy(out + 16, &exType, 4);
+    memcpy(out + 20, &lpcOrder, 4);
+    memcpy(out + 24, &p.frameDur, 4);
+    memcpy(out + 28, &useSidechain, 4);
+}
+
+static LPCParameters decodeParameters(const uint8_t* in) {
+    LPCParameters p;
+    int32_t exType, lpcOrder;
+    uint32_t useSidechain;
+    memcpy(&p.wetGain, in, 4);
+    memcpy(&p.lpcMix, in + 4, 4);
+    memcpy(&p.exLen, in + 8, 4);
+    memcpy(&p.exStartPos, in + 12, 4);
+    memcpy(&exType, in + 16, 4);
+    memcpy(&lpcOrder, in + 20, 4);
+    memcpy(&p.frameDur, in + 24, 4);
+    memcpy(&useSidechain, in + 28, 4);
+    p.exType = exType;
+    p.lpcOrder = lpcOrder;
+    p.useSidechain = useSidechain != 0;
+    return p;
+}
+
+uint32_t hashAudio(const float* const* channels, int numChannels, int numSamples, uint32_t hash) {
+    for (int ch = 0; ch < numChannels; ch++) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(channels[ch]);
+        for (size_t i = 0; i < numSamples*sizeof(float); i++) {
+            hash = (hash ^ bytes[i])*16777619u;
+        }
+    }
+    return hash;
+}
+
+SessionRecorder::~SessionRecorder() {
+    stop();
+}
+
+bool SessionRecorder::start(const std::string& path, double sampleRate, int numChannels, int maxBlockSize, const LPCParameters& parameters,
+                            size_t ringBytes) {
+    stop();
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    maxChannels = numChannels;
+    maxSamples = maxBlockSize;
+    staging.assign(2*static_cast<size_t>(maxChannels)*maxSamples, 0.f);
+    // At least four of the largest records, rounded up to a power of two
+    const size_t largestRecord = blockFixedBytes + maxMidiEvents*8 + staging.size()*sizeof(float);
+    size_t capacity = 1;
+    while (capacity < std::max(ringBytes, 4*largestRecord)) {
+        capacity <<= 1;
+    }
+    ring.assign(capacity, 0);
+    ringMask = capacity - 1;
+    writePosition = 0;
+    readPosition = 0;
+    droppedBlocks = 0;
+    pendingValid = false;
+    gap = false;
+
+    uint8_t header[8 + 4 + 8 + 4 + 4 + parameterBytes];
+    const uint32_t headerSize = sizeof(header);
+    const uint32_t channels = numChannels;
+    const uint32_t blockSize = maxBlockSize;
+    memcpy(header, captureMagic, 8);
+    memcpy(header + 8, &headerSize, 4);
+    memcpy(header + 12, &sampleRate, 8);
+    memcpy(header + 20, &channels, 4);
+    memcpy(header + 24, &blockSize, 4);
+    encodeParameters(parameters, header + 28);
+    fwrite(header, 1, sizeof(header), file);
+
+    running = true;
+    writer = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+void SessionRecorder::stop() {
+    if (file == nullptr) {
+        return;
+    }
+    running = false;
+    if (writer.joinable()) {
+        writer.join();
+    }
+    drain();
+    fclose(file);
+    file = nullptr;
+}
+
+void SessionRecorder::writerLoop() {
+    while (running) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
+
+size_t SessionRecorder::drain() {
+    size_t r = readPosition.load(std::memory_order_relaxed);
+    const size_t w = writePosition.load(std::memory_order_acquire);
+    const size_t drained = w - r;
+    while (r < w) {
+        const size_t offset = r & ringMask;
+        const size_t run = std::min(w - r, ring.size() - offset);
+        fwrite(ring.data() + offset, 1, run, file);
+        r += run;
+    }
+    readPosition.store(r, std::memory_order_release);
+    if (drained > 0) {
+        fflush(file);
+    }
+    return drained;
+}
+
+void SessionRecorder::put(size_t& position, const void* data, size_t size) noexcept {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const size_t offset = position & ringMask;
+        const size_t run = std::min(size, ring.size() - offset);
+        memcpy(ring.data() + offset, bytes, run);
+        position += run;
+        bytes += run;
+        size -= run;
+    }
+}
+
+void SessionRecorder::beginBlock(const SessionBlock& info, const float* const* inputs, const float* const* sidechains) noexcept {
+    pendingValid = false;
+    numMidi = 0;
+    if (file == nullptr) {
+        return;
+    }
+    if (info.numSamples > maxSamples || info.numChannels > maxChannels) {
+        droppedBlocks++;
+        gap = true;
+        return;
+    }
+    // Field by field, so that the vectors in pending are never touched
+    pending.numSamples = info.numSamples;
+    pending.numChannels = info.numChannels;
+    pending.flags = info.flags & ~static_cast<uint32_t>(SessionBlock::hasSidechain);
+    pending.parameters = info.parameters;
+    pending.segmentTable = info.segmentTable;
+    pending.segmentStart = info.segmentStart;
+    pending.segmentLength = info.segmentLength;
+    const int n = info.numSamples;
+    for (int ch = 0; ch < info.numChannels; ch++) {
+        std::copy(inputs[ch], inputs[ch] + n, staging.begin() + static_cast<size_t>(ch)*n);
+    }
+    if (sidechains != nullptr && info.numChannels > 0 && sidechains[0] != nullptr) {
+        pending.flags |= SessionBlock::hasSidechain;
+        for (int ch = 0; ch < info.numChannels; ch++) {
+            auto destination = staging.begin() + static_cast<size_t>(info.numChannels + ch)*n;
+            if (sidechains[ch] != nullptr) {
+                std::copy(sidechains[ch], sidechains[ch] + n, destination);
+            }
+            else {
+                std::fill(destination, destination + n, 0.f);
+            }
+        }
+    }
+    pendingValid = true;
+}
+
+void SessionRecorder::addMidi(int sampleOffset, const uint8_t* data, int size) noexcept {
+    if (!pendingValid || numMidi == maxMidiEvents || size < 1 || size > 3) {
+        return;
+    }
+    SessionBlock::MidiEvent& event = midiStaging[numMidi++];
+    event.sampleOffset = static_cast<uint32_t>(sampleOffset);
+    memset(event.data, 0, sizeof(event.data));
+    memcpy(event.data, data, size);
+    event.size = static_cast<uint8_t>(size);
+}
+
+void SessionRecorder::endBlock(const float* const* outputs, uint64_t processingNs) noexcept {
+    if (!pendingValid) {
+        return;
+    }
+    pendingValid = false;
+    const int n = pending.numSamples;
+    const int numAudioChannels = pending.numChannels*((pending.flags & SessionBlock::hasSidechain) != 0 ? 2 : 1);
+    const size_t audioBytes = static_cast<size_t>(numAudioChannels)*n*sizeof(float);
+    const uint32_t recordSize = static_cast<uint32_t>(blockFixedBytes + numMidi*8 + audioBytes);
+    size_t w = writePosition.load(std::memory_order_relaxed);
+    if (ring.size() - (w - readPosition.load(std::memory_order_acquire)) < recordSize) {
+        droppedBlocks++;
+        gap = true;
+        return;
+    }
+
+    const uint32_t numSamples = n;
+    const uint32_t numChannels = pending.numChannels;
+    const uint32_t flags = pending.flags | (gap ? static_cast<uint32_t>(SessionBlock::afterGap) : 0u);
+    uint8_t parameters[parameterBytes];
+    encodeParameters(pending.parameters, parameters);
+    const int32_t segment[3] = { pending.segmentTable, pending.segmentStart, pending.segmentLength };
+    const uint32_t outputHash = hashAudio(outputs, pending.numChannels, n);
+    const uint32_t midiCount = numMidi;
+    put(w, &recordSize, 4);
+    put(w, &numSamples, 4);
+    put(w, &numChannels, 4);
+    put(w, &flags, 4);
+    put(w, parameters, parameterBytes);
+    put(w, segment, sizeof(segment));
+    put(w, &processingNs, 8);
+    put(w, &outputHash, 4);
+    put(w, &midiCount, 4);
+    for (int i = 0; i < numMidi; i++) {
+        put(w, &midiStaging[i].sampleOffset, 4);
+        put(w, midiStaging[i].data, 3);
+        put(w, &midiStaging[i].size, 1);
+    }
+    put(w, staging.data(), audioBytes);
+    writePosition.store(w, std::memory_order_release);
+    gap = false;
+}
+
+SessionReader::~SessionReader() {
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+bool SessionReader::open(const std::string& path, std::string& error) {
+    file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+    uint8_t header[8 + 4 + 8 + 4 + 4 + parameterBytes];
+    uint32_t headerSize = 0;
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, captureMagic, 8) != 0) {
+        error = path + " is not an LP Morph capture";
+        return false;
+    }
+    memcpy(&headerSize, header + 8, 4);
+    memcpy(&sampleRate, header + 12, 8);
+    uint32_t channels, blockSize;
+    memcpy(&channels, header + 20, 4);
+    memcpy(&blockSize, header + 24, 4);
+    numChannels = static_cast<int>(channels);
+    maxBlockSize = static_cast<int>(blockSize);
+    prepareParameters = decodeParameters(header + 28);
+    // Later versions may append to the header
+    if (headerSize < sizeof(header) || fseek(file, headerSize, SEEK_SET) != 0 || numChannels < 1 || maxBlockSize < 1) {
+        error = path + " has a damaged header";
+        return false;
+    }
+    return true;
+}
+
+bool SessionReader::next(SessionBlock& block, std::string& error) {
+    uint32_t recordSize = 0;
+    const size_t read = fread(&recordSize, 1, 4, file);
+    if (read == 0) {
+        return false;
+    }
+    if (read != 4 || recordSize < blockFixedBytes) {
+        error = "damaged block record";
+        return false;
+    }
+    record.resize(recordSize - 4);
+    if (fread(record.data(), 1, record.size(), file) != record.size()) {
+        // A capture cut short, e.g. by a crash, ends at its last whole block
+        error = "capture ends in the middle of a block";
+        return false;
+    }
+    const uint8_t* p = record.data();
+    uint32_t numSamples, channels, midiCount;
+    int32_t segment[3];
+    memcpy(&numSamples, p, 4);
+    memcpy(&channels, p + 4, 4);
+    memcpy(&block.flags, p + 8, 4);
+    block.parameters = decodeParameters(p + 12);
+    memcpy(segment, p + 12 + parameterBytes, sizeof(segment));
+    memcpy(&block.processingNs, p + 56, 8);
+    memcpy(&block.outputHash, p + 64, 4);
+    memcpy(&midiCount, p + 68, 4);
+    block.numSamples = static_cast<int>(numSamples);
+    block.numChannels = static_cast<int>(channels);
+    block.segmentTable = segment[0];
+    block.segmentStart = segment[1];
+    block.segmentLength = segment[2];
+    const size_t numAudioChannels = channels*((block.flags & SessionBlock::hasSidechain) != 0 ? 2 : 1);
+    const size_t audioBytes = numAudioChannels*numSamples*sizeof(float);
+    if (blockFixedBytes - 4 + midiCount*8ull + audioBytes != record.size()) {
+        error = "damaged block record";
+        return false;
+    }
+    p += blockFixedBytes - 4;
+    block.midi.resize(midiCount);
+    for (auto& event : block.midi) {
+        memcpy(&event.sampleOffset, p, 4);
+        memcpy(event.data, p + 4, 3);
+        event.size = p[7];
+        p += 8;
+    }
+    block.audio.resize(numAudioChannels*numSamples);
+    memcpy(block.audio.data(), p, audioBytes);
+    return true;
+}
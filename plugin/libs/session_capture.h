@@ -0,0 +1,137 @@
+#pragma once
+
+#include "lpc_engine.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// A session captured block by block from the audio thread, for replaying
+// exactly that workload offline. A capture starts at prepareToPlay, so that
+// a replay starting from a freshly prepared engine reaches the same state.
+//
+// File layout, little-endian throughout:
+//   header  "LPMCAP01", u32 header size, f64 sample rate, u32 channels,
+//           u32 max block size, parameters at prepareToPlay
+//   blocks  u32 record size, u32 samples, u32 channels, u32 flags,
+//           parameters, i32 segment table, i32 segment start and length,
+//           u64 processing time in ns, u32 output hash, u32 MIDI events,
+//           per event u32 sample offset and 4 bytes (3 of data, the size),
+//           planar float input, then planar float sidechain if flagged
+//   parameters  f32 wetGain, lpcMix, exLen, exStartPos, i32 exType,
+//           lpcOrder, f32 frameDur, u32 useSidechain
+struct SessionBlock {
+    enum Flags : uint32_t {
+        hasSidechain = 1,
+        // Rendered through the worker pool while bouncing
+        bouncing = 2,
+        // A custom excitation was selected, which a capture does not hold
+        customExcitation = 4,
+        // Blocks were dropped before this one, so the engine state of a
+        // replay no longer matches the session's from here on
+        afterGap = 8,
+        // The factory tables at the session's rate were still being built,
+        // so the block read the 44.1 kHz originals
+        nativeFactoryTables = 16,
+        // Likewise for the table the loop was cut from, which the segment
+        // builder may not have switched over yet
+        nativeSegmentTable = 32
+    };
+    struct MidiEvent {
+        uint32_t sampleOffset;
+        uint8_t data[3];
+        uint8_t size;
+    };
+
+    int numSamples = 0;
+    int numChannels = 0;
+    uint32_t flags = 0;
+    LPCParameters parameters;
+    // The loop synthesis read: the factory table it was cut from (-1 for
+    // none or a custom table), and its start and length in samples
+    int segmentTable = -1;
+    int segmentStart = 0;
+    int segmentLength = 0;
+    uint64_t processingNs = 0;
+    uint32_t outputHash = 0;
+    vector<MidiEvent> midi;
+    // numChannels planar channels, followed by as many of sidechain
+    vector<float> audio;
+};
+
+// FNV-1a over the bits of the output, as recorded per block
+uint32_t hashAudio(const float* const* channels, int numChannels, int numSamples, uint32_t hash = 2166136261u);
+
+// Records a session. start, stop and the destructor are not real-time safe;
+// beginBlock, addMidi and endBlock are, and are called from the audio
+// thread in that order for each block. Records go through a lock-free ring
+// to a writer thread; when the ring is full a block is dropped and the next
+// one recorded is flagged afterGap.
+class SessionRecorder {
+public:
+    ~SessionRecorder();
+
+    bool start(const std::string& path, double sampleRate, int numChannels, int maxBlockSize, const LPCParameters& parameters,
+               size_t ringBytes = 16 << 20);
+    void stop();
+    bool isRecording() const noexcept { return file != nullptr; }
+    uint64_t getDroppedBlocks() const noexcept { return droppedBlocks.load(); }
+
+    // info carries everything but the audio, MIDI, time and hash. Inputs are
+    // copied before processing, since processing may overwrite them.
+    void beginBlock(const SessionBlock& info, const float* const* inputs, const float* const* sidechains) noexcept;
+    void addMidi(int sampleOffset, const uint8_t* data, int size) noexcept;
+    void endBlock(const float* const* outputs, uint64_t processingNs) noexcept;
+
+private:
+    static constexpr int maxMidiEvents = 256;
+
+    void writerLoop();
+    size_t drain();
+    void put(size_t& position, const void* data, size_t size) noexcept;
+
+    FILE* file = nullptr;
+    std::thread writer;
+    std::atomic<bool> running{false};
+    vector<uint8_t> ring;
+    size_t ringMask = 0;
+    std::atomic<size_t> writePosition{0};
+    std::atomic<size_t> readPosition{0};
+    std::atomic<uint64_t> droppedBlocks{0};
+
+    int maxChannels = 0;
+    int maxSamples = 0;
+    SessionBlock pending;
+    bool pendingValid = false;
+    bool gap = false;
+    vector<float> staging;
+    SessionBlock::MidiEvent midiStaging[maxMidiEvents];
+    int numMidi = 0;
+};
+
+// Reads a capture back, block by block
+class SessionReader {
+public:
+    ~SessionReader();
+
+    bool open(const std::string& path, std::string& error);
+    double getSampleRate() const { return sampleRate; }
+    int getNumChannels() const { return numChannels; }
+    int getMaxBlockSize() const { return maxBlockSize; }
+    const LPCParameters& getPrepareParameters() const { return prepareParameters; }
+
+    // False at the end of the capture; error is set if the file is damaged
+    bool next(SessionBlock& block, std::string& error);
+
+private:
+    FILE* file = nullptr;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    int maxBlockSize = 0;
+    LPCParameters prepareParameters;
+    vector<uint8_t> record;
+};
@@ -0,0 +1,121 @@
+#include "stage_timing.h"
+#include <algorithm>
+#include <cmath>
+#if defined(_MSC_VER)
+ #include <intrin.h>
+#endif
+
+namespace {
+
+int highestBit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+// The upper bound of the bin at which counts reach fraction of their total
+template <int numBins, typename UpperBound>
+double percentile(const uint32_t (&bins)[numBins], double fraction, UpperBound upperBound) {
+    uint64_t total = 0;
+    for (uint32_t count : bins) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction*total)));
+    uint64_t seen = 0;
+    for (int b = 0; b < numBins; b++) {
+        seen += bins[b];
+        if (seen >= rank) {
+            return upperBound(b);
+        }
+    }
+    return upperBound(numBins - 1);
+}
+
+}
+
+int StageTiming::timeBin(uint64_t ns) noexcept {
+    if (ns < 4) {
+        return static_cast<int>(ns);
+    }
+    const int msb = highestBit(ns);
+    const int bin = 4*(msb - 1) + static_cast<int>((ns >> (msb - 2)) & 3);
+    return std::min(bin, numTimeBins - 1);
+}
+
+double StageTiming::binLowerNs(int bin) noexcept {
+    if (bin < 4) {
+        return bin;
+    }
+    return std::ldexp(4.0 + (bin & 3), bin/4 - 1);
+}
+
+void StageTiming::endBlock(double budgetSeconds) noexcept {
+    const uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - blockStart).count());
+    const uint64_t budget = static_cast<uint64_t>(budgetSeconds*1e9);
+    for (int s = 0; s < numStages; s++) {
+        increment(stageNs[s], current[s]);
+        increment(stageBins[s][timeBin(current[s])]);
+    }
+    if (budget > 0) {
+        const uint64_t percent = elapsed*100/budget;
+        increment(loadBins[std::min<uint64_t>(percent, numLoadBins - 1)]);
+    }
+    increment(blockNs, elapsed);
+    increment(budgetNs, budget);
+    increment(blocks);
+}
+
+void StageTiming::read(Snapshot& snapshot) const noexcept {
+    snapshot.blocks = blocks.load(std::memory_order_relaxed);
+    snapshot.blockNs = blockNs.load(std::memory_order_relaxed);
+    snapshot.budgetNs = budgetNs.load(std::memory_order_relaxed);
+    for (int s = 0; s < numStages; s++) {
+        snapshot.stageNs[s] = stageNs[s].load(std::memory_order_relaxed);
+        for (int b = 0; b < numTimeBins; b++) {
+            snapshot.stageBins[s][b] = stageBins[s][b].load(std::memory_order_relaxed);
+        }
+    }
+    for (int b = 0; b < numLoadBins; b++) {
+        snapshot.loadBins[b] = loadBins[b].load(std::memory_order_relaxed);
+    }
+}
+
+StageTiming::Snapshot StageTiming::Snapshot::since(const Snapshot& earlier) const noexcept {
+    Snapshot difference;
+    difference.blocks = blocks - earlier.blocks;
+    difference.blockNs = blockNs - earlier.blockNs;
+    difference.budgetNs = budgetNs - earlier.budgetNs;
+    for (int s = 0; s < numStages; s++) {
+        difference.stageNs[s] = stageNs[s] - earlier.stageNs[s];
+        for (int b = 0; b < numTimeBins; b++) {
+            difference.stageBins[s][b] = stageBins[s][b] - earlier.stageBins[s][b];
+        }
+    }
+    for (int b = 0; b < numLoadBins; b++) {
+        difference.loadBins[b] = loadBins[b] - earlier.loadBins[b];
+    }
+    return difference;
+}
+
+double StageTiming::Snapshot::meanLoad() const noexcept {
+    return budgetNs > 0 ? static_cast<double>(blockNs)/budgetNs : 0.0;
+}
+
+double StageTiming::Snapshot::stageLoad(Stage stage) const noexcept {
+    return budgetNs > 0 ? static_cast<double>(stageNs[stage])/budgetNs : 0.0;
+}
+
+double StageTiming::Snapshot::loadPercentile(double fraction) const noexcept {
+    return percentile(loadBins, fraction, [](int bin) { return (bin + 1)/100.0; });
+}
+
+double StageTiming::Snapshot::stagePercentileNs(Stage stage, double fraction) const noexcept {
+    return percentile(stageBins[stage], fraction, [](int bin) { return binLowerNs(bin + 1); });
+}
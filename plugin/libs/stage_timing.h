@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Where the audio thread spends its time: how long each stage of a block
+// took, and how much of the block's duration the whole block took, counted
+// into histograms. The audio thread is the only writer and never waits; any
+// other thread can read at any time, and the difference between two
+// snapshots is what happened in between. Counters are read one at a time,
+// so a snapshot may be a block behind in some of them.
+class StageTiming {
+public:
+    enum Stage { ingest, analysis, synthesis, output, numStages };
+
+    // Quarter-octave bins of nanoseconds, exact below 4 ns; the last bin
+    // collects everything from about 4 s up
+    static constexpr int numTimeBins = 128;
+    // Bins of 1% of the block's duration; the last collects 400% and up
+    static constexpr int numLoadBins = 401;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot {
+        uint64_t blocks = 0;
+        uint64_t blockNs = 0;
+        uint64_t budgetNs = 0;
+        uint64_t stageNs[numStages] = {};
+        uint32_t stageBins[numStages][numTimeBins] = {};
+        uint32_t loadBins[numLoadBins] = {};
+
+        // What happened between earlier and this snapshot
+        Snapshot since(const Snapshot& earlier) const noexcept;
+
+        // Processing time over the duration of the audio processed; 1 is
+        // the whole budget
+        double meanLoad() const noexcept;
+        double stageLoad(Stage stage) const noexcept;
+        // Upper bounds of the bins, 0 without blocks
+        double loadPercentile(double fraction) const noexcept;
+        double peakLoad() const noexcept { return loadPercentile(1.0); }
+        double stagePercentileNs(Stage stage, double fraction) const noexcept;
+    };
+
+    // Audio thread: beginBlock, any number of addStage, then endBlock with
+    // the duration of the audio the block processed
+    void beginBlock() noexcept {
+        blockStart = Clock::now();
+        for (auto& ns : current) {
+            ns = 0;
+        }
+    }
+    void addStage(Stage stage, Clock::duration elapsed) noexcept {
+        current[stage] += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    void endBlock(double budgetSeconds) noexcept;
+
+    // Any thread
+    void read(Snapshot& snapshot) const noexcept;
+
+    static int timeBin(uint64_t ns) noexcept;
+    static double binLowerNs(int bin) noexcept;
+
+private:
+    // Single writer, so increments need no read-modify-write
+    template <typename T>
+    static void increment(std::atomic<T>& counter, T amount = 1) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    Clock::time_point blockStart;
+    uint64_t current[numStages] = {};
+
+    std::atomic<uint64_t> blocks{0};
+    std::atomic<uint64_t> blockNs{0};
+    std::atomic<uint64_t> budgetNs{0};
+    std::atomic<uint64_t> stageNs[numStages] = {};
+    std::atomic<uint32_t> stageBins[numStages][numTimeBins] = {};
+    std::atomic<uint32_t> loadBins[numLoadBins] = {};
+};
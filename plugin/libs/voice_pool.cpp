@@ -0,0 +1,110 @@
+#include "voice_pool.h"
+#include <cmath>
+#include <cstring>
+
+void VoicePool::prepare(int numChannels, double fs) {
+    sampleRate = fs;
+    channels.resize(numChannels);
+    for (int v = 0; v < maxVoices; v++) {
+        notes[v] = -1;
+        increments[v] = 0.0;
+        targetGains[v] = 0.0;
+        startedAt[v] = 0;
+    }
+    for (auto& c : channels) {
+        memset(c.phases, 0, sizeof(c.phases));
+        memset(c.gains, 0, sizeof(c.gains));
+    }
+    noteCounter = 0;
+}
+
+void VoicePool::noteOn(int note, float velocity) noexcept {
+    // Reuse a voice already on this note, then a released voice, and
+    // otherwise steal the oldest one
+    int voice = -1;
+    for (int v = 0; v < maxVoices && voice < 0; v++) {
+        if (notes[v] == note) {
+            voice = v;
+        }
+    }
+    for (int v = 0; v < maxVoices && voice < 0; v++) {
+        if (notes[v] < 0) {
+            voice = v;
+        }
+    }
+    if (voice < 0) {
+        voice = 0;
+        for (int v = 1; v < maxVoices; v++) {
+            if (startedAt[v] < startedAt[voice]) {
+                voice = v;
+            }
+        }
+    }
+    double freq = 440.0*std::pow(2.0, (note - 69)/12.0);
+    notes[voice] = note;
+    // Kept below Nyquist/2 so the polyBLEP correction regions never overlap
+    increments[voice] = std::fmin(freq/sampleRate, 0.45);
+    targetGains[voice] = velocity;
+    startedAt[voice] = ++noteCounter;
+}
+
+void VoicePool::noteOff(int note) noexcept {
+    for (int v = 0; v < maxVoices; v++) {
+        if (notes[v] == note) {
+            notes[v] = -1;
+            targetGains[v] = 0.0;
+        }
+    }
+}
+
+void VoicePool::allNotesOff() noexcept {
+    for (int v = 0; v < maxVoices; v++) {
+        notes[v] = -1;
+        targetGains[v] = 0.0;
+    }
+}
+
+int VoicePool::getNumActiveVoices() const noexcept {
+    int count = 0;
+    for (int v = 0; v < maxVoices; v++) {
+        count += notes[v] >= 0;
+    }
+    return count;
+}
+
+void VoicePool::render(int ch, double* out, int numSamples, int advance) noexcept {
+    ChannelVoices& c = channels[ch];
+    const double voiceScale = 0.25;
+    for (int n = 0; n < numSamples; n++) {
+        out[n] = 0.0;
+    }
+    for (int v = 0; v < maxVoices; v++) {
+        const double g0 = c.gains[v];
+        const double g1 = targetGains[v];
+        if (g0 == 0.0 && g1 == 0.0) {
+            continue;
+        }
+        const double inc = increments[v];
+        const double p0 = c.phases[v];
+        const double gainStep = (g1 - g0)/numSamples;
+        // PolyBLEP sawtooth with a linear gain ramp across the frame, written
+        // without branches so that the sample loop vectorizes
+        for (int n = 0; n < numSamples; n++) {
+            // Phases are never negative, so truncation is floor and, unlike
+            // std::floor, vectorizes without relaxed floating point flags
+            double phi = p0 + n*inc;
+            phi -= static_cast<int>(phi);
+            const double t1 = phi/inc;
+            const double t2 = (phi - 1.0)/inc;
+            const double nearStart = phi < inc ? 1.0 : 0.0;
+            const double nearEnd = phi > 1.0 - inc ? 1.0 : 0.0;
+            const double blep = nearStart*(2.0*t1 - t1*t1 - 1.0) + nearEnd*(t2*t2 + 2.0*t2 + 1.0);
+            const double saw = 2.0*phi - 1.0 - blep;
+            out[n] += voiceScale*(g0 + gainStep*n)*saw;
+        }
+        double phase = p0 + advance*inc;
+        c.phases[v] = phase - std::floor(phase);
+        double gain = g0 + gainStep*advance;
+        c.gains[v] = std::fabs(gain - g1) < 1e-4 ? g1 : gain;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// A fixed pool of band-limited sawtooth voices played from MIDI and used as a
+// pitched excitation. Everything is allocated in prepare(); note handling and
+// rendering never touch the heap. Voices are stored as parallel arrays so
+// that the oscillator bank renders every voice in the same vectorizable loop,
+// and the cost is bounded by maxVoices however many notes are held.
+class VoicePool {
+public:
+    static constexpr int maxVoices = 16;
+
+    void prepare(int numChannels, double sampleRate);
+    void noteOn(int note, float velocity) noexcept;
+    void noteOff(int note) noexcept;
+    void allNotesOff() noexcept;
+    int getNumActiveVoices() const noexcept;
+
+    // Renders numSamples of the summed voices for a channel, then moves the
+    // channel's oscillators on by advance samples. Advancing by the hop size
+    // keeps overlapping frames phase coherent.
+    void render(int ch, double* out, int numSamples, int advance) noexcept;
+
+private:
+    struct ChannelVoices {
+        double phases[maxVoices];
+        double gains[maxVoices];
+    };
+
+    double sampleRate = 44100.0;
+    int notes[maxVoices];
+    double increments[maxVoices];
+    double targetGains[maxVoices];
+    uint64_t startedAt[maxVoices];
+    uint64_t noteCounter = 0;
+    vector<ChannelVoices> channels;
+};
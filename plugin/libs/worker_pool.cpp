@@ -0,0 +1,117 @@
+#include "worker_pool.h"
+#include "denormals.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class WorkerPool::Worker {
+public:
+    Worker(WorkerPool& p, int index) : pool(p), thread(index) {}
+
+    void start() {
+        worker = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            shouldExit = true;
+            woken = true;
+        }
+        wakeCondition.notify_one();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    void wake() {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            woken = true;
+        }
+        wakeCondition.notify_one();
+    }
+
+private:
+    void run() {
+        ScopedFlushDenormals noDenormals;
+        for (;;) {
+            while (pool.runNextTask(thread)) {
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [this] { return woken; });
+            woken = false;
+            if (shouldExit) {
+                return;
+            }
+        }
+    }
+
+    WorkerPool& pool;
+    int thread;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    bool woken = false;
+    bool shouldExit = false;
+};
+
+WorkerPool::WorkerPool() {
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start(int numWorkers) {
+    if (static_cast<int>(workers.size()) == numWorkers) {
+        return;
+    }
+    stop();
+    for (int i = 0; i < numWorkers; i++) {
+        workers.push_back(std::make_unique<Worker>(*this, i + 1));
+        workers.back()->start();
+    }
+}
+
+void WorkerPool::stop() {
+    for (auto& worker : workers) {
+        worker->stop();
+    }
+    workers.clear();
+}
+
+void WorkerPool::run(Job& job, int numTasks) {
+    if (numTasks <= 0) {
+        return;
+    }
+    currentJob = &job;
+    remaining.store(numTasks, std::memory_order_relaxed);
+    // Publishes the job along with the tasks; a worker still holding the
+    // previous word fails to claim from it
+    tasks.store(static_cast<uint64_t>(numTasks) << 32, std::memory_order_release);
+    for (auto& worker : workers) {
+        worker->wake();
+    }
+    while (runNextTask(0)) {
+    }
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+}
+
+bool WorkerPool::runNextTask(int thread) {
+    uint64_t word = tasks.load(std::memory_order_acquire);
+    for (;;) {
+        const uint32_t numTasks = static_cast<uint32_t>(word >> 32);
+        const uint32_t task = static_cast<uint32_t>(word);
+        if (task >= numTasks) {
+            return false;
+        }
+        if (tasks.compare_exchange_weak(word, word + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            currentJob->run(static_cast<int>(task), thread);
+            remaining.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+    }
+}
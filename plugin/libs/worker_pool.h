@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// A fork-join pool for non-realtime rendering. run() hands out the tasks of a
+// job to the workers and the calling thread alike and returns once all of
+// them have finished. Tasks are claimed from a single atomic word holding the
+// task count and the next index, so handing them out takes no lock and no
+// allocation.
+class WorkerPool {
+public:
+    struct Job {
+        virtual ~Job() = default;
+        // thread is 0 for the calling thread and 1 to numWorkers for the workers
+        virtual void run(int task, int thread) = 0;
+    };
+
+    WorkerPool();
+    ~WorkerPool();
+
+    // Not real-time safe
+    void start(int numWorkers);
+    void stop();
+    bool isRunning() const { return !workers.empty(); }
+    int getNumThreads() const { return static_cast<int>(workers.size()) + 1; }
+
+    // From one thread at a time
+    void run(Job& job, int numTasks);
+
+private:
+    class Worker;
+
+    bool runNextTask(int thread);
+
+    vector<unique_ptr<Worker>> workers;
+    Job* currentJob = nullptr;
+    // Task count in the upper half, next task in the lower half
+    std::atomic<uint64_t> tasks{0};
+    std::atomic<int> remaining{0};
+};
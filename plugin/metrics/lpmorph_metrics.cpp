@@ -0,0 +1,300 @@
+// Reads the metrics that engines publish to shared memory (see
+// metrics_export.h) and writes them in the Prometheus text format, for the
+// textfile collector of node_exporter or anything else that scrapes files.
+//
+//   lpmorph-metrics [options] [SEGMENT...]
+//
+//   --output FILE        write to FILE instead of stdout, replacing it
+//                        atomically so that a collector never reads half
+//   --interval SECONDS   keep rewriting the output every SECONDS
+//   --remove-stale       remove segments whose publisher is gone
+//
+// Without segments, every segment on the machine is read (Linux). Segments
+// left behind by a publisher that crashed are skipped, and removed with
+// --remove-stale. Every series is labelled with the segment, the
+// publisher's label and its process ID.
+//
+// Counters are totals since the publisher started. Loads and quantiles are
+// gauges over the publisher's last update interval, a quarter of a second
+// by default; quantiles are the upper bounds of histogram bins. Memory use
+// is not published; it is read here from /proc, where there is one.
+
+#include "metrics_export.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Config {
+    std::vector<std::string> segments;
+    std::string outputPath;
+    double interval = 0.0;
+    bool removeStale = false;
+};
+
+struct Published {
+    std::string segment;
+    SharedMetrics metrics;
+    // Current and peak resident memory of the publishing process, 0 where
+    // unknown
+    uint64_t residentBytes = 0;
+    uint64_t peakResidentBytes = 0;
+};
+
+struct Series {
+    std::string labels;
+    double value;
+};
+
+const char* const stageNames[SharedMetrics::numStages] = { "ingest", "analysis", "synthesis", "output" };
+
+// VmRSS and VmHWM from /proc/<pid>/status, which the kernel gives in kB
+void readMemory(Published& published) {
+#if defined(__linux__)
+    std::ifstream status("/proc/" + std::to_string(published.metrics.processId) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        const bool resident = line.compare(0, 6, "VmRSS:") == 0;
+        const bool peak = line.compare(0, 6, "VmHWM:") == 0;
+        if (resident || peak) {
+            const uint64_t bytes = std::strtoull(line.c_str() + 6, nullptr, 10)*1024;
+            (resident ? published.residentBytes : published.peakResidentBytes) = bytes;
+        }
+    }
+#else
+    (void)published;
+#endif
+}
+
+std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (c == '\n') {
+            escaped += "\\n";
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string baseLabels(const Published& published) {
+    std::string segment = published.segment;
+    if (!segment.empty() && segment[0] == '/') {
+        segment.erase(0, 1);
+    }
+    return "segment=\"" + escapeLabel(segment) + "\",label=\"" + escapeLabel(published.metrics.label)
+           + "\",pid=\"" + std::to_string(published.metrics.processId) + "\"";
+}
+
+std::string formatValue(double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.15g", value);
+    return text;
+}
+
+void writeFamily(std::ostream& out, const std::string& name, const char* type, const char* help, const std::vector<Series>& series) {
+    if (series.empty()) {
+        return;
+    }
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+    for (const auto& s : series) {
+        out << name << "{" << s.labels << "} " << formatValue(s.value) << "\n";
+    }
+}
+
+// One series per publisher, of value(metrics)
+template <typename Value>
+void writeFamily(std::ostream& out, const std::string& name, const char* type, const char* help, const std::vector<Published>& all, Value value) {
+    std::vector<Series> series;
+    for (const auto& published : all) {
+        series.push_back({ baseLabels(published), value(published.metrics) });
+    }
+    writeFamily(out, name, type, help, series);
+}
+
+// One series per publisher and stage, of value(metrics, stage)
+template <typename Value>
+void writeStageFamily(std::ostream& out, const std::string& name, const char* type, const char* help, const std::vector<Published>& all, Value value) {
+    std::vector<Series> series;
+    for (const auto& published : all) {
+        for (int s = 0; s < SharedMetrics::numStages; s++) {
+            series.push_back({ baseLabels(published) + ",stage=\"" + stageNames[s] + "\"", value(published.metrics, s) });
+        }
+    }
+    writeFamily(out, name, type, help, series);
+}
+
+void writeExposition(std::ostream& out, const std::vector<Published>& all) {
+    using M = SharedMetrics;
+    writeFamily(out, "lpmorph_blocks_total", "counter", "Blocks processed.", all,
+                [](const M& m) { return static_cast<double>(m.blocks); });
+    writeFamily(out, "lpmorph_processing_seconds_total", "counter", "Time spent processing blocks.", all,
+                [](const M& m) { return m.processingNs/1e9; });
+    writeFamily(out, "lpmorph_audio_seconds_total", "counter", "Duration of the audio processed.", all,
+                [](const M& m) { return m.audioNs/1e9; });
+    writeFamily(out, "lpmorph_overruns_total", "counter", "Blocks that took longer to process than their audio lasts.", all,
+                [](const M& m) { return static_cast<double>(m.overruns); });
+    writeStageFamily(out, "lpmorph_stage_seconds_total", "counter", "Time spent in each stage of processing.", all,
+                     [](const M& m, int s) { return m.stageNs[s]/1e9; });
+    for (int c = 0; c < DSPDiagnostics::numCounters; c++) {
+        const auto counter = static_cast<DSPDiagnostics::Counter>(c);
+        const std::string help = std::string("Count of ") + DSPDiagnostics::label(counter) + ".";
+        writeFamily(out, std::string("lpmorph_") + DSPDiagnostics::key(counter) + "_total", "counter", help.c_str(), all,
+                    [c](const M& m) { return static_cast<double>(m.diagnostics[c]); });
+    }
+
+    writeFamily(out, "lpmorph_load", "gauge", "Processing time over the duration of the audio, over the last interval.", all,
+                [](const M& m) { return m.load; });
+    std::vector<Series> loadQuantiles;
+    for (const auto& published : all) {
+        const std::string labels = baseLabels(published);
+        loadQuantiles.push_back({ labels + ",quantile=\"0.5\"", published.metrics.loadP50 });
+        loadQuantiles.push_back({ labels + ",quantile=\"0.99\"", published.metrics.loadP99 });
+        loadQuantiles.push_back({ labels + ",quantile=\"1\"", published.metrics.loadMax });
+    }
+    writeFamily(out, "lpmorph_load_quantile", "gauge", "Quantiles of the load of each block, over the last interval.", loadQuantiles);
+    writeStageFamily(out, "lpmorph_stage_load", "gauge", "Time in each stage over the duration of the audio, over the last interval.", all,
+                     [](const M& m, int s) { return m.stageLoad[s]; });
+    std::vector<Series> stageQuantiles;
+    for (const auto& published : all) {
+        const std::string labels = baseLabels(published);
+        const M& m = published.metrics;
+        for (int s = 0; s < M::numStages; s++) {
+            const std::string stage = labels + ",stage=\"" + stageNames[s] + "\"";
+            stageQuantiles.push_back({ stage + ",quantile=\"0.5\"", m.stageP50Ns[s]/1e9 });
+            stageQuantiles.push_back({ stage + ",quantile=\"0.99\"", m.stageP99Ns[s]/1e9 });
+            stageQuantiles.push_back({ stage + ",quantile=\"1\"", m.stageMaxNs[s]/1e9 });
+        }
+    }
+    writeFamily(out, "lpmorph_stage_duration_seconds", "gauge", "Quantiles of the time each stage took per block, over the last interval.", stageQuantiles);
+
+    std::vector<Series> peakResident;
+    std::vector<Series> resident;
+    for (const auto& published : all) {
+        if (published.peakResidentBytes > 0) {
+            peakResident.push_back({ baseLabels(published), static_cast<double>(published.peakResidentBytes) });
+        }
+        if (published.residentBytes > 0) {
+            resident.push_back({ baseLabels(published), static_cast<double>(published.residentBytes) });
+        }
+    }
+    writeFamily(out, "lpmorph_peak_resident_bytes", "gauge", "Peak resident memory of the publishing process.", peakResident);
+    writeFamily(out, "lpmorph_resident_bytes", "gauge", "Resident memory of the publishing process.", resident);
+    writeFamily(out, "lpmorph_sample_rate_hz", "gauge", "Sample rate of the engine.", all,
+                [](const M& m) { return m.sampleRate; });
+    writeFamily(out, "lpmorph_last_update_timestamp_seconds", "gauge", "When the publisher last updated its metrics.", all,
+                [](const M& m) { return m.updatedNs/1e9; });
+}
+
+std::vector<Published> readAll(const Config& config) {
+    std::vector<Published> all;
+    const auto segments = config.segments.empty() ? MetricsReader::list() : config.segments;
+    for (const auto& segment : segments) {
+        MetricsReader reader;
+        std::string error;
+        Published published;
+        published.segment = segment;
+        if (!reader.open(segment, error)) {
+            std::cerr << error << std::endl;
+            continue;
+        }
+        if (!reader.read(published.metrics)) {
+            std::cerr << segment << ": publisher kept updating, skipped" << std::endl;
+            continue;
+        }
+        if (!MetricsReader::isPublisherAlive(published.metrics)) {
+            if (config.removeStale && MetricsReader::remove(segment)) {
+                std::cerr << segment << ": publisher is gone, removed" << std::endl;
+            }
+            continue;
+        }
+        readMemory(published);
+        all.push_back(published);
+    }
+    return all;
+}
+
+bool writeOutput(const Config& config, const std::vector<Published>& all) {
+    if (config.outputPath.empty()) {
+        writeExposition(std::cout, all);
+        std::cout.flush();
+        return static_cast<bool>(std::cout);
+    }
+    const std::string temporaryPath = config.outputPath + ".tmp";
+    {
+        std::ofstream out(temporaryPath);
+        writeExposition(out, all);
+        out.close();
+        if (!out) {
+            std::cerr << "cannot write " << temporaryPath << std::endl;
+            return false;
+        }
+    }
+    if (std::rename(temporaryPath.c_str(), config.outputPath.c_str()) != 0) {
+        std::cerr << "cannot replace " << config.outputPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void printUsage() {
+    std::cout << "usage: lpmorph-metrics [--output FILE] [--interval SECONDS] [--remove-stale] [SEGMENT...]\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool ok = true;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if (arg == "--output" && hasValue) {
+            config.outputPath = argv[++i];
+        }
+        else if (arg == "--interval" && hasValue) {
+            config.interval = std::atof(argv[++i]);
+            ok = config.interval > 0.0;
+        }
+        else if (arg == "--remove-stale") {
+            config.removeStale = true;
+        }
+        else if (!arg.empty() && arg[0] != '-') {
+            config.segments.push_back(arg);
+        }
+        else {
+            ok = false;
+        }
+        if (!ok) {
+            printUsage();
+            return 1;
+        }
+    }
+
+    for (;;) {
+        if (!writeOutput(config, readAll(config))) {
+            return 1;
+        }
+        if (config.interval <= 0.0) {
+            return 0;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(config.interval));
+    }
+}
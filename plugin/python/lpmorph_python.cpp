@@ -0,0 +1,288 @@
+// Python bindings for the DSP library, for running the engine over datasets
+// from NumPy. An Engine is one stream: successive process() calls continue
+// where the last one ended, as successive host blocks do.
+//
+// float32 arrays are processed where they are, in any layout NumPy can
+// describe with strides: the engine reads and writes each channel through
+// its stride. Other dtypes are converted to float32 first and the result
+// converted back, since the engine's audio is float32. The GIL is released
+// while processing, so threads running separate engines run in parallel.
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include "lpmorph_dsp.h"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace
+{
+const char* excitationNames[] = { "off", "noise", "pulse", "glottal", "midi", "table" };
+
+lpmorph_excitation excitationFromName(const std::string& name)
+{
+    for (int i = 0; i <= LPMORPH_EXCITATION_TABLE; i++) {
+        if (name == excitationNames[i]) {
+            return static_cast<lpmorph_excitation>(i);
+        }
+    }
+    throw py::value_error("unknown excitation \"" + name + "\"; expected off, noise, pulse, glottal, midi or table");
+}
+
+// Where one channel's samples are in an array of shape (frames,) or
+// (frames, channels), in floats
+struct Layout {
+    float* data = nullptr;
+    py::ssize_t frameStride = 0;
+    py::ssize_t channelStride = 0;
+};
+
+// A native float32 array's layout, or false when the engine cannot use the
+// array as it is
+bool getLayout(const py::array& array, Layout& layout)
+{
+    if (!py::isinstance<py::array_t<float>>(array) || reinterpret_cast<uintptr_t>(array.data()) % alignof(float) != 0) {
+        return false;
+    }
+    const auto* strides = array.strides();
+    if (strides[0] % static_cast<py::ssize_t>(sizeof(float)) != 0
+        || (array.ndim() == 2 && strides[1] % static_cast<py::ssize_t>(sizeof(float)) != 0)) {
+        return false;
+    }
+    layout.data = static_cast<float*>(const_cast<void*>(array.data()));
+    layout.frameStride = strides[0]/static_cast<py::ssize_t>(sizeof(float));
+    layout.channelStride = array.ndim() == 2 ? strides[1]/static_cast<py::ssize_t>(sizeof(float)) : 0;
+    return true;
+}
+
+py::array toFloat32(const py::array& array)
+{
+    return py::array_t<float, py::array::c_style | py::array::forcecast>::ensure(array);
+}
+}
+
+class Engine
+{
+public:
+    Engine(int channels, double sampleRate, float mix, float wetGain, int order, float frameDuration, const std::string& excitation)
+        : engine(lpmorph_create(channels), &lpmorph_destroy), numChannels(channels), sampleRate(sampleRate)
+    {
+        if (engine == nullptr) {
+            throw py::value_error("channels must be between 1 and 64");
+        }
+        setMix(mix);
+        setWetGain(wetGain);
+        setOrder(order);
+        setFrameDuration(frameDuration);
+        setExcitation(excitation);
+        reset();
+    }
+
+    // Starts a new stream, clearing the audio state
+    void reset()
+    {
+        const std::lock_guard<std::mutex> sl(lock);
+        if (lpmorph_prepare(engine.get(), sampleRate) != LPMORPH_OK) {
+            throw py::value_error("unsupported sample rate " + std::to_string(sampleRate));
+        }
+    }
+
+    py::array process(const py::array& audio, py::object out, py::object sidechain)
+    {
+        checkShape(audio, "audio");
+        if (audio.shape(0) > std::numeric_limits<int>::max()) {
+            throw py::value_error("audio is too long for one call; process it in chunks");
+        }
+        const int numFrames = static_cast<int>(audio.shape(0));
+
+        // The engine reads input and sidechain with one stride, so both are
+        // converted unless they are float32 laid out alike
+        // A default py::array is an empty array rather than a null one, so
+        // whether there is a sidechain is kept apart from side
+        py::array input = audio;
+        py::array side;
+        const bool hasSidechain = !sidechain.is_none();
+        Layout inputLayout, sideLayout;
+        bool direct = getLayout(input, inputLayout);
+        if (hasSidechain) {
+            side = py::array::ensure(sidechain);
+            if (!side) {
+                throw py::type_error("sidechain must be an array");
+            }
+            checkShape(side, "sidechain");
+            if (side.shape(0) != numFrames) {
+                throw py::value_error("sidechain must have as many frames as audio");
+            }
+            direct = direct && getLayout(side, sideLayout) && sideLayout.frameStride == inputLayout.frameStride;
+        }
+        if (!direct) {
+            input = toFloat32(input);
+            getLayout(input, inputLayout);
+            if (hasSidechain) {
+                side = toFloat32(side);
+                getLayout(side, sideLayout);
+            }
+        }
+
+        py::array result;
+        py::array output;
+        if (out.is_none()) {
+            // float64 in, float64 out; float32 otherwise
+            auto type = py::isinstance<py::array_t<double>>(audio) ? py::dtype::of<double>() : py::dtype::of<float>();
+            result = py::array(type, std::vector<py::ssize_t>(audio.shape(), audio.shape() + audio.ndim()));
+        }
+        else {
+            result = py::array::ensure(out);
+            if (!result || !result.writeable()) {
+                throw py::type_error("out must be a writeable array");
+            }
+            checkShape(result, "out");
+            if (result.shape(0) != numFrames) {
+                throw py::value_error("out must have as many frames as audio");
+            }
+        }
+        Layout outputLayout;
+        const bool outputDirect = getLayout(result, outputLayout);
+        if (!outputDirect) {
+            output = py::array_t<float>(std::vector<py::ssize_t>(result.shape(), result.shape() + result.ndim()));
+            getLayout(output, outputLayout);
+        }
+
+        // Local, so that threads sharing the engine each pass their own
+        std::vector<const float*> inputs(numChannels);
+        std::vector<float*> outputs(numChannels);
+        std::vector<const float*> sidechains(numChannels);
+        for (int ch = 0; ch < numChannels; ch++) {
+            inputs[ch] = inputLayout.data + ch*inputLayout.channelStride;
+            outputs[ch] = outputLayout.data + ch*outputLayout.channelStride;
+            sidechains[ch] = hasSidechain ? sideLayout.data + ch*sideLayout.channelStride : nullptr;
+        }
+        int status;
+        {
+            py::gil_scoped_release release;
+            const std::lock_guard<std::mutex> sl(lock);
+            status = lpmorph_process_strided(engine.get(), inputs.data(), outputs.data(), hasSidechain ? sidechains.data() : nullptr,
+                                             numFrames, static_cast<int>(inputLayout.frameStride), static_cast<int>(outputLayout.frameStride));
+        }
+        if (status < 0) {
+            throw std::runtime_error("processing failed with status " + std::to_string(status));
+        }
+        clipped = status == LPMORPH_CLIPPED;
+        if (!outputDirect) {
+            py::module_::import("numpy").attr("copyto")(result, output, py::arg("casting") = "unsafe");
+        }
+        return result;
+    }
+
+    void setExcitationTable(const py::array& table)
+    {
+        auto samples = py::array_t<float, py::array::c_style | py::array::forcecast>::ensure(table);
+        if (!samples || samples.ndim() != 1) {
+            throw py::value_error("the excitation table must be one-dimensional");
+        }
+        const std::lock_guard<std::mutex> sl(lock);
+        if (lpmorph_set_excitation_table(engine.get(), samples.data(), static_cast<size_t>(samples.size())) != LPMORPH_OK) {
+            throw std::bad_alloc();
+        }
+    }
+
+    void setExcitationLoop(float start, float length)
+    {
+        const std::lock_guard<std::mutex> sl(lock);
+        lpmorph_set_excitation_loop(engine.get(), start, length);
+    }
+
+    void noteOn(int note, float velocity)
+    {
+        const std::lock_guard<std::mutex> sl(lock);
+        lpmorph_note_on(engine.get(), note, velocity);
+    }
+
+    void noteOff(int note)
+    {
+        const std::lock_guard<std::mutex> sl(lock);
+        lpmorph_note_off(engine.get(), note);
+    }
+
+    void allNotesOff()
+    {
+        const std::lock_guard<std::mutex> sl(lock);
+        lpmorph_all_notes_off(engine.get());
+    }
+
+    // The setters only store values the next block picks up, and need no lock
+    void setMix(float value) { mix = value; lpmorph_set_mix(engine.get(), value); }
+    void setWetGain(float value) { wetGain = value; lpmorph_set_wet_gain(engine.get(), value); }
+    void setOrder(int value) { order = value; lpmorph_set_order(engine.get(), value); }
+    void setFrameDuration(float value) { frameDuration = value; lpmorph_set_frame_duration(engine.get(), value); }
+    void setExcitation(const std::string& name)
+    {
+        lpmorph_set_excitation(engine.get(), excitationFromName(name));
+        excitation = name;
+    }
+
+    float mix = 0.f;
+    float wetGain = 0.f;
+    int order = LPMORPH_MAX_ORDER/2;
+    float frameDuration = 10.f;
+    std::string excitation;
+    bool clipped = false;
+
+    int getLatency() const { return lpmorph_get_latency(engine.get()); }
+    int getHopSize() const { return lpmorph_get_hop_size(engine.get()); }
+    int getNumChannels() const { return numChannels; }
+    double getSampleRate() const { return sampleRate; }
+
+private:
+    void checkShape(const py::array& array, const char* name) const
+    {
+        const bool mono = array.ndim() == 1 && numChannels == 1;
+        if (!mono && !(array.ndim() == 2 && array.shape(1) == numChannels)) {
+            throw py::value_error(std::string(name) + " must have shape (frames, " + std::to_string(numChannels) + ")"
+                                  + (numChannels == 1 ? " or (frames,)" : ""));
+        }
+    }
+
+    std::unique_ptr<lpmorph_engine, decltype(&lpmorph_destroy)> engine;
+    int numChannels;
+    double sampleRate;
+    // Serialises calls from several Python threads sharing an engine
+    std::mutex lock;
+};
+
+PYBIND11_MODULE(lpmorph, m)
+{
+    m.doc() = "The LP Morph engine, processing NumPy arrays of shape (frames, channels)";
+
+    py::class_<Engine>(m, "Engine")
+        .def(py::init<int, double, float, float, int, float, const std::string&>(),
+             py::arg("channels"), py::arg("sample_rate"), py::kw_only(),
+             py::arg("mix") = 0.f, py::arg("wet_gain") = 0.f, py::arg("order") = LPMORPH_MAX_ORDER/2,
+             py::arg("frame_duration") = 10.f, py::arg("excitation") = "noise")
+        .def("process", &Engine::process, py::arg("audio"), py::kw_only(), py::arg("out") = py::none(), py::arg("sidechain") = py::none(),
+             "Processes the next frames of the stream and returns them, in out if given. out may be audio itself.")
+        .def("reset", &Engine::reset, "Starts a new stream")
+        .def("set_excitation_table", &Engine::setExcitationTable, py::arg("samples"))
+        .def("set_excitation_loop", &Engine::setExcitationLoop, py::arg("start"), py::arg("length"),
+             "The part of the table played, as fractions of its length")
+        .def("note_on", &Engine::noteOn, py::arg("note"), py::arg("velocity") = 1.f)
+        .def("note_off", &Engine::noteOff, py::arg("note"))
+        .def("all_notes_off", &Engine::allNotesOff)
+        .def_property("mix", [](const Engine& e) { return e.mix; }, &Engine::setMix)
+        .def_property("wet_gain", [](const Engine& e) { return e.wetGain; }, &Engine::setWetGain)
+        .def_property("order", [](const Engine& e) { return e.order; }, &Engine::setOrder)
+        .def_property("frame_duration", [](const Engine& e) { return e.frameDuration; }, &Engine::setFrameDuration,
+                      "Currently ignored: frames are always 1024 samples, as latency reports")
+        .def_property("excitation", [](const Engine& e) { return e.excitation; }, &Engine::setExcitation)
+        .def_readonly("clipped", &Engine::clipped, "Whether the last process() call clipped")
+        .def_property_readonly("latency", &Engine::getLatency)
+        .def_property_readonly("hop_size", &Engine::getHopSize)
+        .def_property_readonly("channels", &Engine::getNumChannels)
+        .def_property_readonly("sample_rate", &Engine::getSampleRate);
+}
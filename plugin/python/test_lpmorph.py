@@ -0,0 +1,102 @@
+"""Checks of the lpmorph module, run by ctest with the module on PYTHONPATH.
+
+One Engine called from two threads at once: with the excitation off the
+engine passes audio through, so each call must return exactly its own
+input, which it cannot if the threads' channel pointers get mixed up.
+Arrays that are not float32 take a converted copy, with or without a
+sidechain; the pulse generator is deterministic, so two engines given the
+same audio either way must agree.
+"""
+
+import sys
+import threading
+
+import numpy as np
+import lpmorph
+
+
+def test_one_engine_from_two_threads():
+    engine = lpmorph.Engine(2, 48000.0, mix=1.0, excitation="off")
+    failures = []
+
+    def run(value, layout):
+        audio = np.full((512, 2), value, dtype=np.float32)
+        if layout == "fortran":
+            audio = np.asfortranarray(audio)
+        for _ in range(2000):
+            result = engine.process(audio)
+            if not np.array_equal(result, audio):
+                failures.append(value)
+                return
+
+    threads = [threading.Thread(target=run, args=(1.0, "c")), threading.Thread(target=run, args=(2.0, "fortran"))]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert not failures, "threads saw each other's audio: %s" % failures
+
+
+def speech_like(seed, frames=24000):
+    rng = np.random.default_rng(seed)
+    t = np.arange(frames)/48000.0
+    voiced = np.sin(2*np.pi*140*t)[:, None] + 0.05*rng.standard_normal((frames, 2))
+    return (0.3*voiced).astype(np.float32)
+
+
+def test_float64_round_trip():
+    audio = speech_like(2)
+    direct = lpmorph.Engine(2, 48000.0, mix=1.0, excitation="pulse")
+    converted = lpmorph.Engine(2, 48000.0, mix=1.0, excitation="pulse")
+    expected = direct.process(audio)
+    result = converted.process(audio.astype(np.float64))
+    assert result.dtype == np.float64
+    assert np.array_equal(result, expected.astype(np.float64)), "float64 audio processed differently"
+
+
+def test_sidechain():
+    audio = speech_like(3)
+    side = speech_like(4)
+    plain = lpmorph.Engine(2, 48000.0, mix=1.0, excitation="pulse")
+    direct = lpmorph.Engine(2, 48000.0, mix=1.0, excitation="pulse")
+    converted = lpmorph.Engine(2, 48000.0, mix=1.0, excitation="pulse")
+    without = plain.process(audio)
+    expected = direct.process(audio, sidechain=side)
+    result = converted.process(audio.astype(np.float64), sidechain=side.astype(np.float64))
+    assert not np.array_equal(without, expected), "the sidechain made no difference"
+    assert np.array_equal(result, expected.astype(np.float64)), "converted sidechain processed differently"
+
+
+def test_process_while_changing_from_another_thread():
+    engine = lpmorph.Engine(2, 48000.0, mix=1.0, excitation="noise")
+    running = True
+
+    def change():
+        i = 0
+        while running:
+            engine.order = 1 + i % 50
+            engine.set_excitation_loop(0.1*(i % 10), 0.5)
+            i += 1
+
+    changer = threading.Thread(target=change)
+    changer.start()
+    try:
+        audio = np.random.default_rng(1).uniform(-0.5, 0.5, (48000, 2)).astype(np.float32)
+        for start in range(0, len(audio), 480):
+            assert np.all(np.isfinite(engine.process(audio[start:start + 480])))
+    finally:
+        running = False
+        changer.join()
+
+
+if __name__ == "__main__":
+    failed = 0
+    for name, test in sorted(globals().items()):
+        if name.startswith("test_") and callable(test):
+            try:
+                test()
+                print("%-50s ok" % name)
+            except AssertionError as error:
+                print("%-50s FAILED: %s" % (name, error))
+                failed += 1
+    sys.exit(1 if failed else 0)
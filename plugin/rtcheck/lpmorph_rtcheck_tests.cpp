@@ -0,0 +1,747 @@
+// Runs the engine through every processing mode and parameter transition
+// with the audio thread checked by rt_check, and fails on any allocation,
+// lock or blocking call it makes while processing. Each block goes through
+// LPCEngine as processBlock sends it, with a background thread rebuilding
+// the excitation loop as the plugin's segment builder does; only the audio
+// thread is checked.
+//
+//   lpmorph-rtcheck-tests [case...]
+//   lpmorph-rtcheck-tests --list
+//
+// Without a case, runs them all. The factory tables, the segment builder
+// and the input come from the benchmarks' engine_harness.h and
+// bench_support.h; the input's silent sections mean frames with no energy
+// are processed too.
+
+#include "rt_check.h"
+#include "lpc_engine.h"
+#include "lpmorph_dsp.h"
+#include "denormals.h"
+#include "session_capture.h"
+#include "bench_support.h"
+#include "engine_harness.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using BenchSupport::numFactoryTables;
+
+const double sampleRate = 48000.0;
+const int numChannels = 2;
+const int maxBlockSize = 2048;
+const double secondsPerCase = 3.0;
+
+// An engine set up as prepareToPlay leaves the plugin's, with input and
+// sidechain audio to process
+class Harness {
+public:
+    Harness()
+        : engine(numChannels),
+          tables(BenchSupport::makeFactoryTables(sampleRate)),
+          segmentBuilder(engine, [this](int exType) { return excitation(exType, useCustom).table; }) {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<double> uniform(-0.5, 0.5);
+        customTable.resize(static_cast<size_t>(0.8*sampleRate));
+        for (auto& sample : customTable) {
+            sample = uniform(rng);
+        }
+        const size_t length = static_cast<size_t>(secondsPerCase*sampleRate);
+        for (int ch = 0; ch < numChannels; ch++) {
+            input[ch].resize(length);
+            sidechain[ch].resize(length);
+            output[ch].assign(maxBlockSize, 0.f);
+            BenchSupport::makeTestSignal(input[ch], sampleRate, 1 + ch);
+            BenchSupport::makeTestSignal(sidechain[ch], sampleRate, 11 + ch);
+        }
+    }
+
+    LPCExcitation excitation(int exType, bool custom = false) const {
+        LPCExcitation result = BenchSupport::factoryExcitation(tables, exType);
+        if (custom) {
+            result.table = &customTable;
+            result.custom = true;
+        }
+        return result;
+    }
+
+    void prepare(const LPCParameters& params, bool custom = false) {
+        segmentBuilder.stop();
+        useCustom = custom;
+        engine.prepare(sampleRate, params, excitation(params.exType, custom));
+        engine.buildExcitationSegment(excitation(params.exType, custom).table, params);
+        engine.lpc.beginBlock();
+        position = 0;
+        segmentBuilder.start(params);
+    }
+
+    // Whether the input has room for another block of numSamples
+    bool hasInput(int numSamples) const {
+        return position + numSamples <= input[0].size();
+    }
+
+    // One block through the engine as processBlock runs it, with midi
+    // applied between beginBlock and processing; checked throughout
+    void process(const LPCParameters& params, int numSamples, bool withSidechain = false, const std::function<void(LPC&)>& midi = nullptr,
+                 unsigned checks = RTCheck::all) {
+        const LPCExcitation blockExcitation = excitation(params.exType, useCustom);
+        {
+            RTCheck::ScopedRealtime realtime(checks);
+            // As the parameter listeners run under automation
+            segmentBuilder.write(params);
+            ScopedFlushDenormals noDenormals;
+            DSPTrace::Span span(engine.lpc.trace, DSPTrace::processBlock, -1, numSamples);
+            engine.beginBlock(params, blockExcitation);
+            if (midi) {
+                midi(engine.lpc);
+            }
+            for (int ch = 0; ch < numChannels; ch++) {
+                const float* sc = withSidechain ? sidechain[ch].data() + position : nullptr;
+                engine.processChannel(input[ch].data() + position, output[ch].data(), numSamples, ch, sc);
+            }
+            engine.endBlock();
+        }
+        position += numSamples;
+    }
+
+    LPCEngine engine;
+    vector<vector<double>> tables;
+    vector<double> customTable;
+    vector<float> input[numChannels];
+    vector<float> sidechain[numChannels];
+    vector<float> output[numChannels];
+    size_t position = 0;
+
+private:
+    std::atomic<bool> useCustom{false};
+    BenchSupport::SegmentBuilderThread segmentBuilder;
+};
+
+LPCParameters defaultParameters(int exType) {
+    LPCParameters params;
+    params.lpcMix = 1.f;
+    params.exType = exType;
+    return params;
+}
+
+// Blocks of 512 with the parameters given until the input runs out
+void processAll(Harness& harness, const LPCParameters& params, bool withSidechain = false) {
+    while (harness.hasInput(512)) {
+        harness.process(params, 512, withSidechain);
+    }
+}
+
+// The checker itself: each kind of call is caught inside a scope, only the
+// checks the scope asks for apply, and nothing is caught outside one
+bool testChecker() {
+    static void* volatile sink;
+    std::mutex mutex;
+    auto allocate = [] {
+        sink = ::operator new(64);
+        ::operator delete(sink);
+    };
+    auto lock = [&] {
+        mutex.lock();
+        mutex.unlock();
+    };
+    auto sleep = [] {
+        std::this_thread::sleep_for(std::chrono::microseconds(1));
+    };
+    auto print = [] {
+        std::fflush(stdout);
+    };
+    // As the reflection clamp once logged from the audio thread: the text,
+    // the newline and the flush each reach stdio. Only those are counted,
+    // as the first output also allocates stdout's buffer.
+    auto stream = [] {
+        std::cout << "checker: std::cout" << std::endl;
+    };
+    struct Expectation {
+        const char* name;
+        std::function<void()> call;
+        unsigned checks;
+        size_t violations;
+    };
+    const Expectation expectations[] = {
+        { "allocation", allocate, RTCheck::all, 2 },
+        { "lock", lock, RTCheck::all, 1 },
+        { "sleep", sleep, RTCheck::all, 1 },
+        { "stdio", print, RTCheck::all, 1 },
+        { "std::cout", stream, RTCheck::blockingCall, 3 },
+        { "lock, allocations only", lock, RTCheck::allocation, 0 },
+        { "allocation, locks only", allocate, RTCheck::lock, 0 },
+    };
+    bool passed = true;
+    for (const auto& expectation : expectations) {
+        RTCheck::reset();
+        {
+            RTCheck::ScopedRealtime realtime(expectation.checks);
+            expectation.call();
+        }
+        expectation.call();
+        if (RTCheck::violationCount() != expectation.violations) {
+            std::fprintf(stderr, "%s: %zu violations, expected %zu\n", expectation.name, RTCheck::violationCount(),
+                         expectation.violations);
+            passed = false;
+        }
+    }
+    RTCheck::reset();
+    return passed;
+}
+
+// Every factory table, each for a whole run
+bool testTables() {
+    for (int exType = 0; exType < numFactoryTables; exType++) {
+        Harness harness;
+        harness.prepare(defaultParameters(exType));
+        processAll(harness, defaultParameters(exType));
+    }
+    return true;
+}
+
+// Off, noise, pulse train and glottal pulse
+bool testGenerators() {
+    for (int exType = numFactoryTables; exType < numFactoryTables + 4; exType++) {
+        Harness harness;
+        harness.prepare(defaultParameters(exType));
+        processAll(harness, defaultParameters(exType));
+    }
+    return true;
+}
+
+// The MIDI excitation with notes starting and stopping, chords past the
+// voice count and all-notes-off, as processBlock applies them
+bool testMidi() {
+    Harness harness;
+    const LPCParameters params = defaultParameters(numFactoryTables + 4);
+    harness.prepare(params);
+    for (int block = 0; harness.hasInput(256); block++) {
+        harness.process(params, 256, false, [block](LPC& lpc) {
+            if (block % 40 == 39) {
+                lpc.voices.allNotesOff();
+                return;
+            }
+            for (int i = 0; i < 3; i++) {
+                const int note = 36 + (block*7 + i*5) % 48;
+                if ((block + i) % 3 == 0) {
+                    lpc.voices.noteOn(note, 0.3f + 0.2f*i);
+                }
+                else {
+                    lpc.voices.noteOff(note);
+                }
+            }
+        });
+    }
+    return true;
+}
+
+bool testSidechain() {
+    Harness harness;
+    LPCParameters params = defaultParameters(0);
+    params.useSidechain = true;
+    harness.prepare(params);
+    processAll(harness, params, true);
+    return true;
+}
+
+bool testCustomExcitation() {
+    Harness harness;
+    const LPCParameters params = defaultParameters(2);
+    harness.prepare(params, true);
+    processAll(harness, params);
+    return true;
+}
+
+// Interleaved input and output, as lpmorph_process_strided passes them
+bool testStrided() {
+    Harness harness;
+    const LPCParameters params = defaultParameters(1);
+    harness.prepare(params);
+    const int blockSize = 480;
+    vector<float> interleaved(static_cast<size_t>(blockSize)*numChannels);
+    while (harness.hasInput(blockSize)) {
+        for (int i = 0; i < blockSize; i++) {
+            for (int ch = 0; ch < numChannels; ch++) {
+                interleaved[i*numChannels + ch] = harness.input[ch][harness.position + i];
+            }
+        }
+        {
+            RTCheck::ScopedRealtime realtime;
+            ScopedFlushDenormals noDenormals;
+            harness.engine.beginBlock(params, harness.excitation(params.exType));
+            for (int ch = 0; ch < numChannels; ch++) {
+                harness.engine.processChannel(interleaved.data() + ch, interleaved.data() + ch, blockSize, ch, nullptr, numChannels,
+                                              numChannels);
+            }
+            harness.engine.endBlock();
+        }
+        harness.position += blockSize;
+    }
+    return true;
+}
+
+// Host block sizes changing from block to block, from one sample up to
+// the largest a host may send
+bool testBlockSizes() {
+    Harness harness;
+    const LPCParameters params = defaultParameters(3);
+    harness.prepare(params);
+    std::mt19937 rng(3);
+    const int sizes[] = { 1, 2, 17, 64, 127, 128, 441, 512, 1000, 1024, 2048 };
+    for (int block = 0; ; block++) {
+        const int numSamples = block % 3 == 2 ? std::uniform_int_distribution<int>(1, maxBlockSize)(rng) : sizes[block % 11];
+        if (!harness.hasInput(numSamples)) {
+            break;
+        }
+        harness.process(params, numSamples);
+    }
+    return true;
+}
+
+// The whole input in blocks of the given number of hops, as each channel's
+// output
+vector<vector<float>> renderInHops(const LPCParameters& params, int hops) {
+    Harness harness;
+    harness.prepare(params);
+    const int blockSize = hops*harness.engine.lpc.HOPSIZE;
+    vector<vector<float>> rendered(numChannels);
+    while (harness.hasInput(blockSize)) {
+        harness.process(params, blockSize);
+        for (int ch = 0; ch < numChannels; ch++) {
+            rendered[ch].insert(rendered[ch].end(), harness.output[ch].begin(), harness.output[ch].begin() + blockSize);
+        }
+    }
+    return rendered;
+}
+
+// Blocks of any multiple of the hop render alike, which lpmorph-render
+// relies on when it rounds -b up to one: a table and a generator, each in
+// blocks of one, two and three hops
+bool testHopBlocks() {
+    bool passed = true;
+    for (int exType : { 0, numFactoryTables + 1 }) {
+        const LPCParameters params = defaultParameters(exType);
+        const auto expected = renderInHops(params, 1);
+        for (int hops = 2; hops <= 3; hops++) {
+            const auto rendered = renderInHops(params, hops);
+            for (int ch = 0; ch < numChannels; ch++) {
+                const size_t length = std::min(expected[ch].size(), rendered[ch].size());
+                if (!std::equal(rendered[ch].begin(), rendered[ch].begin() + length, expected[ch].begin())) {
+                    std::fprintf(stderr, "hop-blocks: exType %d in blocks of %d hops differs from single hops\n", exType, hops);
+                    passed = false;
+                }
+            }
+        }
+    }
+    return passed;
+}
+
+// Every parameter jumping between the ends of its range and to random
+// values every block: a new order clears the synthesis history, a new
+// excitation resets the excitation pointers and a new Start or Length
+// rebuilds the loop
+bool testTransitions() {
+    Harness harness;
+    harness.prepare(defaultParameters(0));
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (int block = 0; harness.hasInput(256); block++) {
+        auto x = [&](int i) {
+            return block % 2 == 0 ? uniform(rng) : static_cast<double>((block/2 + i) % 2);
+        };
+        LPCParameters params;
+        params.wetGain = static_cast<float>(-40.0 + 60.0*x(0));
+        params.lpcMix = static_cast<float>(x(1));
+        params.exLen = static_cast<float>(0.0001 + 0.9999*x(2));
+        params.exStartPos = static_cast<float>(x(3));
+        params.exType = static_cast<int>(std::lround(11.0*x(4)));
+        params.lpcOrder = 1 + static_cast<int>(std::lround((MAX_ORDER - 1)*x(5)));
+        params.frameDur = static_cast<float>(0.1 + (MAX_FRAME_DUR - 0.1)*x(6));
+        harness.process(params, 256, block % 5 == 0);
+    }
+    return true;
+}
+
+// A constant input is too predictable for a stable filter at the highest
+// order, so Levinson-Durbin clamps reflection coefficients on every frame.
+// The clamp path once logged to std::cout; whatever it does must stay
+// real-time safe, and the counter shows the path was taken.
+bool testReflectionClamps() {
+    Harness harness;
+    LPCParameters params = defaultParameters(0);
+    params.lpcOrder = MAX_ORDER;
+    for (int ch = 0; ch < numChannels; ch++) {
+        std::fill(harness.input[ch].begin(), harness.input[ch].end(), 0.5f);
+    }
+    harness.prepare(params);
+    processAll(harness, params);
+    DSPDiagnostics::Snapshot counts;
+    harness.engine.lpc.diagnostics.read(counts);
+    if (counts[DSPDiagnostics::reflectionClamps] == 0) {
+        std::fprintf(stderr, "no reflection coefficients clamped\n");
+        return false;
+    }
+    return true;
+}
+
+// processChannels over the bounce pool. A bounce renders with the host's
+// non-realtime flag set, and waking the workers takes their locks by
+// design, so only allocation is checked.
+bool testBouncing() {
+    Harness harness;
+    WorkerPool pool;
+    pool.start(3);
+    harness.engine.prepareThreads(pool.getNumThreads());
+    LPCParameters params = defaultParameters(0);
+    params.lpcOrder = MAX_ORDER;
+    harness.prepare(params);
+    for (int block = 0; harness.hasInput(1024); block++) {
+        params.exType = block % 12;
+        const int offset = static_cast<int>(harness.position);
+        const float* inputs[numChannels] = { harness.input[0].data() + offset, harness.input[1].data() + offset };
+        float* outputs[numChannels] = { harness.output[0].data(), harness.output[1].data() };
+        const float* sidechains[numChannels] = {};
+        {
+            RTCheck::ScopedRealtime realtime(RTCheck::allocation);
+            ScopedFlushDenormals noDenormals;
+            harness.engine.beginBlock(params, harness.excitation(params.exType));
+            harness.engine.processChannels(inputs, outputs, sidechains, numChannels, 1024, pool);
+            harness.engine.endBlock();
+        }
+        harness.position += 1024;
+    }
+    pool.stop();
+    return true;
+}
+
+// The C interface, whose header promises that processing, the parameter
+// setters and the note functions never allocate, lock or block
+bool testCApi() {
+    Harness harness;
+    lpmorph_engine* engine = lpmorph_create(numChannels);
+    if (engine == nullptr || lpmorph_prepare(engine, sampleRate) != LPMORPH_OK) {
+        std::fprintf(stderr, "cannot create the engine\n");
+        lpmorph_destroy(engine);
+        return false;
+    }
+    vector<float> table(harness.customTable.begin(), harness.customTable.end());
+    lpmorph_set_excitation_table(engine, table.data(), table.size());
+    // The loop is rebuilt from another thread, as the header allows
+    std::atomic<bool> running{true};
+    std::thread loopThread([&] {
+        for (int i = 0; running; i++) {
+            lpmorph_set_excitation_loop(engine, 0.1f*(i % 10), 0.05f + 0.1f*(i % 7));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+    const lpmorph_excitation excitations[] = { LPMORPH_EXCITATION_OFF, LPMORPH_EXCITATION_NOISE, LPMORPH_EXCITATION_PULSE_TRAIN,
+                                               LPMORPH_EXCITATION_GLOTTAL_PULSE, LPMORPH_EXCITATION_MIDI, LPMORPH_EXCITATION_TABLE };
+    for (int block = 0; harness.hasInput(512); block++) {
+        const int offset = static_cast<int>(harness.position);
+        const float* inputs[numChannels] = { harness.input[0].data() + offset, harness.input[1].data() + offset };
+        float* outputs[numChannels] = { harness.output[0].data(), harness.output[1].data() };
+        const float* sidechains[numChannels] = { harness.sidechain[0].data() + offset, harness.sidechain[1].data() + offset };
+        {
+            RTCheck::ScopedRealtime realtime;
+            lpmorph_set_excitation(engine, excitations[(block/8) % 6]);
+            lpmorph_set_order(engine, 1 + (block*13) % LPMORPH_MAX_ORDER);
+            lpmorph_set_frame_duration(engine, 1.f + (block*7) % 49);
+            lpmorph_set_mix(engine, (block % 4)/3.f);
+            lpmorph_set_wet_gain(engine, -6.f*(block % 3));
+            lpmorph_note_on(engine, 48 + block % 24, 0.7f);
+            if (block % 5 == 4) {
+                lpmorph_note_off(engine, 48 + (block - 4) % 24);
+            }
+            if (block % 50 == 49) {
+                lpmorph_all_notes_off(engine);
+            }
+            lpmorph_process(engine, inputs, outputs, block % 9 == 0 ? sidechains : nullptr, 256);
+            lpmorph_process_strided(engine, inputs, outputs, nullptr, 128, 2, 2);
+        }
+        harness.position += 512;
+    }
+    running = false;
+    loopThread.join();
+    lpmorph_destroy(engine);
+
+    // Every entry point accepts a null engine
+    lpmorph_set_wet_gain(nullptr, 0.f);
+    lpmorph_set_mix(nullptr, 1.f);
+    lpmorph_set_order(nullptr, 10);
+    lpmorph_set_frame_duration(nullptr, 10.f);
+    lpmorph_set_excitation(nullptr, LPMORPH_EXCITATION_NOISE);
+    lpmorph_set_excitation_loop(nullptr, 0.f, 1.f);
+    lpmorph_note_on(nullptr, 60, 1.f);
+    lpmorph_note_off(nullptr, 60);
+    lpmorph_all_notes_off(nullptr);
+    lpmorph_destroy(nullptr);
+    return lpmorph_prepare(nullptr, sampleRate) == LPMORPH_ERROR_INVALID_ARGUMENT
+        && lpmorph_set_excitation_table(nullptr, nullptr, 0) == LPMORPH_ERROR_INVALID_ARGUMENT
+        && lpmorph_process(nullptr, nullptr, nullptr, nullptr, 0) == LPMORPH_ERROR_INVALID_ARGUMENT
+        && lpmorph_get_latency(nullptr) == 0 && lpmorph_get_hop_size(nullptr) == 0;
+}
+
+// Recording a session capture alongside processing, as the plugin does with
+// LPMORPH_CAPTURE_DIR set; the recorder's writer thread is not checked
+bool testCapture() {
+    Harness harness;
+    const LPCParameters params = defaultParameters(numFactoryTables + 4);
+    harness.prepare(params);
+    char path[] = "/tmp/lpmorph-rtcheck-XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        std::fprintf(stderr, "cannot create a temporary file\n");
+        return false;
+    }
+    close(fd);
+    SessionRecorder recorder;
+    if (!recorder.start(path, sampleRate, numChannels, maxBlockSize, params)) {
+        std::fprintf(stderr, "cannot record to %s\n", path);
+        std::remove(path);
+        return false;
+    }
+    const uint8_t noteOn[3] = { 0x90, 60, 100 };
+    const uint8_t noteOff[3] = { 0x80, 60, 0 };
+    for (int block = 0; harness.hasInput(512); block++) {
+        const int offset = static_cast<int>(harness.position);
+        const float* inputs[numChannels] = { harness.input[0].data() + offset, harness.input[1].data() + offset };
+        const float* outputs[numChannels] = { harness.output[0].data(), harness.output[1].data() };
+        {
+            RTCheck::ScopedRealtime realtime;
+            SessionBlock info;
+            info.numSamples = 512;
+            info.numChannels = numChannels;
+            info.parameters = params;
+            recorder.beginBlock(info, inputs, nullptr);
+            recorder.addMidi(block % 512, block % 2 == 0 ? noteOn : noteOff, 3);
+        }
+        harness.process(params, 512);
+        {
+            RTCheck::ScopedRealtime realtime;
+            recorder.endBlock(outputs, 0);
+        }
+    }
+    recorder.stop();
+    std::remove(path);
+    return true;
+}
+
+// The diagnostics counters, counted by the audio thread as it processes.
+// Each section of the input trips some of them: a constant, too predictable
+// for a stable filter at the highest order, which also clips; silence; and
+// a NaN in the middle of speech. The table excitation loops throughout.
+bool testDiagnostics() {
+    Harness harness;
+    LPCParameters params = defaultParameters(0);
+    params.lpcOrder = MAX_ORDER;
+    const size_t second = static_cast<size_t>(sampleRate);
+    for (int ch = 0; ch < numChannels; ch++) {
+        std::fill(harness.input[ch].begin(), harness.input[ch].begin() + second, 0.5f);
+        std::fill(harness.input[ch].begin() + second, harness.input[ch].begin() + 2*second, 0.f);
+        harness.input[ch][2*second + second/2] = std::nanf("");
+    }
+    harness.prepare(params);
+    processAll(harness, params);
+    DSPDiagnostics::Snapshot counts;
+    harness.engine.lpc.diagnostics.read(counts);
+    bool passed = true;
+    for (int c = 0; c < DSPDiagnostics::numCounters; c++) {
+        const auto counter = static_cast<DSPDiagnostics::Counter>(c);
+        if (counts[counter] == 0) {
+            std::fprintf(stderr, "no %s counted\n", DSPDiagnostics::label(counter));
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// Tracing spans into the ring from the audio thread, then from the bounce
+// workers at once, with the trace's writer thread draining it unchecked
+bool testTrace() {
+    Harness harness;
+    LPCParameters params = defaultParameters(0);
+    harness.prepare(params);
+    char path[] = "/tmp/lpmorph-rtcheck-XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        std::fprintf(stderr, "cannot create a temporary file\n");
+        return false;
+    }
+    close(fd);
+    DSPTrace trace;
+    if (!trace.start(path)) {
+        std::fprintf(stderr, "cannot trace to %s\n", path);
+        std::remove(path);
+        return false;
+    }
+    harness.engine.lpc.trace = &trace;
+    const size_t half = harness.input[0].size()/2;
+    while (harness.position + 512 <= half) {
+        harness.process(params, 512);
+    }
+    WorkerPool pool;
+    pool.start(3);
+    harness.engine.prepareThreads(pool.getNumThreads());
+    while (harness.hasInput(1024)) {
+        const int offset = static_cast<int>(harness.position);
+        const float* inputs[numChannels] = { harness.input[0].data() + offset, harness.input[1].data() + offset };
+        float* outputs[numChannels] = { harness.output[0].data(), harness.output[1].data() };
+        const float* sidechains[numChannels] = {};
+        {
+            RTCheck::ScopedRealtime realtime(RTCheck::allocation);
+            DSPTrace::Span span(&trace, DSPTrace::processBlock, -1, 1024);
+            harness.engine.beginBlock(params, harness.excitation(params.exType));
+            harness.engine.processChannels(inputs, outputs, sidechains, numChannels, 1024, pool);
+            harness.engine.endBlock();
+        }
+        harness.position += 1024;
+    }
+    pool.stop();
+    harness.engine.lpc.trace = nullptr;
+    trace.stop();
+
+    std::string contents;
+    if (FILE* file = std::fopen(path, "r")) {
+        char chunk[4096];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            contents.append(chunk, n);
+        }
+        std::fclose(file);
+    }
+    std::remove(path);
+    bool passed = trace.getDroppedSpans() == 0;
+    for (const char* expected : { "\"processBlock\"", "\"applyLPC\"", "\"analysis\"", "\"synthesis\"", "LP Morph audio", "LP Morph worker" }) {
+        if (contents.find(expected) == std::string::npos) {
+            std::fprintf(stderr, "no %s in the trace\n", expected);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// Publishing the engine's metrics to shared memory from the audio thread,
+// then reading them back as lpmorph-metrics does. The input's silent
+// sections count frames without energy.
+bool testMetrics() {
+    Harness harness;
+    LPCParameters params = defaultParameters(0);
+    harness.prepare(params);
+    MetricsPublisher publisher;
+    if (!publisher.start("rtcheck")) {
+        std::fprintf(stderr, "cannot publish metrics\n");
+        return false;
+    }
+    harness.engine.metrics = &publisher;
+    processAll(harness, params);
+    harness.engine.metrics = nullptr;
+
+    MetricsReader reader;
+    std::string error;
+    SharedMetrics metrics;
+    if (!reader.open(publisher.getName(), error) || !reader.read(metrics)) {
+        std::fprintf(stderr, "cannot read %s: %s\n", publisher.getName().c_str(), error.c_str());
+        return false;
+    }
+    bool passed = true;
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "metrics: %s\n", what);
+            passed = false;
+        }
+    };
+    expect(metrics.version == SharedMetrics::currentVersion, "wrong version");
+    expect(std::strcmp(metrics.label, "rtcheck") == 0, "wrong label");
+    expect(MetricsReader::isPublisherAlive(metrics), "publisher not alive");
+    expect(metrics.sampleRate == sampleRate, "wrong sample rate");
+    expect(metrics.blocks > 0 && metrics.processingNs > 0 && metrics.audioNs > 0, "no blocks");
+    expect(metrics.stageNs[StageTiming::analysis] > 0 && metrics.stageMaxNs[StageTiming::analysis] > 0, "no analysis time");
+    expect(metrics.loadMax >= metrics.loadP50, "load percentiles out of order");
+    expect(metrics.diagnostics[DSPDiagnostics::zeroEnergyFrames] > 0, "no frames without energy");
+    expect(metrics.updatedNs > 0, "no update time");
+
+    const std::string name = publisher.getName();
+    reader.close();
+    publisher.stop();
+    expect(!reader.open(name, error), "segment left behind");
+    return passed;
+}
+
+struct TestCase {
+    const char* name;
+    bool (*run)();
+};
+
+const TestCase testCases[] = {
+    { "checker", testChecker },
+    { "tables", testTables },
+    { "generators", testGenerators },
+    { "midi", testMidi },
+    { "sidechain", testSidechain },
+    { "custom-excitation", testCustomExcitation },
+    { "strided", testStrided },
+    { "block-sizes", testBlockSizes },
+    { "hop-blocks", testHopBlocks },
+    { "transitions", testTransitions },
+    { "reflection-clamps", testReflectionClamps },
+    { "bouncing", testBouncing },
+    { "c-api", testCApi },
+    { "capture", testCapture },
+    { "diagnostics", testDiagnostics },
+    { "trace", testTrace },
+    { "metrics", testMetrics },
+};
+
+bool runCase(const TestCase& testCase) {
+    RTCheck::reset();
+    const bool passed = testCase.run();
+    const size_t violations = RTCheck::violationCount();
+    if (violations > 0) {
+        RTCheck::report(stderr);
+    }
+    const bool ok = passed && violations == 0;
+    std::printf("%-20s %s\n", testCase.name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 2 && std::strcmp(argv[1], "--list") == 0) {
+        for (const auto& testCase : testCases) {
+            std::printf("%s\n", testCase.name);
+        }
+        return 0;
+    }
+    int failures = 0;
+    if (argc == 1) {
+        for (const auto& testCase : testCases) {
+            failures += runCase(testCase) ? 0 : 1;
+        }
+    }
+    for (int i = 1; i < argc; i++) {
+        const TestCase* found = nullptr;
+        for (const auto& testCase : testCases) {
+            if (std::strcmp(testCase.name, argv[i]) == 0) {
+                found = &testCase;
+            }
+        }
+        if (found == nullptr) {
+            std::fprintf(stderr, "unknown case %s; --list lists them\n", argv[i]);
+            return 1;
+        }
+        failures += runCase(*found) ? 0 : 1;
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,440 @@
+// The fortified inline wrappers glibc defines for some of these functions
+// would clash with the definitions below
+#undef _FORTIFY_SOURCE
+
+#include "rt_check.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#if !defined(__GLIBC__)
+#error "rt_check.cpp interposes glibc and builds only against it"
+#endif
+
+// glibc's own allocator entry points, which the interposed allocator
+// forwards to without going through dlsym
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+namespace {
+
+constexpr int maxFrames = 32;
+constexpr int maxRecorded = 256;
+// check() and the interposed function
+constexpr int skippedFrames = 2;
+
+struct Violation {
+    unsigned check;
+    const char* function;
+    int numFrames;
+    void* frames[maxFrames];
+};
+
+// Violations are recorded into a fixed table, since recording must not
+// itself allocate; past its end they are only counted
+Violation recorded[maxRecorded];
+std::atomic<int> numRecorded{0};
+std::atomic<size_t> numViolations{0};
+
+thread_local unsigned activeChecks = 0;
+// Set while the checker itself runs on this thread
+thread_local bool insideChecker = false;
+
+__attribute__((noinline)) void check(unsigned kind, const char* function) noexcept {
+    if ((activeChecks & kind) == 0 || insideChecker) {
+        return;
+    }
+    insideChecker = true;
+    numViolations.fetch_add(1, std::memory_order_relaxed);
+    const int slot = numRecorded.fetch_add(1, std::memory_order_relaxed);
+    if (slot < maxRecorded) {
+        Violation& violation = recorded[slot];
+        violation.check = kind;
+        violation.function = function;
+        violation.numFrames = backtrace(violation.frames, maxFrames);
+    }
+    insideChecker = false;
+}
+
+// The next definition of a function, normally glibc's, resolved on first
+// use. What dlsym allocates is not held against the caller, and concurrent
+// resolutions store the same pointer.
+void* next(std::atomic<void*>& cache, const char* name) noexcept {
+    void* function = cache.load(std::memory_order_relaxed);
+    if (function == nullptr) {
+        const bool wasInside = insideChecker;
+        insideChecker = true;
+        function = dlsym(RTLD_NEXT, name);
+        insideChecker = wasInside;
+        cache.store(function, std::memory_order_relaxed);
+    }
+    return function;
+}
+
+#define RTCHECK_NEXT(name) \
+    static std::atomic<void*> name##Next{nullptr}; \
+    const auto real = reinterpret_cast<decltype(&::name)>(next(name##Next, #name))
+
+const char* describe(unsigned check) {
+    switch (check) {
+        case RTCheck::allocation: return "allocation";
+        case RTCheck::lock: return "lock";
+        default: return "blocking call";
+    }
+}
+
+bool sameViolation(const Violation& a, const Violation& b) {
+    return a.check == b.check && a.function == b.function && a.numFrames == b.numFrames
+        && std::memcmp(a.frames, b.frames, sizeof(void*)*a.numFrames) == 0;
+}
+
+// "binary(mangled+0x1f) [0x...]" with the name demangled
+void printFrame(FILE* out, int index, const char* symbol) {
+    const char* open = std::strchr(symbol, '(');
+    const char* plus = open != nullptr ? std::strchr(open, '+') : nullptr;
+    if (open != nullptr && plus != nullptr && plus > open + 1) {
+        char mangled[512];
+        const size_t length = std::min(sizeof(mangled) - 1, static_cast<size_t>(plus - open - 1));
+        std::memcpy(mangled, open + 1, length);
+        mangled[length] = 0;
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+        if (status == 0 && demangled != nullptr) {
+            std::fprintf(out, "    #%-2d %s\n", index, demangled);
+            std::free(demangled);
+            return;
+        }
+        std::free(demangled);
+    }
+    std::fprintf(out, "    #%-2d %s\n", index, symbol);
+}
+
+__attribute__((constructor)) void initialise() {
+    // The first backtrace loads the unwinder, which allocates; do it before
+    // anything is checked
+    void* frames[2];
+    backtrace(frames, 2);
+}
+
+}
+
+namespace RTCheck {
+
+ScopedRealtime::ScopedRealtime(unsigned checks) noexcept : previous(activeChecks) {
+    activeChecks = checks;
+}
+
+ScopedRealtime::~ScopedRealtime() {
+    activeChecks = previous;
+}
+
+size_t violationCount() noexcept {
+    return numViolations.load();
+}
+
+void reset() noexcept {
+    numViolations = 0;
+    numRecorded = 0;
+}
+
+void report(FILE* out) {
+    const bool wasInside = insideChecker;
+    insideChecker = true;
+    const int count = std::min(numRecorded.load(), maxRecorded);
+    bool reported[maxRecorded] = {};
+    int numDistinct = 0;
+    for (int i = 0; i < count; i++) {
+        numDistinct += reported[i] ? 0 : 1;
+        for (int j = i + 1; j < count && !reported[i]; j++) {
+            reported[j] = reported[j] || sameViolation(recorded[i], recorded[j]);
+        }
+    }
+    std::fprintf(out, "rtcheck: %zu violations, %d distinct\n", violationCount(), numDistinct);
+    std::fill(reported, reported + maxRecorded, false);
+    for (int i = 0; i < count; i++) {
+        if (reported[i]) {
+            continue;
+        }
+        int times = 1;
+        for (int j = i + 1; j < count; j++) {
+            if (!reported[j] && sameViolation(recorded[i], recorded[j])) {
+                reported[j] = true;
+                times++;
+            }
+        }
+        const Violation& violation = recorded[i];
+        std::fprintf(out, "%s: %s, %d time%s\n", describe(violation.check), violation.function, times, times == 1 ? "" : "s");
+        const int numFrames = violation.numFrames - skippedFrames;
+        if (numFrames > 0) {
+            char** symbols = backtrace_symbols(violation.frames + skippedFrames, numFrames);
+            for (int f = 0; f < numFrames; f++) {
+                printFrame(out, f, symbols != nullptr ? symbols[f] : "?");
+            }
+            std::free(symbols);
+        }
+    }
+    if (numViolations.load() > static_cast<size_t>(count)) {
+        std::fprintf(out, "only the first %d violations were recorded\n", maxRecorded);
+    }
+    if (count > 0) {
+        // The engine is built with hidden visibility, which backtrace_symbols
+        // cannot name
+        std::fprintf(out, "frames shown as binary(+offset): addr2line -Cfe binary offset names them\n");
+    }
+    insideChecker = wasInside;
+}
+
+}
+
+// The interposed functions: each checks, then forwards
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+    check(RTCheck::allocation, "malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+    check(RTCheck::allocation, "calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept {
+    check(RTCheck::allocation, "realloc");
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) noexcept {
+    if (pointer != nullptr) {
+        check(RTCheck::allocation, "free");
+    }
+    __libc_free(pointer);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+    check(RTCheck::allocation, "memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    check(RTCheck::allocation, "aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept {
+    check(RTCheck::allocation, "posix_memalign");
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void* allocated = __libc_memalign(alignment, size);
+    if (allocated == nullptr) {
+        return ENOMEM;
+    }
+    *pointer = allocated;
+    return 0;
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept {
+    check(RTCheck::lock, "pthread_mutex_lock");
+    RTCHECK_NEXT(pthread_mutex_lock);
+    return real(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* rwlock) noexcept {
+    check(RTCheck::lock, "pthread_rwlock_rdlock");
+    RTCHECK_NEXT(pthread_rwlock_rdlock);
+    return real(rwlock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* rwlock) noexcept {
+    check(RTCheck::lock, "pthread_rwlock_wrlock");
+    RTCHECK_NEXT(pthread_rwlock_wrlock);
+    return real(rwlock);
+}
+
+int pthread_join(pthread_t thread, void** result) {
+    check(RTCheck::lock, "pthread_join");
+    RTCHECK_NEXT(pthread_join);
+    return real(thread, result);
+}
+
+int sem_wait(sem_t* semaphore) {
+    check(RTCheck::lock, "sem_wait");
+    RTCHECK_NEXT(sem_wait);
+    return real(semaphore);
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining) {
+    check(RTCheck::blockingCall, "nanosleep");
+    RTCHECK_NEXT(nanosleep);
+    return real(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* time, struct timespec* remaining) {
+    check(RTCheck::blockingCall, "clock_nanosleep");
+    RTCHECK_NEXT(clock_nanosleep);
+    return real(clock, flags, time, remaining);
+}
+
+int usleep(useconds_t microseconds) {
+    check(RTCheck::blockingCall, "usleep");
+    RTCHECK_NEXT(usleep);
+    return real(microseconds);
+}
+
+unsigned int sleep(unsigned int seconds) {
+    check(RTCheck::blockingCall, "sleep");
+    RTCHECK_NEXT(sleep);
+    return real(seconds);
+}
+
+int sched_yield() noexcept {
+    check(RTCheck::blockingCall, "sched_yield");
+    RTCHECK_NEXT(sched_yield);
+    return real();
+}
+
+// A system call that walks every thread of the process under a kernel lock
+int getrusage(__rusage_who_t who, struct rusage* usage) noexcept {
+    check(RTCheck::blockingCall, "getrusage");
+    RTCHECK_NEXT(getrusage);
+    return real(who, usage);
+}
+
+ssize_t read(int fd, void* buffer, size_t size) {
+    check(RTCheck::blockingCall, "read");
+    RTCHECK_NEXT(read);
+    return real(fd, buffer, size);
+}
+
+ssize_t write(int fd, const void* buffer, size_t size) {
+    check(RTCheck::blockingCall, "write");
+    RTCHECK_NEXT(write);
+    return real(fd, buffer, size);
+}
+
+int open(const char* path, int flags, ...) {
+    check(RTCheck::blockingCall, "open");
+    mode_t mode = 0;
+    if ((flags & O_CREAT) != 0 || (flags & O_TMPFILE) == O_TMPFILE) {
+        va_list arguments;
+        va_start(arguments, flags);
+        mode = static_cast<mode_t>(va_arg(arguments, int));
+        va_end(arguments);
+    }
+    RTCHECK_NEXT(open);
+    return real(path, flags, mode);
+}
+
+int close(int fd) {
+    check(RTCheck::blockingCall, "close");
+    RTCHECK_NEXT(close);
+    return real(fd);
+}
+
+int fsync(int fd) {
+    check(RTCheck::blockingCall, "fsync");
+    RTCHECK_NEXT(fsync);
+    return real(fd);
+}
+
+FILE* fopen(const char* path, const char* mode) {
+    check(RTCheck::blockingCall, "fopen");
+    RTCHECK_NEXT(fopen);
+    return real(path, mode);
+}
+
+int fflush(FILE* stream) {
+    check(RTCheck::blockingCall, "fflush");
+    RTCHECK_NEXT(fflush);
+    return real(stream);
+}
+
+// std::cout and std::cerr write through these
+size_t fwrite(const void* data, size_t size, size_t count, FILE* stream) {
+    check(RTCheck::blockingCall, "fwrite");
+    RTCHECK_NEXT(fwrite);
+    return real(data, size, count, stream);
+}
+
+int fputs(const char* text, FILE* stream) {
+    check(RTCheck::blockingCall, "fputs");
+    RTCHECK_NEXT(fputs);
+    return real(text, stream);
+}
+
+int puts(const char* text) {
+    check(RTCheck::blockingCall, "puts");
+    RTCHECK_NEXT(puts);
+    return real(text);
+}
+
+int fputc(int c, FILE* stream) {
+    check(RTCheck::blockingCall, "fputc");
+    RTCHECK_NEXT(fputc);
+    return real(c, stream);
+}
+
+int putc(int c, FILE* stream) {
+    check(RTCheck::blockingCall, "putc");
+    RTCHECK_NEXT(putc);
+    return real(c, stream);
+}
+
+int printf(const char* format, ...) {
+    check(RTCheck::blockingCall, "printf");
+    va_list arguments;
+    va_start(arguments, format);
+    const int result = vprintf(format, arguments);
+    va_end(arguments);
+    return result;
+}
+
+int fprintf(FILE* stream, const char* format, ...) {
+    check(RTCheck::blockingCall, "fprintf");
+    va_list arguments;
+    va_start(arguments, format);
+    const int result = vfprintf(stream, format, arguments);
+    va_end(arguments);
+    return result;
+}
+
+// What printf and fprintf compile to with _FORTIFY_SOURCE
+int __printf_chk(int, const char* format, ...) {
+    check(RTCheck::blockingCall, "printf");
+    va_list arguments;
+    va_start(arguments, format);
+    const int result = vprintf(format, arguments);
+    va_end(arguments);
+    return result;
+}
+
+int __fprintf_chk(FILE* stream, int, const char* format, ...) {
+    check(RTCheck::blockingCall, "fprintf");
+    va_list arguments;
+    va_start(arguments, format);
+    const int result = vfprintf(stream, format, arguments);
+    va_end(arguments);
+    return result;
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+
+// Real-time safety checking for test builds. Linking rt_check.cpp into an
+// executable interposes the C allocator, the blocking pthread calls and the
+// blocking or I/O system calls for the whole program (glibc only). While a
+// thread is inside a ScopedRealtime, every such call it makes is recorded
+// as a violation with the stack it was made from; other threads, and the
+// same thread outside the scope, are left alone.
+//
+// operator new and delete, std::mutex, std::cout and sleep_for all end up
+// in the interposed functions, so C++ code is covered without replacing
+// anything else. What cannot be seen are calls glibc makes to itself, such
+// as printf writing out its buffer, though the printf call itself is seen.
+namespace RTCheck {
+
+enum Checks : unsigned {
+    // malloc, calloc, realloc, the aligned allocators and free
+    allocation = 1,
+    // pthread mutex and rwlock locks, joins and semaphore waits
+    lock = 2,
+    // sleeping, yielding, getrusage, file I/O and stdio output
+    blockingCall = 4,
+    all = allocation | lock | blockingCall
+};
+
+// Marks the calling thread as real-time for its lifetime. Scopes nest; the
+// innermost one's checks apply.
+class ScopedRealtime {
+public:
+    explicit ScopedRealtime(unsigned checks = all) noexcept;
+    ~ScopedRealtime();
+    ScopedRealtime(const ScopedRealtime&) = delete;
+    ScopedRealtime& operator=(const ScopedRealtime&) = delete;
+
+private:
+    unsigned previous;
+};
+
+// Violations recorded since the last reset, from any thread
+size_t violationCount() noexcept;
+void reset() noexcept;
+
+// Writes every distinct violation, with how often it happened and the
+// symbolised stack it happened on. Not real-time safe.
+void report(FILE* out);
+
+}
@@ -111,6 +111,11 @@ void AudioLogger::logOutputBuffer(const float* outputBuffer, int bufferSize) noe
         currentEntry->outputBuffer[i] = outputBuffer[i];
     }
     
+    if (auto* source = diagnostics.load())
+        source->read(currentEntry->diagnostics);
+    else
+        currentEntry->diagnostics = {};
+    
     // Mark entry as complete and finalize
     finalizeLogEntry();
 }
@@ -143,6 +148,9 @@ void AudioLogger::writeLogToFile(const std::string& filePath)
     
     // Write CSV header
     file << "timestamp,bufferSize,alphas_count,";
+    for (int c = 0; c < DSPDiagnostics::numCounters; ++c) {
+        file << DSPDiagnostics::key(static_cast<DSPDiagnostics::Counter>(c)) << ",";
+    }
     
 //    // Input buffer columns
 //    for (int i = 0; i < MAX_BUFFER_SIZE; ++i) {
@@ -173,6 +181,9 @@ void AudioLogger::writeLogToFile(const std::string& filePath)
             file << entry.timestamp << "," 
                  << entry.inputBufferSize << ","
                  << entry.alphasCount << ",";
+            for (int c = 0; c < DSPDiagnostics::numCounters; ++c) {
+                file << entry.diagnostics.counts[c] << ",";
+            }
             
 //            // Write input buffer
 //            for (int i = 0; i < MAX_BUFFER_SIZE; ++i) {
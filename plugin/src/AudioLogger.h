@@ -3,6 +3,7 @@
 #include <JuceHeader.h>
 #include <atomic>
 #include <array>
+#include "dsp_diagnostics.h"
 
 class AudioLogger {
 public:
@@ -15,6 +16,8 @@ public:
     void logOutputBuffer(const float* outputBuffer, int bufferSize) noexcept;
     
     void enableLogging(bool enable) noexcept;
+    // Counters logged with every entry, as totals at the time of its output
+    void setDiagnostics(const DSPDiagnostics* source) noexcept { diagnostics.store(source); }
     bool isLoggingEnabled() const noexcept { return loggingEnabled.load(); }
     
     // Background thread operations
@@ -37,6 +40,7 @@ private:
         std::array<double, MAX_LPC_ORDER> alphas;
         int inputBufferSize;
         int alphasCount;
+        DSPDiagnostics::Snapshot diagnostics;
         juce::uint64 timestamp;
         bool isComplete;
     };
@@ -48,6 +52,7 @@ private:
     std::atomic<int> fifoReadIndex{0};
     std::atomic<bool> loggingEnabled{false};
     std::atomic<bool> logReady{false};
+    std::atomic<const DSPDiagnostics*> diagnostics{nullptr};
     
     // Current log entry being built
     LogEntry* currentEntry{nullptr};
@@ -0,0 +1,77 @@
+#include "ExcitationCache.h"
+#include "ExcitationLoader.h"
+
+// Function to load a WAV file into a vector<double>
+static std::vector<double> loadEmbeddedWavToBuffer(const void* data, size_t dataSize)
+{
+    if (data != nullptr && dataSize > 0) {
+        size_t numSamples = dataSize / 2;
+        const int16_t* sampleData = static_cast<const int16_t*>(data);
+        std::vector<double> samples;
+        samples.reserve(numSamples);
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            samples.push_back(static_cast<double>(sampleData[i]) / 32768.0);
+        }
+        return samples;
+    }
+    return {};
+}
+
+ExcitationCache::ExcitationCache()
+{
+    loadNativeTables();
+    native.ready.store(true);
+}
+
+ExcitationCache::~ExcitationCache()
+{
+    pool.removeAllJobs(true, 5000);
+}
+
+void ExcitationCache::loadNativeTables()
+{
+    native.tables.push_back(loadEmbeddedWavToBuffer(BinaryData::BassyTrainNoise_wav_bin, BinaryData::BassyTrainNoise_wav_binSize));
+    native.tables.push_back(loadEmbeddedWavToBuffer(BinaryData::CherubScreams_wav_bin, BinaryData::CherubScreams_wav_binSize));
+    native.tables.push_back(loadEmbeddedWavToBuffer(BinaryData::MicScratch_wav_bin, BinaryData::MicScratch_wav_binSize));
+    native.tables.push_back(loadEmbeddedWavToBuffer(BinaryData::Ring_wav_bin, BinaryData::Ring_wav_binSize));
+    native.tables.push_back(loadEmbeddedWavToBuffer(BinaryData::TrainScreech1_wav_bin, BinaryData::TrainScreech1_wav_binSize));
+    native.tables.push_back(loadEmbeddedWavToBuffer(BinaryData::TrainScreech2_wav_bin, BinaryData::TrainScreech2_wav_binSize));
+    native.tables.push_back(loadEmbeddedWavToBuffer(BinaryData::WhiteNoise_wav_bin, BinaryData::WhiteNoise_wav_binSize));
+}
+
+const ExcitationTables* ExcitationCache::request(double sampleRate)
+{
+    int key = juce::roundToInt(sampleRate);
+    if (key <= 0 || key == juce::roundToInt(nativeSampleRate)) {
+        return &native;
+    }
+
+    const juce::ScopedLock sl(lock);
+    auto it = resampled.find(key);
+    if (it != resampled.end()) {
+        return it->second.get();
+    }
+
+    auto* entry = (resampled[key] = std::make_unique<ExcitationTables>()).get();
+    double speedRatio = nativeSampleRate/sampleRate;
+    pool.addJob([this, entry, speedRatio] {
+        vector<vector<double>> tables;
+        for (auto& table : native.tables) {
+            vector<float> in(table.begin(), table.end());
+            auto out = ExcitationLoader::resample(in.data(), static_cast<int>(in.size()), speedRatio);
+            tables.emplace_back(out.begin(), out.end());
+        }
+        entry->tables = std::move(tables);
+        entry->ready.store(true, std::memory_order_release);
+    });
+    return entry;
+}
+
+const vector<vector<double>>& ExcitationCache::getTables(const ExcitationTables* entry) const noexcept
+{
+    if (entry != nullptr && entry->ready.load(std::memory_order_acquire)) {
+        return entry->tables;
+    }
+    return native.tables;
+}
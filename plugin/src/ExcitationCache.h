@@ -0,0 +1,47 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <map>
+#include <vector>
+
+using namespace juce;
+using namespace std;
+
+struct ExcitationTables {
+    vector<vector<double>> tables;
+    std::atomic<bool> ready{false};
+};
+
+// Factory excitations shared by every plugin instance in the process. The
+// embedded 44.1 kHz recordings are decoded once, and a copy resampled to each
+// host rate is built on a background thread the first time that rate is
+// requested. Built tables live as long as the cache, so the audio thread can
+// hold on to them without any reference counting.
+class ExcitationCache
+{
+public:
+    static constexpr double nativeSampleRate = 44100.0;
+
+    ExcitationCache();
+    ~ExcitationCache();
+
+    const vector<vector<double>>& getNativeTables() const { return native.tables; }
+
+    // Not real-time safe: call from prepareToPlay or the message thread
+    const ExcitationTables* request(double sampleRate);
+
+    // Real-time safe: the tables for the requested rate once they are ready,
+    // the native tables until then.
+    const vector<vector<double>>& getTables(const ExcitationTables* entry) const noexcept;
+
+private:
+    void loadNativeTables();
+
+    ExcitationTables native;
+    std::map<int, unique_ptr<ExcitationTables>> resampled;
+    juce::CriticalSection lock;
+    juce::ThreadPool pool { 1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ExcitationCache)
+};
@@ -0,0 +1,229 @@
+#include "ExcitationLoader.h"
+
+class ExcitationLoader::DecodeJob : public juce::ThreadPoolJob
+{
+public:
+    DecodeJob(juce::AudioFormatManager& formats, shared_ptr<ExcitationSet> owner, int index)
+        : juce::ThreadPoolJob("Decode " + owner->slots[index].file.getFileName()), formatManager(formats), set(std::move(owner)), slot(set->slots[index])
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        if (set->stale.load()) {
+            return jobHasFinished;
+        }
+        auto samples = ExcitationLoader::decodeFile(formatManager, slot.file, set->sampleRate, &set->stale);
+        if (set->stale.load()) {
+            return jobHasFinished;
+        }
+        slot.samples = std::move(samples);
+        slot.ready.store(true, std::memory_order_release);
+        set->numCompleted.fetch_add(1);
+        return jobHasFinished;
+    }
+
+private:
+    juce::AudioFormatManager& formatManager;
+    shared_ptr<ExcitationSet> set;
+    ExcitationSlot& slot;
+};
+
+ExcitationLoader::ExcitationLoader() : pool(juce::jmax(1, juce::SystemStats::getNumCpus() - 1))
+{
+    formatManager.registerBasicFormats();
+    // Releases retired sets and follows changes of the host rate
+    startTimer(500);
+}
+
+ExcitationLoader::~ExcitationLoader()
+{
+    stopTimer();
+    for (auto& set : ownedSets) {
+        set->stale.store(true);
+    }
+    // Every job stops within a chunk once its set is stale, and they all use
+    // formatManager, so wait for them however long that takes
+    pool.removeAllJobs(true, -1);
+}
+
+vector<float> ExcitationLoader::resample(const float* input, int numSamples, double speedRatio)
+{
+    int numOut = juce::jmax(1, static_cast<int>(numSamples/speedRatio));
+    vector<float> output(numOut);
+    juce::LagrangeInterpolator interpolator;
+    interpolator.process(speedRatio, input, output.data(), numOut, numSamples, 0);
+    return output;
+}
+
+vector<double> ExcitationLoader::decodeFile(juce::AudioFormatManager& formatManager, const juce::File& file, double targetSampleRate, const std::atomic<bool>* stop)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr || reader->lengthInSamples <= 0) {
+        return {};
+    }
+    const int numSamples = static_cast<int>(reader->lengthInSamples);
+    const int chunkSize = 65536;
+    juce::AudioBuffer<float> buffer(1, numSamples);
+    for (int pos = 0; pos < numSamples; pos += chunkSize) {
+        // Checked between chunks so that cancelling stops a long file early
+        if (stop != nullptr && stop->load()) {
+            return {};
+        }
+        int len = juce::jmin(chunkSize, numSamples - pos);
+        reader->read(&buffer, pos, len, pos, true, false);
+    }
+
+    const float* in = buffer.getReadPointer(0);
+    int numOut = numSamples;
+    vector<float> resampled;
+    if (targetSampleRate > 0.0 && !juce::approximatelyEqual(reader->sampleRate, targetSampleRate)) {
+        resampled = resample(in, numSamples, reader->sampleRate/targetSampleRate);
+        in = resampled.data();
+        numOut = static_cast<int>(resampled.size());
+    }
+
+    float peak = 0.f;
+    for (int i = 0; i < numOut; i++) {
+        peak = juce::jmax(peak, std::abs(in[i]));
+    }
+    double norm = peak > 0.f ? 1.0/peak : 1.0;
+    vector<double> samples(numOut);
+    for (int i = 0; i < numOut; i++) {
+        samples[i] = static_cast<double>(in[i])*norm;
+    }
+    return samples;
+}
+
+void ExcitationLoader::load(const juce::File& folder, double targetSampleRate)
+{
+    cancel();
+
+    juce::Array<juce::File> wavFiles;
+    folder.findChildFiles(wavFiles, juce::File::findFiles, false, "*.wav");
+    wavFiles.sort();
+
+    auto set = std::make_shared<ExcitationSet>(folder, wavFiles.size(), targetSampleRate);
+    for (int i = 0; i < wavFiles.size(); i++) {
+        set->slots[i].file = wavFiles[i];
+    }
+    sampleRate.store(targetSampleRate);
+    currentSet.store(set.get());
+    for (int i = 0; i < wavFiles.size(); i++) {
+        pool.addJob(new DecodeJob(formatManager, set, i), true);
+    }
+    ownedSets.push_back(std::move(set));
+    releaseRetiredSets();
+}
+
+// Never waits: jobs of a stale set finish on their own
+void ExcitationLoader::cancel()
+{
+    if (auto* set = currentSet.load()) {
+        set->stale.store(true);
+    }
+}
+
+void ExcitationLoader::setSampleRate(double rate) noexcept
+{
+    sampleRate.store(rate);
+}
+
+bool ExcitationLoader::isLoading() const
+{
+    auto* set = currentSet.load();
+    return set != nullptr && !set->stale.load() && set->numCompleted.load() < static_cast<int>(set->slots.size());
+}
+
+double ExcitationLoader::getProgress() const
+{
+    auto* set = currentSet.load();
+    return set != nullptr && !set->slots.empty() ? static_cast<double>(set->numCompleted.load())/set->slots.size() : 1.0;
+}
+
+vector<juce::File> ExcitationLoader::getFiles() const
+{
+    vector<juce::File> files;
+    if (auto* set = currentSet.load()) {
+        for (auto& slot : set->slots) {
+            files.push_back(slot.file);
+        }
+    }
+    return files;
+}
+
+bool ExcitationLoader::isReady(int index) const
+{
+    return getExcitation(index) != nullptr;
+}
+
+const vector<double>* ExcitationLoader::getExcitation(int index) const
+{
+    auto* set = currentSet.load();
+    if (set == nullptr || index < 0 || index >= static_cast<int>(set->slots.size())) {
+        return nullptr;
+    }
+    auto& slot = set->slots[index];
+    if (!slot.ready.load(std::memory_order_acquire) || slot.samples.empty()) {
+        return nullptr;
+    }
+    return &slot.samples;
+}
+
+const vector<double>* ExcitationLoader::acquire(int index, Reader reader) noexcept
+{
+    auto& pinned = readerSets[reader];
+    if (index < 0) {
+        pinned.store(nullptr);
+        return nullptr;
+    }
+    // Publish the set we are about to read before re-checking it is still
+    // current, so the message thread never frees it underneath us
+    ExcitationSet* set = currentSet.load();
+    pinned.store(set);
+    while (set != currentSet.load()) {
+        set = currentSet.load();
+        pinned.store(set);
+    }
+    if (set == nullptr || index >= static_cast<int>(set->slots.size())) {
+        return nullptr;
+    }
+    auto& slot = set->slots[index];
+    if (!slot.ready.load(std::memory_order_acquire) || slot.samples.empty()) {
+        return nullptr;
+    }
+    return &slot.samples;
+}
+
+void ExcitationLoader::timerCallback()
+{
+    auto* set = currentSet.load();
+    const double rate = sampleRate.load();
+    // A cancelled load stays cancelled
+    if (set != nullptr && !set->stale.load() && rate > 0.0 && !juce::approximatelyEqual(set->sampleRate, rate)) {
+        load(set->folder, rate);
+    }
+    releaseRetiredSets();
+}
+
+void ExcitationLoader::releaseRetiredSets()
+{
+    auto* current = currentSet.load();
+    auto isPinned = [this] (ExcitationSet* set) {
+        for (auto& pinned : readerSets) {
+            if (pinned.load() == set) {
+                return true;
+            }
+        }
+        return false;
+    };
+    for (auto it = ownedSets.begin(); it != ownedSets.end();) {
+        // Jobs still running keep their own reference to the set
+        if (it->get() != current && !isPinned(it->get())) {
+            it = ownedSets.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+using namespace juce;
+using namespace std;
+
+struct ExcitationSlot {
+    juce::File file;
+    vector<double> samples;
+    std::atomic<bool> ready{false};
+};
+
+// One folder decoded at one rate. Its decode jobs share ownership, so a set
+// that a newer load replaced only has to be marked stale: its jobs stop at
+// their next chunk and publish nothing, and nobody waits for them.
+struct ExcitationSet {
+    ExcitationSet(const juce::File& f, int numSlots, double rate) : folder(f), sampleRate(rate), slots(numSlots) {}
+    juce::File folder;
+    double sampleRate;
+    vector<ExcitationSlot> slots;
+    std::atomic<bool> stale{false};
+    std::atomic<int> numCompleted{0};
+};
+
+// Decodes a folder of custom excitations on a thread pool. Every file is
+// resampled to the host rate and peak-normalised on a worker, then published
+// to the audio thread through an atomic flag on its slot. When the host rate
+// changes, the folder is decoded again at the new rate.
+class ExcitationLoader : private juce::Timer
+{
+public:
+    ExcitationLoader();
+    ~ExcitationLoader() override;
+
+    // Message thread
+    void load(const juce::File& folder, double targetSampleRate);
+    void cancel();
+    // Any thread, e.g. from prepareToPlay: the current folder is decoded
+    // again at this rate shortly after, on the message thread
+    void setSampleRate(double rate) noexcept;
+    bool isLoading() const;
+    double getProgress() const;
+    vector<juce::File> getFiles() const;
+    bool isReady(int index) const;
+    const vector<double>* getExcitation(int index) const;
+
+    // Each thread that reads excitations outside the message thread pins the
+    // set it is reading in its own slot
+    enum Reader { audioThread = 0, segmentBuilder, numReaders };
+
+    // Lock-free: returns nullptr until the slot has finished decoding.
+    // Passing a negative index releases the set held by the reader.
+    const vector<double>* acquire(int index, Reader reader = audioThread) noexcept;
+
+    static vector<float> resample(const float* input, int numSamples, double speedRatio);
+    // Returns nothing as soon as stop is set, checked between chunks
+    static vector<double> decodeFile(juce::AudioFormatManager& formatManager, const juce::File& file, double targetSampleRate, const std::atomic<bool>* stop = nullptr);
+
+private:
+    class DecodeJob;
+
+    void timerCallback() override;
+    void releaseRetiredSets();
+
+    juce::AudioFormatManager formatManager;
+    juce::ThreadPool pool;
+    std::atomic<ExcitationSet*> currentSet{nullptr};
+    std::atomic<ExcitationSet*> readerSets[numReaders] {};
+    vector<shared_ptr<ExcitationSet>> ownedSets;
+    std::atomic<double> sampleRate{0.0};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ExcitationLoader)
+};
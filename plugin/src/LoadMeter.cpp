@@ -0,0 +1,65 @@
+#include "LoadMeter.h"
+
+LoadMeter::LoadMeter()
+{
+    setSize(400, 24);
+}
+
+void LoadMeter::update(const StageTiming::Snapshot& interval)
+{
+    // Nothing processed since the last update, e.g. with transport stopped
+    // in a host that stops calling processBlock
+    if (interval.blocks == 0)
+    {
+        if (load != 0.0)
+        {
+            load = 0.0;
+            repaint();
+        }
+        return;
+    }
+    load = interval.meanLoad();
+    for (int s = 0; s < StageTiming::numStages; s++)
+    {
+        stageLoads[s] = interval.stageLoad(static_cast<StageTiming::Stage>(s));
+    }
+    // Held for a while, then follows the worst block of each update down
+    auto now = juce::Time::getMillisecondCounter();
+    auto intervalPeak = interval.peakLoad();
+    if (intervalPeak >= peak || now - peakTime > static_cast<juce::uint32>(peakHoldMs))
+    {
+        peak = intervalPeak;
+        peakTime = now;
+    }
+    repaint();
+}
+
+void LoadMeter::paint(juce::Graphics& g)
+{
+    auto bounds = getLocalBounds().toFloat();
+    g.setColour(ColorScheme::fillColour);
+    g.fillRect(bounds);
+
+    // The bar spans the whole budget; past it the host misses its deadline
+    auto bar = bounds.reduced(2.0f);
+    auto fillWidth = bar.getWidth() * static_cast<float>(juce::jmin(load, 1.0));
+    g.setColour(load > 0.8 ? ColorScheme::readingsColour : ColorScheme::highlightColour);
+    g.fillRect(bar.withWidth(fillWidth));
+    if (peak > 0.0)
+    {
+        g.setColour(peak > 0.8 ? ColorScheme::readingsColour : ColorScheme::bgColour);
+        auto peakX = bar.getX() + bar.getWidth() * static_cast<float>(juce::jmin(peak, 1.0));
+        g.drawVerticalLine(juce::roundToInt(juce::jmin(peakX, bar.getRight() - 1.0f)), bar.getY(), bar.getBottom());
+    }
+
+    static const char* stageNames[StageTiming::numStages] = { "input", "analysis", "synthesis", "output" };
+    juce::String text = "CPU " + juce::String(juce::roundToInt(100.0 * load)) + "%  peak " + juce::String(juce::roundToInt(100.0 * peak))
+                      + "%  headroom " + juce::String(juce::jmax(0, juce::roundToInt(100.0 * (1.0 - peak)))) + "%   ";
+    for (int s = 0; s < StageTiming::numStages; s++)
+    {
+        text << "  " << stageNames[s] << " " << juce::String(100.0 * stageLoads[s], 1) << "%";
+    }
+    g.setColour(ColorScheme::bgColour);
+    g.setFont(juce::jmin(14.0f, bar.getHeight() * 0.8f));
+    g.drawText(text, bar.reduced(6.0f, 0.0f), juce::Justification::centredLeft, true);
+}
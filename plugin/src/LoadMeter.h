@@ -0,0 +1,28 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "ColorScheme.h"
+#include "stage_timing.h"
+
+// How much of each block's duration the plugin takes to process it, as a bar
+// with a peak hold, and which stages that time goes to, so that the setting
+// eating the budget shows before it causes dropouts. Fed by the editor's
+// timer with what the audio thread timed since the previous update.
+class LoadMeter : public juce::Component
+{
+public:
+    LoadMeter();
+
+    void update(const StageTiming::Snapshot& interval);
+    void paint(juce::Graphics& g) override;
+
+private:
+    static constexpr int peakHoldMs = 2000;
+
+    double load = 0.0;
+    double peak = 0.0;
+    juce::uint32 peakTime = 0;
+    double stageLoads[StageTiming::numStages] = {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoadMeter)
+};
@@ -1,9 +1,7 @@
 #pragma once
 
 #include <JuceHeader.h>
-
-#define MAX_ORDER 50
-#define MAX_FRAME_DUR 50
+#include "../libs/lpc_limits.h"
 
 using namespace juce;
 
@@ -21,10 +19,14 @@ namespace Utility
                 std::make_unique<AudioParameterFloat>(juce::ParameterID("lpcMix", 1), "LPC Mix", NormalisableRange<float>{0.f, 1.f, 0.01f}, 0.f),
                 std::make_unique<AudioParameterFloat>(juce::ParameterID("exLen", 1), "Excitation Length", NormalisableRange<float>{0.0001f, 1.f, 0.0001f, 0.3f}, 1.f),
                 std::make_unique<AudioParameterFloat>(juce::ParameterID("exStartPos", 1), "Excitation Start Position", NormalisableRange<float>{0.0f, 1.f, 0.01f}, 0.f),
-                std::make_unique<AudioParameterInt>(juce::ParameterID("exType", 1), "Excitation Type", 0, 7, 6),
+                // Version 2 covers the generators and MIDI, 8 to 11: widening the
+                // range changed what a normalised value maps to, so automation
+                // recorded against version 1's 0 to 7 does not carry over
+                std::make_unique<AudioParameterInt>(juce::ParameterID("exType", 2), "Excitation Type", 0, 11, 6),
                 std::make_unique<AudioParameterInt>(juce::ParameterID("lpcOrder", 1), "LPC Order", 1, MAX_ORDER, MAX_ORDER/2),
                 std::make_unique<AudioParameterFloat>(juce::ParameterID("frameDur", 1), "Frame Duration (ms)", NormalisableRange<float>{0.1f, (float)MAX_FRAME_DUR, 0.01f}, 10.f),
-                std::make_unique<AudioParameterBool>(juce::ParameterID("useSidechain", 1), "Use Sidechain as Excitation", false)
+                std::make_unique<AudioParameterBool>(juce::ParameterID("useSidechain", 1), "Use Sidechain as Excitation", false),
+                std::make_unique<AudioParameterBool>(juce::ParameterID("bounceMaxOrder", 1), "Bounce at Maximum Order", false)
             };
         }
     };
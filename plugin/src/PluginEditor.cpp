@@ -40,6 +40,11 @@ VoicemorphAudioProcessorEditor::VoicemorphAudioProcessorEditor (VoicemorphAudioP
     excitationDropdown.addItem("TrainScreech2", 6);
     excitationDropdown.addItem("WhiteNoise", 7);
     excitationDropdown.addItem("Off", 8);
+    excitationDropdown.addSeparator();
+    excitationDropdown.addItem("Noise (generated)", 9);
+    excitationDropdown.addItem("Pulse Train", 10);
+    excitationDropdown.addItem("Glottal Pulse", 11);
+    excitationDropdown.addItem("MIDI Oscillators", 12);
     excitationDropdown.setColour(juce::ComboBox::backgroundColourId, juce::Colours::black);
     excitationDropdown.setColour(juce::ComboBox::textColourId, ColorScheme::bgColour);
     getLookAndFeel().setColour(juce::PopupMenu::backgroundColourId, juce::Colours::black);
@@ -58,8 +63,30 @@ VoicemorphAudioProcessorEditor::VoicemorphAudioProcessorEditor (VoicemorphAudioP
     contactButton.addListener(this);
     addAndMakeVisible(contactButton);
     
+    loadCustomButton.setButtonText("Load Folder...");
+    loadCustomButton.setColour(juce::TextButton::buttonColourId, juce::Colours::black);
+    loadCustomButton.setColour(juce::TextButton::textColourOffId, ColorScheme::bgColour);
+    loadCustomButton.addListener(this);
+    addAndMakeVisible(loadCustomButton);
+    customExcitationDropdown.setTextWhenNothingSelected("Custom");
+    customExcitationDropdown.setColour(juce::ComboBox::backgroundColourId, juce::Colours::black);
+    customExcitationDropdown.setColour(juce::ComboBox::textColourId, ColorScheme::bgColour);
+    customExcitationDropdown.addListener(this);
+    addAndMakeVisible(customExcitationDropdown);
+    customLoadProgressBar.setColour(juce::ProgressBar::foregroundColourId, ColorScheme::readingsColour);
+    addChildComponent(customLoadProgressBar);
+    refreshCustomExcitationDropdown();
+    
     addAndMakeVisible(waveformViewer);
     updateWaveformDisplay();
+
+    addAndMakeVisible(loadMeter);
+    audioProcessor.lpc.timing.read(previousTiming);
+    diagnosticsLabel.setColour(juce::Label::textColourId, ColorScheme::bgColour);
+    diagnosticsLabel.setFont(juce::Font(12.0f));
+    addAndMakeVisible(diagnosticsLabel);
+    audioProcessor.lpc.diagnostics.read(previousDiagnostics);
+    updateDiagnosticsLabel(previousDiagnostics);
     
     showWarningIndicator = false;
     lastWarningTime = juce::Time::getCurrentTime();
@@ -71,6 +98,7 @@ VoicemorphAudioProcessorEditor::VoicemorphAudioProcessorEditor (VoicemorphAudioP
 VoicemorphAudioProcessorEditor::~VoicemorphAudioProcessorEditor()
 {
     excitationDropdown.removeListener(this);
+    customExcitationDropdown.removeListener(this);
 }
 
 //==============================================================================
@@ -102,18 +130,33 @@ void VoicemorphAudioProcessorEditor::resized()
     orderSlider.setBoundsRelative(0.04, 0.5, 0.28, 0.3);
     wetGainSlider.setBoundsRelative(0.36, 0.5, 0.28, 0.3);
     frameDurSlider.setBoundsRelative(0.68, 0.5, 0.28, 0.3);
-    waveformViewer.setBoundsRelative(0.04, 0.82, 0.6, 0.15);
+    waveformViewer.setBoundsRelative(0.04, 0.82, 0.44, 0.15);
+    customExcitationDropdown.setBoundsRelative(0.50, 0.82, 0.14, 0.05);
+    loadCustomButton.setBoundsRelative(0.50, 0.87, 0.14, 0.05);
+    customLoadProgressBar.setBoundsRelative(0.50, 0.92, 0.14, 0.05);
     excitationDropdown.setBoundsRelative(0.68, 0.82, 0.28, 0.05);
     sidechainButton.setBoundsRelative(0.68, 0.87, 0.28, 0.05);
     contactButton.setBoundsRelative(0.68, 0.92, 0.28, 0.05);
+    loadMeter.setBoundsRelative(0.04, 0.02, 0.92, 0.04);
+    diagnosticsLabel.setBoundsRelative(0.04, 0.06, 0.92, 0.03);
 }
 
 void VoicemorphAudioProcessorEditor::comboBoxChanged(juce::ComboBox* comboBoxThatHasChanged)
 {
     if (comboBoxThatHasChanged == &excitationDropdown) {
+        audioProcessor.setUsingCustomExcitation(false);
+        customExcitationDropdown.setSelectedId(0, juce::dontSendNotification);
         audioProcessor.apvts.getParameterAsValue("exType").setValue(excitationDropdown.getSelectedId()-1);
         updateWaveformDisplay();
     }
+    else if (comboBoxThatHasChanged == &customExcitationDropdown) {
+        int index = customExcitationDropdown.getSelectedId() - 1;
+        if (index >= 0) {
+            audioProcessor.setCustomExcitation(index);
+            audioProcessor.setUsingCustomExcitation(true);
+        }
+        updateWaveformDisplay();
+    }
 }
 
 void VoicemorphAudioProcessorEditor::buttonClicked(juce::Button* b)
@@ -124,6 +167,14 @@ void VoicemorphAudioProcessorEditor::buttonClicked(juce::Button* b)
             url.launchInDefaultBrowser();
         }
     }
+    else if (b == &loadCustomButton) {
+        if (audioProcessor.isLoadingCustomExcitations()) {
+            audioProcessor.cancelCustomExcitationLoad();
+        }
+        else {
+            chooseCustomExcitationFolder();
+        }
+    }
     else if (b == &sidechainButton) {
         exLenSlider.setVisible(!b->getToggleState());
         exStartSlider.setVisible(!b->getToggleState());
@@ -131,37 +182,70 @@ void VoicemorphAudioProcessorEditor::buttonClicked(juce::Button* b)
 }
 
 void VoicemorphAudioProcessorEditor::timerCallback() {
-    if (audioProcessor.factoryExcitations.size() > 0)
+    bool loading = audioProcessor.isLoadingCustomExcitations();
+    customLoadProgress = audioProcessor.getCustomExcitationLoadProgress();
+    if (loading != customLoadProgressBar.isVisible()) {
+        customLoadProgressBar.setVisible(loading);
+        loadCustomButton.setButtonText(loading ? "Cancel" : "Load Folder...");
+    }
+    refreshCustomExcitationDropdown();
+
+    audioProcessor.lpc.timing.read(currentTiming);
+    loadMeter.update(currentTiming.since(previousTiming));
+    previousTiming = currentTiming;
+    
+    if (audioProcessor.getFactoryExcitations().size() > 0)
     {
         int selectedExcitation = excitationDropdown.getSelectedId() - 1;
-        if (selectedExcitation >= 0 && selectedExcitation < static_cast<int>(audioProcessor.factoryExcitations.size()))
+        if (selectedExcitation >= 0 && selectedExcitation < static_cast<int>(audioProcessor.getFactoryExcitations().size()))
         {
             float exStart = audioProcessor.apvts.getParameterAsValue("exStartPos").getValue();
             int currentExPtr = audioProcessor.lpc.getCurrentExPtr(0);
             
-            float startPosInSamples = exStart * audioProcessor.factoryExcitations[selectedExcitation].size();
+            float startPosInSamples = exStart * audioProcessor.getFactoryExcitations()[selectedExcitation].size();
             
             waveformViewer.setPlayheadPosition(startPosInSamples, static_cast<float>(currentExPtr));
         }
     }
     
-    bool hasWarning = audioProcessor.hasAudioWarning.load();
+    DSPDiagnostics::Snapshot diagnostics;
+    audioProcessor.lpc.diagnostics.read(diagnostics);
+    auto recentDiagnostics = diagnostics.since(previousDiagnostics);
+    previousDiagnostics = diagnostics;
+    bool hasWarning = recentDiagnostics[DSPDiagnostics::nanSamples] > 0 || recentDiagnostics[DSPDiagnostics::clippedSamples] > 0;
     if (hasWarning) {
         if (!showWarningIndicator) {
             showWarningIndicator = true;
+            diagnosticsLabel.setColour(juce::Label::textColourId, ColorScheme::readingsColour);
             repaint();
         }
         lastWarningTime = juce::Time::getCurrentTime();
-        audioProcessor.hasAudioWarning.store(false);
     } else {
         if (showWarningIndicator) {
             juce::Time currentTime = juce::Time::getCurrentTime();
             if ((currentTime - lastWarningTime).inMilliseconds() >= 2000) {
                 showWarningIndicator = false;
+                diagnosticsLabel.setColour(juce::Label::textColourId, ColorScheme::bgColour);
                 repaint();
             }
         }
     }
+    for (int c = 0; c < DSPDiagnostics::numCounters; c++) {
+        if (recentDiagnostics.counts[c] > 0) {
+            updateDiagnosticsLabel(diagnostics);
+            break;
+        }
+    }
+}
+
+void VoicemorphAudioProcessorEditor::updateDiagnosticsLabel(const DSPDiagnostics::Snapshot& totals)
+{
+    juce::String text;
+    for (int c = 0; c < DSPDiagnostics::numCounters; c++) {
+        auto counter = static_cast<DSPDiagnostics::Counter>(c);
+        text << (c > 0 ? "   " : "") << DSPDiagnostics::label(counter) << " " << juce::String(static_cast<juce::int64>(totals[counter]));
+    }
+    diagnosticsLabel.setText(text, juce::dontSendNotification);
 }
 
 void VoicemorphAudioProcessorEditor::initialiseSlider(juce::Slider& slider, juce::Label& label, std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>& attachment, juce::AudioProcessorValueTreeState& vts, const juce::String& parameterID, const juce::String& labelText)
@@ -180,17 +264,52 @@ void VoicemorphAudioProcessorEditor::initialiseSlider(juce::Slider& slider, juce
     attachment.reset(new juce::AudioProcessorValueTreeState::SliderAttachment(vts, parameterID, slider));
 }
 
+void VoicemorphAudioProcessorEditor::chooseCustomExcitationFolder()
+{
+    customExcitationChooser = std::make_unique<juce::FileChooser>("Select an excitation in the folder to load", juce::File(), "*.wav");
+    auto flags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+    customExcitationChooser->launchAsync(flags, [this] (const juce::FileChooser& chooser) {
+        auto file = chooser.getResult();
+        if (file == juce::File()) {
+            return;
+        }
+        // The loader frees the previous set once it is no longer in use,
+        // so stop pointing the viewer at it before starting a new load
+        customExcitationDropdown.clear(juce::dontSendNotification);
+        audioProcessor.loadCustomExcitations(file);
+        updateWaveformDisplay();
+    });
+}
+
+void VoicemorphAudioProcessorEditor::refreshCustomExcitationDropdown()
+{
+    auto files = audioProcessor.getCustomExcitationFiles();
+    for (int i = 0; i < static_cast<int>(files.size()); i++) {
+        int itemId = i + 1;
+        if (customExcitationDropdown.indexOfItemId(itemId) < 0 && audioProcessor.getCustomExcitation(i) != nullptr) {
+            customExcitationDropdown.addItem(files[i].getFileNameWithoutExtension(), itemId);
+        }
+    }
+}
+
 void VoicemorphAudioProcessorEditor::updateWaveformDisplay()
 {
+    int selectedCustom = customExcitationDropdown.getSelectedId() - 1;
+    if (selectedCustom >= 0 && audioProcessor.getCustomExcitation(selectedCustom) != nullptr)
+    {
+        waveformViewer.setWaveform(audioProcessor.getCustomExcitation(selectedCustom));
+        return;
+    }
+    
     int selectedExcitation = excitationDropdown.getSelectedId() - 1;
     
-    if (selectedExcitation >= 0 && selectedExcitation < static_cast<int>(audioProcessor.factoryExcitations.size()))
+    if (selectedExcitation >= 0 && selectedExcitation < static_cast<int>(audioProcessor.getFactoryExcitations().size()))
     {
-        waveformViewer.setWaveform(&audioProcessor.factoryExcitations[selectedExcitation]);
+        waveformViewer.setWaveform(&audioProcessor.getFactoryExcitations()[selectedExcitation]);
         
         float exStart = audioProcessor.apvts.getParameterAsValue("exStartPos").getValue();
         int currentExPtr = audioProcessor.lpc.getCurrentExPtr(0);
-        float startPosInSamples = exStart * audioProcessor.factoryExcitations[selectedExcitation].size();
+        float startPosInSamples = exStart * audioProcessor.getFactoryExcitations()[selectedExcitation].size();
         
         waveformViewer.setPlayheadPosition(startPosInSamples, static_cast<float>(currentExPtr));
     }
@@ -12,6 +12,7 @@
 #include "PluginProcessor.h"
 #include "../libs/sampler.h"
 #include "ColorScheme.h"
+#include "LoadMeter.h"
 #include <cmath>
 
 //==============================================================================
@@ -36,6 +37,9 @@ public:
 private:
     void initialiseSlider(juce::Slider& slider, juce::Label& label, std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>& attachment, juce::AudioProcessorValueTreeState& vts, const juce::String& parameterID, const juce::String& labelText);
     void updateWaveformDisplay();
+    void chooseCustomExcitationFolder();
+    void refreshCustomExcitationDropdown();
+    void updateDiagnosticsLabel(const DSPDiagnostics::Snapshot& totals);
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     VoicemorphAudioProcessor& audioProcessor;
@@ -54,8 +58,19 @@ private:
     Slider frameDurSlider;
     Label frameDurLabel;
     juce::TextButton contactButton;
+    juce::TextButton loadCustomButton;
+    double customLoadProgress = 0.0;
+    juce::ProgressBar customLoadProgressBar { customLoadProgress };
+    std::unique_ptr<juce::FileChooser> customExcitationChooser;
     juce::ToggleButton sidechainButton;
     WaveformViewer waveformViewer;
+    LoadMeter loadMeter;
+    // The audio thread's timing at the previous timer callback
+    StageTiming::Snapshot previousTiming;
+    StageTiming::Snapshot currentTiming;
+    // What the DSP corrected or skipped since the plugin was loaded
+    juce::Label diagnosticsLabel;
+    DSPDiagnostics::Snapshot previousDiagnostics;
     
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> wetGainAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> lpcMixAttachment;
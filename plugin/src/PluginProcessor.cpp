@@ -8,6 +8,38 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include <chrono>
+
+// Rebuilds the excitation loop segment off the audio thread whenever Start,
+// Length or the excitation itself change, and whenever the table behind the
+// excitation is replaced, as when tables resampled for the host rate become
+// ready. Parameter listeners can run on the audio thread, where waking a
+// thread would take a lock, so they only set segmentDirty and the builder
+// checks it every pollIntervalMs. Changes made on the message thread also
+// wake it at once.
+class VoicemorphAudioProcessor::ExcitationSegmentBuilder : public juce::Thread
+{
+public:
+    ExcitationSegmentBuilder(VoicemorphAudioProcessor& p) : juce::Thread("Excitation segment builder"), processor(p) {}
+
+    void run() override
+    {
+        const vector<double>* builtTable = nullptr;
+        while (!threadShouldExit()) {
+            auto* table = processor.resolveExcitationTable(ExcitationLoader::segmentBuilder);
+            if (processor.segmentDirty.exchange(false) || table != builtTable) {
+                processor.engine.buildExcitationSegment(table, processor.readParameters());
+                builtTable = table;
+            }
+            wait(pollIntervalMs);
+        }
+    }
+
+    static constexpr int pollIntervalMs = 10;
+
+private:
+    VoicemorphAudioProcessor& processor;
+};
 
 //==============================================================================
 VoicemorphAudioProcessor::VoicemorphAudioProcessor()
@@ -23,10 +55,12 @@ VoicemorphAudioProcessor::VoicemorphAudioProcessor()
                      .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                    #endif
                      ),
-lpc(2), apvts(*this, nullptr, juce::Identifier ("Parameters"), Utility::ParameterHelper::createParameterLayout())
+engine(2), apvts(*this, nullptr, juce::Identifier ("Parameters"), Utility::ParameterHelper::createParameterLayout())
 #endif
 {
-    loadFactoryExcitations();
+    factoryTables = excitationCache->request(ExcitationCache::nativeSampleRate);
+    lpc.noise = &getFactoryExcitations()[6];
+    lpc.EXLEN = lpc.noise->size();
     exLenParameter = apvts.getRawParameterValue ("exLen");
     gainParameter = apvts.getRawParameterValue ("wetGain");
     lpcMixParameter = apvts.getRawParameterValue ("lpcMix");
@@ -35,54 +69,35 @@ lpc(2), apvts(*this, nullptr, juce::Identifier ("Parameters"), Utility::Paramete
     lpcExTypeParameter = apvts.getRawParameterValue ("exType");
     frameDurParameter = apvts.getRawParameterValue ("frameDur");
     useSidechainParameter = apvts.getRawParameterValue ("useSidechain");
+    bounceMaxOrderParameter = apvts.getRawParameterValue ("bounceMaxOrder");
     isStandalone = wrapperType == wrapperType_Standalone;
+    segmentBuilder = std::make_unique<ExcitationSegmentBuilder>(*this);
+    for (auto* parameterID : segmentParameterIDs) {
+        apvts.addParameterListener(parameterID, this);
+    }
+    auto capturePath = juce::SystemStats::getEnvironmentVariable("LPMORPH_CAPTURE_DIR", {});
+    if (capturePath.isNotEmpty()) {
+        captureDirectory = juce::File(capturePath);
+    }
+    auto tracePath = juce::SystemStats::getEnvironmentVariable("LPMORPH_TRACE_DIR", {});
+    if (tracePath.isNotEmpty()) {
+        traceDirectory = juce::File(tracePath);
+    }
+    metricsLabel = juce::SystemStats::getEnvironmentVariable("LPMORPH_METRICS", {});
 }
 
 VoicemorphAudioProcessor::~VoicemorphAudioProcessor()
 {
-}
-
-// Function to load a WAV file into a vector<double>
-std::vector<double> loadEmbeddedWavToBuffer(const void* data, size_t dataSize, bool dbg=false)
-{
-    if (data != nullptr && dataSize > 0) {
-        size_t numSamples = dataSize / 2;
-        const int16_t* sampleData = static_cast<const int16_t*>(data);
-        std::vector<double> samples;
-        samples.reserve(numSamples);
-        for (size_t i = 0; i < numSamples; ++i)
-        {
-            samples.push_back(static_cast<double>(sampleData[i]) / 32768.0);
-        }
-        return samples;
+    for (auto* parameterID : segmentParameterIDs) {
+        apvts.removeParameterListener(parameterID, this);
     }
-    return {};
+    segmentBuilder->stopThread(1000);
+    bounceWorkers.stop();
 }
 
-void VoicemorphAudioProcessor::loadFactoryExcitations() {
-    auto bassyTrainAudio = loadEmbeddedWavToBuffer(BinaryData::BassyTrainNoise_wav_bin, BinaryData::BassyTrainNoise_wav_binSize);
-    factoryExcitations.push_back(bassyTrainAudio);
-    
-    auto cherubScreamsAudio = loadEmbeddedWavToBuffer(BinaryData::CherubScreams_wav_bin, BinaryData::CherubScreams_wav_binSize);
-    factoryExcitations.push_back(cherubScreamsAudio);
-    
-    auto micScratchAudio = loadEmbeddedWavToBuffer(BinaryData::MicScratch_wav_bin, BinaryData::MicScratch_wav_binSize);
-    factoryExcitations.push_back(micScratchAudio);
-    
-    auto ringAudio = loadEmbeddedWavToBuffer(BinaryData::Ring_wav_bin, BinaryData::Ring_wav_binSize);
-    factoryExcitations.push_back(ringAudio);
-    
-    auto trainScreech1Audio = loadEmbeddedWavToBuffer(BinaryData::TrainScreech1_wav_bin, BinaryData::TrainScreech1_wav_binSize);
-    factoryExcitations.push_back(trainScreech1Audio);
-    
-    auto trainScreech2Audio = loadEmbeddedWavToBuffer(BinaryData::TrainScreech2_wav_bin, BinaryData::TrainScreech2_wav_binSize);
-    factoryExcitations.push_back(trainScreech2Audio);
-    
-    auto whiteNoiseAudio = loadEmbeddedWavToBuffer(BinaryData::WhiteNoise_wav_bin, BinaryData::WhiteNoise_wav_binSize, true);
-    factoryExcitations.push_back(whiteNoiseAudio);
-
-    lpc.noise = &factoryExcitations[6];
-    lpc.EXLEN = lpc.noise->size();
+const std::vector<std::vector<double>>& VoicemorphAudioProcessor::getFactoryExcitations() const
+{
+    return excitationCache->getTables(factoryTables.load());
 }
 
 //==============================================================================
@@ -147,47 +162,56 @@ void VoicemorphAudioProcessor::changeProgramName (int index, const juce::String&
 {
 }
 
-void VoicemorphAudioProcessor::updateLpcParams() {
-    float lpcMix = (*lpcMixParameter).load();
-    float exStartPos = (*lpcExStartParameter).load();
-    int prevExType = lpc.exType;
-    lpc.exType = static_cast<int>((*lpcExTypeParameter).load());
-    
-//    if (usingCustomExcitation && currentCustomExcitationIndex >= 0 && currentCustomExcitationIndex < customExcitations.size()) {
-//        lpc.noise = &customExcitations[currentCustomExcitationIndex];
-//        lpc.EXLEN = (*lpc.noise).size();
-//    } else if (lpc.exType == customExcitations.size()) {
-//        lpc.noise = nullptr;
-//        lpc.EXLEN = 0;
-//    } else if (lpc.exType >= 0 && lpc.exType < factoryExcitations.size()) {
-//        lpc.noise = &factoryExcitations[lpc.exType];
-//        lpc.EXLEN = (*lpc.noise).size();
-//    } else {
-//        lpc.noise = nullptr;
-//        lpc.EXLEN = 0;
-//    }
-    if (lpc.exType >= 0 && lpc.exType < factoryExcitations.size()) {
-        lpc.noise = &factoryExcitations[lpc.exType];
-        lpc.EXLEN = (*lpc.noise).size();
-    } else if (lpc.exType == factoryExcitations.size()) {
-        lpc.noise = nullptr;
-        lpc.EXLEN = 0;
+LPCParameters VoicemorphAudioProcessor::readParameters() const {
+    LPCParameters params;
+    params.wetGain = (*gainParameter).load();
+    params.lpcMix = (*lpcMixParameter).load();
+    params.exLen = (*exLenParameter).load();
+    params.exStartPos = (*lpcExStartParameter).load();
+    params.exType = static_cast<int>((*lpcExTypeParameter).load());
+    params.lpcOrder = static_cast<int>((*lpcOrderParameter).load());
+    params.frameDur = (*frameDurParameter).load();
+    params.useSidechain = static_cast<bool>((*useSidechainParameter).load());
+    return params;
+}
+
+LPCExcitation VoicemorphAudioProcessor::resolveExcitation(ExcitationLoader::Reader reader) {
+    LPCExcitation excitation;
+    excitation.table = resolveExcitationTable(reader);
+    excitation.numFactoryTables = static_cast<int>(getFactoryExcitations().size());
+    excitation.custom = usingCustomExcitation.load();
+    return excitation;
+}
+
+const vector<double>* VoicemorphAudioProcessor::resolveExcitationTable(ExcitationLoader::Reader reader) {
+    const vector<double>* customExcitation = nullptr;
+    if (usingCustomExcitation.load()) {
+        customExcitation = customExcitationLoader.acquire(currentCustomExcitationIndex.load(), reader);
     }
-    
-    int prevOrder = lpc.ORDER;
-    lpc.ORDER = static_cast<int>((*lpcOrderParameter).load());
-    lpc.orderChanged = prevOrder != lpc.ORDER;
-    lpc.exTypeChanged = prevExType != lpc.exType;
-    lpc.exStartChanged = lpc.exStart != exStartPos;
-    lpc.prevFrameLen = lpc.FRAMELEN;
-    lpc.FRAMELEN = static_cast<int>((*frameDurParameter).load()*lpc.SAMPLERATE/1000.0);
-    lpc.FRAMELEN = 1024;
-    if (lpc.prevFrameLen != lpc.FRAMELEN) {
-        for (int i = 0; i < lpc.FRAMELEN; i++) {
-            lpc.window[i] = 0.5*(1.0-cos(2.0*M_PI*i/(double)(lpc.FRAMELEN-1)));
-        }
-        lpc.HOPSIZE = lpc.FRAMELEN/2;
+    else {
+        customExcitationLoader.acquire(-1, reader);
+    }
+    if (customExcitation != nullptr) {
+        return customExcitation;
     }
+    const auto& factoryExcitations = getFactoryExcitations();
+    int exType = static_cast<int>((*lpcExTypeParameter).load());
+    if (exType >= 0 && exType < factoryExcitations.size()) {
+        return &factoryExcitations[exType];
+    }
+    return nullptr;
+}
+
+void VoicemorphAudioProcessor::buildExcitationSegment() {
+    auto* table = resolveExcitationTable(ExcitationLoader::segmentBuilder);
+    engine.buildExcitationSegment(table, readParameters());
+}
+
+void VoicemorphAudioProcessor::parameterChanged(const juce::String&, float)
+{
+    // Also called on the audio thread under automation, where notify()
+    // would lock the builder's event
+    segmentDirty.store(true);
 }
 
 //==============================================================================
@@ -195,16 +219,129 @@ void VoicemorphAudioProcessor::prepareToPlay (double sampleRate, int samplesPerB
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    previousGain = (*gainParameter).load();
-    previousGain = juce::Decibels::decibelsToGain(previousGain);
-    updateLpcParams();
-    lpc.prepareToPlay();
+    hostSampleRate = sampleRate;
+    // Resampled tables are built in the background; until they are ready
+    // getFactoryExcitations() keeps returning the 44.1 kHz originals
+    factoryTables = excitationCache->request(sampleRate);
+    customExcitationLoader.setSampleRate(sampleRate);
+    auto params = readParameters();
+    engine.prepare(sampleRate, params, resolveExcitation(ExcitationLoader::audioThread));
+    // Build the first segment here so that playback starts with it, then
+    // leave later rebuilds to the background thread
+    segmentBuilder->stopThread(1000);
+    buildExcitationSegment();
+    lpc.beginBlock();
+    segmentBuilder->startThread();
+    // Most hosts switch to non-realtime before preparing for a bounce
+    prepared = true;
+    updateBounceWorkers();
+    if (captureDirectory != juce::File()) {
+        startCapture(sampleRate, samplesPerBlock, params);
+    }
+    if (traceDirectory != juce::File() && !dspTrace.isRecording()) {
+        startTrace();
+    }
+    if (metricsLabel.isNotEmpty() && !metricsPublisher.isPublishing()) {
+        if (metricsPublisher.start(metricsLabel.toStdString())) {
+            engine.metrics = &metricsPublisher;
+        }
+        else {
+            DBG("cannot publish metrics");
+        }
+    }
+}
+
+void VoicemorphAudioProcessor::setNonRealtime (bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime (isNonRealtime);
+    // Others switch without preparing again. Hosts hold the callback lock
+    // around processBlock, so no block runs while the workers change.
+    const juce::ScopedLock lock (getCallbackLock());
+    if (prepared) {
+        updateBounceWorkers();
+    }
+}
+
+void VoicemorphAudioProcessor::updateBounceWorkers()
+{
+    if (isNonRealtime()) {
+        bounceWorkers.start(juce::jlimit(0, maxBounceWorkers, juce::SystemStats::getNumCpus() - 1));
+        engine.prepareThreads(bounceWorkers.getNumThreads());
+    }
+    else {
+        bounceWorkers.stop();
+    }
+}
+
+void VoicemorphAudioProcessor::startTrace()
+{
+    // One trace over the instance's whole life rather than one per
+    // prepareToPlay, to line up with a trace of the host session
+    traceDirectory.createDirectory();
+    auto file = traceDirectory.getNonexistentChildFile("lpmorph-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S"), ".json", false);
+    if (dspTrace.start(file.getFullPathName().toStdString())) {
+        lpc.trace = &dspTrace;
+    }
+    else {
+        DBG("cannot write trace " << file.getFullPathName());
+    }
+}
+
+void VoicemorphAudioProcessor::startCapture(double sampleRate, int samplesPerBlock, const LPCParameters& params)
+{
+    // A replay starts from a freshly prepared engine, so each prepareToPlay
+    // starts a new capture
+    captureDirectory.createDirectory();
+    auto file = captureDirectory.getNonexistentChildFile("lpmorph-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S"), ".lpcap", false);
+    // Hosts may send longer blocks than they announce
+    if (!sessionRecorder.start(file.getFullPathName().toStdString(), sampleRate, 2, juce::jmax(samplesPerBlock, 8192), params)) {
+        DBG("cannot write capture " << file.getFullPathName());
+    }
+}
+
+void VoicemorphAudioProcessor::captureBlock(const LPCParameters& params, bool bouncing, int numChannels, int numSamples, const float* const* inputs,
+                                            const float* const* sidechains, const juce::MidiBuffer& midiMessages)
+{
+    SessionBlock info;
+    info.numSamples = numSamples;
+    info.numChannels = numChannels;
+    info.parameters = params;
+    info.flags = (bouncing ? SessionBlock::bouncing : 0u) | (usingCustomExcitation.load() ? SessionBlock::customExcitation : 0u);
+    const auto& nativeTables = excitationCache->getNativeTables();
+    const auto& factoryExcitations = getFactoryExcitations();
+    if (&factoryExcitations == &nativeTables) {
+        info.flags |= SessionBlock::nativeFactoryTables;
+    }
+    // The loop this block synthesises from, which the segment builder may
+    // not yet have caught up with the parameters on
+    const auto& segment = lpc.getExcitationSegment();
+    for (size_t i = 0; i < factoryExcitations.size() && segment.tableData() != nullptr; i++) {
+        if (factoryExcitations[i].data() == segment.tableData()) {
+            info.segmentTable = static_cast<int>(i);
+        }
+        else if (nativeTables[i].data() == segment.tableData()) {
+            info.segmentTable = static_cast<int>(i);
+            info.flags |= SessionBlock::nativeSegmentTable;
+        }
+    }
+    info.segmentStart = segment.start();
+    info.segmentLength = segment.length();
+    sessionRecorder.beginBlock(info, inputs, sidechains);
+    for (const auto metadata : midiMessages) {
+        if (metadata.numBytes <= 3) {
+            sessionRecorder.addMidi(metadata.samplePosition, metadata.data, metadata.numBytes);
+        }
+    }
 }
 
 void VoicemorphAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    segmentBuilder->stopThread(1000);
+    prepared = false;
+    bounceWorkers.stop();
+    sessionRecorder.stop();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -236,17 +373,48 @@ bool VoicemorphAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 void VoicemorphAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    DSPTrace::Span span(lpc.trace, DSPTrace::processBlock, -1, buffer.getNumSamples());
+    const bool capturing = sessionRecorder.isRecording();
+    const auto blockStart = capturing ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     int numChannels = totalNumOutputChannels;
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
-    updateLpcParams();
-    currentGain = (*gainParameter).load();
-    currentGain = juce::Decibels::decibelsToGain(currentGain);
-    bool useSidechain = (!JUCEApplication::isStandaloneApp()) && static_cast<bool>((*useSidechainParameter).load());
+    const bool bouncing = isNonRealtime() && bounceWorkers.isRunning();
+    auto params = readParameters();
+    if (bouncing && static_cast<bool>((*bounceMaxOrderParameter).load())) {
+        // Worth its cost only when there is no real-time deadline to meet
+        params.lpcOrder = MAX_ORDER;
+    }
+    engine.beginBlock(params, resolveExcitation(ExcitationLoader::audioThread));
+    // Notes take effect from the start of the block whatever their
+    // samplePosition, so they can sound up to a block early. The voices are
+    // only rendered a frame at a time on each hop anyway, and splitting the
+    // block at a note would move the hops within their blocks, which changes
+    // the output.
+    for (const auto metadata : midiMessages) {
+        // Only short messages, which MidiMessage stores without allocating
+        if (metadata.numBytes > 3) {
+            continue;
+        }
+        const auto message = metadata.getMessage();
+        if (message.isNoteOn()) {
+            lpc.voices.noteOn(message.getNoteNumber(), message.getFloatVelocity());
+        }
+        else if (message.isNoteOff()) {
+            lpc.voices.noteOff(message.getNoteNumber());
+        }
+        else if (message.isAllNotesOff() || message.isAllSoundOff()) {
+            lpc.voices.allNotesOff();
+        }
+    }
+    bool useSidechain = (!JUCEApplication::isStandaloneApp()) && params.useSidechain;
+    const float *inputs[2] = {};
+    float *outputs[2] = {};
+    const float *sidechains[2] = {};
+    numChannels = juce::jmin (numChannels, 2);
     if (useSidechain) {
-        const float *sidechainData = nullptr;
         auto* scBus = getBus(true, 1);
         AudioBuffer<float> sidechainBuffer;
         AudioBuffer<float> inputBuffer = getBusBuffer(buffer, true, 0);;
@@ -256,27 +424,33 @@ void VoicemorphAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
             numChannels = juce::jmin (sidechainBuffer.getNumChannels(), outputBuffer.getNumChannels());
         }
         for (int ch = 0; ch < numChannels; ch++) {
-            auto *channelDataR = inputBuffer.getReadPointer(ch);
-            auto *channelDataW = inputBuffer.getWritePointer(ch);
-            sidechainData = sidechainBuffer.getReadPointer(ch);
-            bool warning = lpc.applyLPC(channelDataR, channelDataW, buffer.getNumSamples(), (*lpcMixParameter).load(), (*exLenParameter).load(), ch, (*lpcExStartParameter).load(), sidechainData, previousGain, currentGain);
-            if (warning) {
-                hasAudioWarning.store(true);
-            }
+            inputs[ch] = inputBuffer.getReadPointer(ch);
+            outputs[ch] = inputBuffer.getWritePointer(ch);
+            sidechains[ch] = sidechainBuffer.getReadPointer(ch);
         }
     }
     else {
         for (int ch = 0; ch < numChannels; ch++) {
-            auto *channelDataR = buffer.getReadPointer(ch);
-            auto *channelDataW = buffer.getWritePointer(ch);
-            bool warning = lpc.applyLPC(channelDataR, channelDataW, buffer.getNumSamples(), (*lpcMixParameter).load(), (*exLenParameter).load(), ch, (*lpcExStartParameter).load(), nullptr, previousGain, currentGain);
-            if (warning) {
-                hasAudioWarning.store(true);
-            }
+            inputs[ch] = buffer.getReadPointer(ch);
+            outputs[ch] = buffer.getWritePointer(ch);
         }
     }
-    if (!juce::approximatelyEqual(currentGain, previousGain)) {
-        previousGain = currentGain;
+    if (capturing) {
+        captureBlock(params, bouncing, numChannels, buffer.getNumSamples(), inputs, useSidechain ? sidechains : nullptr, midiMessages);
+    }
+    // NaN and clipped samples are counted in lpc.diagnostics
+    if (bouncing) {
+        engine.processChannels(inputs, outputs, sidechains, numChannels, buffer.getNumSamples(), bounceWorkers);
+    }
+    else {
+        for (int ch = 0; ch < numChannels; ch++) {
+            engine.processChannel(inputs[ch], outputs[ch], buffer.getNumSamples(), ch, sidechains[ch]);
+        }
+    }
+    engine.endBlock();
+    if (capturing) {
+        const auto elapsed = std::chrono::steady_clock::now() - blockStart;
+        sessionRecorder.endBlock(outputs, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
     }
 }
 
@@ -305,68 +479,55 @@ void VoicemorphAudioProcessor::setStateInformation (const void* data, int sizeIn
     // whose contents will have been created by the getStateInformation() call.
 }
 
-//==============================================================================
-// This creates new instances of the plugin..
-std::vector<double> loadWavFile(const juce::File& file)
+void VoicemorphAudioProcessor::loadCustomExcitations(const juce::File& selectedFile)
 {
-    juce::AudioFormatManager formatManager;
-    formatManager.registerBasicFormats();
-    
-    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
-    if (reader != nullptr)
-    {
-        const int numSamples = static_cast<int>(reader->lengthInSamples);
-        juce::AudioBuffer<float> buffer(1, numSamples);
-        reader->read(&buffer, 0, numSamples, 0, true, false);
-        
-        std::vector<double> samples;
-        samples.reserve(numSamples);
-        const float* channelData = buffer.getReadPointer(0);
-        for (int i = 0; i < numSamples; ++i)
-        {
-            samples.push_back(static_cast<double>(channelData[i]));
-        }
-        return samples;
-    }
-    return {};
+    usingCustomExcitation.store(false);
+    currentCustomExcitationIndex.store(-1);
+    segmentDirty.store(true);
+    segmentBuilder->notify();
+    customExcitationLoader.load(selectedFile.getParentDirectory(), hostSampleRate);
 }
 
-void VoicemorphAudioProcessor::loadCustomExcitations(const juce::File& selectedFile)
+void VoicemorphAudioProcessor::cancelCustomExcitationLoad()
 {
-    customExcitations.clear();
-    customExcitationFiles.clear();
-    
-    juce::File parentDir = selectedFile.getParentDirectory();
-    juce::Array<juce::File> wavFiles;
-    parentDir.findChildFiles(wavFiles, juce::File::findFiles, false, "*.wav");
-    
-    for (const auto& file : wavFiles)
-    {
-        auto samples = loadWavFile(file);
-        if (!samples.empty())
-        {
-            customExcitations.push_back(samples);
-            customExcitationFiles.push_back(file);
-        }
-    }
+    customExcitationLoader.cancel();
+}
+
+bool VoicemorphAudioProcessor::isLoadingCustomExcitations() const
+{
+    return customExcitationLoader.isLoading();
+}
+
+double VoicemorphAudioProcessor::getCustomExcitationLoadProgress() const
+{
+    return customExcitationLoader.getProgress();
+}
+
+const std::vector<double>* VoicemorphAudioProcessor::getCustomExcitation(int index) const
+{
+    return customExcitationLoader.getExcitation(index);
 }
 
 void VoicemorphAudioProcessor::setCustomExcitation(int index)
 {
-    if (index >= 0 && index < customExcitations.size())
+    if (customExcitationLoader.isReady(index))
     {
         currentCustomExcitationIndex = index;
+        segmentDirty.store(true);
+        segmentBuilder->notify();
     }
 }
 
 std::vector<juce::File> VoicemorphAudioProcessor::getCustomExcitationFiles() const
 {
-    return customExcitationFiles;
+    return customExcitationLoader.getFiles();
 }
 
 void VoicemorphAudioProcessor::setUsingCustomExcitation(bool useCustom)
 {
     usingCustomExcitation = useCustom;
+    segmentDirty.store(true);
+    segmentBuilder->notify();
 }
 
 bool VoicemorphAudioProcessor::isUsingCustomExcitation() const
@@ -374,6 +535,8 @@ bool VoicemorphAudioProcessor::isUsingCustomExcitation() const
     return usingCustomExcitation;
 }
 
+//==============================================================================
+// This creates new instances of the plugin..
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new VoicemorphAudioProcessor();
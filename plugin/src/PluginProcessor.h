@@ -9,9 +9,12 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "lpc.h"
+#include "lpc_engine.h"
 #include "agc.h"
 #include "ParameterHelper.h"
+#include "ExcitationLoader.h"
+#include "ExcitationCache.h"
+#include "session_capture.h"
 #include <cmath>
 
 //==============================================================================
@@ -21,7 +24,8 @@
 using namespace juce;
 using namespace std;
 
-class VoicemorphAudioProcessor  : public juce::AudioProcessor, public ValueTree::Listener
+class VoicemorphAudioProcessor  : public juce::AudioProcessor, public ValueTree::Listener,
+                                  private juce::AudioProcessorValueTreeState::Listener
 {
 public:
     //==============================================================================
@@ -31,6 +35,7 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void setNonRealtime (bool isNonRealtime) noexcept override;
 
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
@@ -61,25 +66,27 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
     
-    LPC lpc;
+    LPCEngine engine;
+    LPC& lpc = engine.lpc;
     
     AudioProcessorValueTreeState apvts;
     void setUsingCustomExcitation(bool useCustom);
     vector<juce::File> getCustomExcitationFiles() const;
     void setCustomExcitation(int index);
     void loadCustomExcitations(const juce::File& selectedFile);
+    void cancelCustomExcitationLoad();
+    bool isLoadingCustomExcitations() const;
+    double getCustomExcitationLoadProgress() const;
+    const vector<double>* getCustomExcitation(int index) const;
     
-    vector<vector<double>> factoryExcitations;
-    
-    std::atomic<bool> hasAudioWarning{false};
+    const vector<vector<double>>& getFactoryExcitations() const;
     
 private:
-    float previousGain = 0;
-    float currentGain = 0;
-    void loadFactoryExcitations();
     juce::File writeBinaryDataToTempFile(const void* data, int size, const juce::String& fileName);
-    vector<vector<double>> customExcitations;
-    vector<juce::File> customExcitationFiles;
+    ExcitationLoader customExcitationLoader;
+    juce::SharedResourcePointer<ExcitationCache> excitationCache;
+    std::atomic<const ExcitationTables*> factoryTables{nullptr};
+    double hostSampleRate = 44100.0;
     bool isUsingCustomExcitation() const;
     std::atomic<float>* exLenParameter  = nullptr;
     std::atomic<float>* gainParameter  = nullptr;
@@ -89,10 +96,47 @@ private:
     std::atomic<float>* lpcExTypeParameter  = nullptr;
     std::atomic<float>* frameDurParameter  = nullptr;
     std::atomic<float>* useSidechainParameter  = nullptr;
+    std::atomic<float>* bounceMaxOrderParameter  = nullptr;
     bool isStandalone;
-    bool usingCustomExcitation = false;
-    int currentCustomExcitationIndex = -1;
-    void updateLpcParams();
+    std::atomic<bool> usingCustomExcitation{false};
+    std::atomic<int> currentCustomExcitationIndex{-1};
+    LPCParameters readParameters() const;
+    LPCExcitation resolveExcitation(ExcitationLoader::Reader reader);
+    const vector<double>* resolveExcitationTable(ExcitationLoader::Reader reader);
+    void buildExcitationSegment();
+    class ExcitationSegmentBuilder;
+    std::unique_ptr<ExcitationSegmentBuilder> segmentBuilder;
+    // Set when the segment needs rebuilding; the builder polls it, so that
+    // any thread, the audio thread included, can set it without a lock
+    std::atomic<bool> segmentDirty{true};
+    // Marks the segment dirty when Start, Length or the excitation change
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    static constexpr const char* segmentParameterIDs[] = { "exStartPos", "exLen", "exType" };
+    // Spreads the channels and the analysis over several threads while the
+    // host renders offline; idle otherwise
+    WorkerPool bounceWorkers;
+    static constexpr int maxBounceWorkers = 7;
+    // Between prepareToPlay and releaseResources
+    bool prepared = false;
+    // Starts the bounce workers when non-realtime, stops them otherwise
+    void updateBounceWorkers();
+    // Opt-in: with LPMORPH_CAPTURE_DIR set, every prepareToPlay starts a
+    // capture there of the blocks that follow, for lpmorph-replay
+    juce::File captureDirectory;
+    SessionRecorder sessionRecorder;
+    void startCapture(double sampleRate, int samplesPerBlock, const LPCParameters& params);
+    void captureBlock(const LPCParameters& params, bool bouncing, int numChannels, int numSamples, const float* const* inputs,
+                      const float* const* sidechains, const juce::MidiBuffer& midiMessages);
+    // Opt-in: with LPMORPH_TRACE_DIR set, the first prepareToPlay starts a
+    // Chrome trace there of processBlock, applyLPC, analysis and synthesis
+    juce::File traceDirectory;
+    DSPTrace dspTrace;
+    void startTrace();
+    // Opt-in: with LPMORPH_METRICS set, the first prepareToPlay publishes the
+    // engine's metrics to shared memory, labelled with its value, for
+    // lpmorph-metrics
+    juce::String metricsLabel;
+    MetricsPublisher metricsPublisher;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VoicemorphAudioProcessor)
 };
@@ -0,0 +1,310 @@
+#include "MappedWav.h"
+
+#if JUCE_MAC || JUCE_LINUX || JUCE_BSD
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
+namespace
+{
+const int formatPCM = 1;
+const int formatFloat = 3;
+const int formatExtensible = 0xfffe;
+// RIFF, WAVE, a JUNK chunk that becomes ds64 for RF64, fmt and data headers
+const int headerSize = 12 + 36 + 24 + 8;
+
+bool chunkIs(const char* id, const char* name)
+{
+    return memcmp(id, name, 4) == 0;
+}
+
+// madvise needs whole pages, so only pages entirely inside the range go
+void releasePages(const char* start, juce::int64 length, bool written)
+{
+   #if JUCE_MAC || JUCE_LINUX || JUCE_BSD
+    static const juce::int64 pageSize = sysconf(_SC_PAGESIZE);
+    auto first = (reinterpret_cast<juce::pointer_sized_int>(start) + pageSize - 1)/pageSize*pageSize;
+    auto last = (reinterpret_cast<juce::pointer_sized_int>(start) + length)/pageSize*pageSize;
+    if (last <= first) {
+        return;
+    }
+    auto* pages = reinterpret_cast<void*>(first);
+    if (written) {
+        msync(pages, static_cast<size_t>(last - first), MS_ASYNC);
+    }
+    // Shared file pages keep their contents in the page cache
+    madvise(pages, static_cast<size_t>(last - first), MADV_DONTNEED);
+   #else
+    // Left to the system's own paging
+    juce::ignoreUnused(start, length, written);
+   #endif
+}
+
+// Maps a byte range of the file and returns the address of its first byte
+template <typename Pointer>
+Pointer mapRange(std::unique_ptr<juce::MemoryMappedFile>& map, const juce::File& file, juce::int64 offset, juce::int64 length,
+                 juce::MemoryMappedFile::AccessMode mode)
+{
+    map = std::make_unique<juce::MemoryMappedFile>(file, juce::Range<juce::int64>(offset, offset + length), mode);
+    if (map->getData() == nullptr || map->getRange().getEnd() < offset + length) {
+        map.reset();
+        return nullptr;
+    }
+    // The mapping starts on a page boundary at or before the offset
+    return static_cast<Pointer>(map->getData()) + (offset - map->getRange().getStart());
+}
+}
+
+bool MappedWavReader::open(const juce::File& file, juce::String& error)
+{
+    map.reset();
+    data = nullptr;
+    floatData = nullptr;
+    lengthInSamples = 0;
+    juce::FileInputStream stream(file);
+    if (stream.failedToOpen()) {
+        error = "cannot open";
+        return false;
+    }
+    char riff[12];
+    if (stream.read(riff, 12) != 12 || !(chunkIs(riff, "RIFF") || chunkIs(riff, "RF64")) || !chunkIs(riff + 8, "WAVE")) {
+        error = "not a WAV file";
+        return false;
+    }
+    int format = 0;
+    juce::int64 ds64DataSize = -1;
+    juce::int64 dataOffset = -1;
+    juce::int64 dataSize = 0;
+    while (!stream.isExhausted()) {
+        char id[4];
+        if (stream.read(id, 4) != 4) {
+            break;
+        }
+        auto size = static_cast<juce::int64>(static_cast<juce::uint32>(stream.readInt()));
+        auto next = stream.getPosition() + size + (size & 1);
+        if (chunkIs(id, "ds64")) {
+            stream.readInt64();
+            ds64DataSize = stream.readInt64();
+        }
+        else if (chunkIs(id, "fmt ")) {
+            format = static_cast<juce::uint16>(stream.readShort());
+            numChannels = static_cast<juce::uint16>(stream.readShort());
+            sampleRate = static_cast<juce::uint32>(stream.readInt());
+            stream.readInt();
+            bytesPerFrame = static_cast<juce::uint16>(stream.readShort());
+            bitsPerSample = static_cast<juce::uint16>(stream.readShort());
+            if (format == formatExtensible && size >= 26) {
+                stream.skipNextBytes(8);
+                // The sub-format GUID starts with the format tag
+                format = static_cast<juce::uint16>(stream.readShort());
+            }
+        }
+        else if (chunkIs(id, "data")) {
+            dataOffset = stream.getPosition();
+            dataSize = size == 0xffffffff && ds64DataSize >= 0 ? ds64DataSize : size;
+            break;
+        }
+        stream.setPosition(next);
+    }
+    isFloat = format == formatFloat;
+    bool supported = (format == formatPCM && (bitsPerSample == 8 || bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32))
+                  || (isFloat && (bitsPerSample == 32 || bitsPerSample == 64));
+    if (!supported || numChannels <= 0 || bytesPerFrame != numChannels*bitsPerSample/8 || sampleRate <= 0.0) {
+        error = "not a PCM or float WAV file";
+        return false;
+    }
+    if (dataOffset < 0) {
+        error = "no audio data";
+        return false;
+    }
+    // Tolerates files cut short while they were written
+    dataSize = juce::jmin(dataSize, file.getSize() - dataOffset);
+    lengthInSamples = dataSize/bytesPerFrame;
+    if (lengthInSamples == 0) {
+        return true;
+    }
+    data = mapRange<const char*>(map, file, dataOffset, lengthInSamples*bytesPerFrame, juce::MemoryMappedFile::readOnly);
+    if (data == nullptr) {
+        error = "cannot map the file into memory";
+        return false;
+    }
+   #if JUCE_LITTLE_ENDIAN
+    if (isFloat && bitsPerSample == 32 && reinterpret_cast<juce::pointer_sized_int>(data) % alignof(float) == 0) {
+        floatData = reinterpret_cast<const float*>(data);
+    }
+   #endif
+    return true;
+}
+
+void MappedWavReader::read(juce::AudioBuffer<float>& dest, int destStart, juce::int64 startSample, int numSamples) const
+{
+    int numSilent = static_cast<int>(juce::jlimit<juce::int64>(0, numSamples, -startSample));
+    int numRead = static_cast<int>(juce::jlimit<juce::int64>(0, numSamples - numSilent, lengthInSamples - startSample - numSilent));
+    const int bytesPerSample = bitsPerSample/8;
+    for (int ch = 0; ch < dest.getNumChannels(); ch++) {
+        float* out = dest.getWritePointer(ch, destStart);
+        juce::FloatVectorOperations::clear(out, numSamples);
+        if (ch >= numChannels) {
+            continue;
+        }
+        out += numSilent;
+        const char* in = data + (startSample + numSilent)*bytesPerFrame + ch*bytesPerSample;
+        if (isFloat && bitsPerSample == 32) {
+            for (int i = 0; i < numRead; i++, in += bytesPerFrame) {
+                juce::uint32 bits = juce::ByteOrder::littleEndianInt(in);
+                memcpy(&out[i], &bits, sizeof(float));
+            }
+        }
+        else if (isFloat) {
+            for (int i = 0; i < numRead; i++, in += bytesPerFrame) {
+                juce::uint64 bits = juce::ByteOrder::littleEndianInt64(in);
+                double value;
+                memcpy(&value, &bits, sizeof(double));
+                out[i] = static_cast<float>(value);
+            }
+        }
+        else if (bitsPerSample == 8) {
+            for (int i = 0; i < numRead; i++, in += bytesPerFrame) {
+                out[i] = (static_cast<juce::uint8>(*in) - 128)*(1.0f/128.0f);
+            }
+        }
+        else if (bitsPerSample == 16) {
+            for (int i = 0; i < numRead; i++, in += bytesPerFrame) {
+                out[i] = static_cast<juce::int16>(juce::ByteOrder::littleEndianShort(in))*(1.0f/32768.0f);
+            }
+        }
+        else if (bitsPerSample == 24) {
+            for (int i = 0; i < numRead; i++, in += bytesPerFrame) {
+                out[i] = juce::ByteOrder::littleEndian24Bit(in)*(1.0f/8388608.0f);
+            }
+        }
+        else {
+            for (int i = 0; i < numRead; i++, in += bytesPerFrame) {
+                out[i] = static_cast<float>(static_cast<juce::int32>(juce::ByteOrder::littleEndianInt(in))*(1.0/2147483648.0));
+            }
+        }
+    }
+}
+
+void MappedWavReader::release(juce::int64 startSample, juce::int64 numSamples) const
+{
+    startSample = juce::jlimit<juce::int64>(0, lengthInSamples, startSample);
+    numSamples = juce::jlimit<juce::int64>(0, lengthInSamples - startSample, numSamples);
+    if (data != nullptr) {
+        releasePages(data + startSample*bytesPerFrame, numSamples*bytesPerFrame, false);
+    }
+}
+
+MappedWavWriter::~MappedWavWriter()
+{
+    close();
+}
+
+bool MappedWavWriter::create(const juce::File& file, double sampleRate, int channels, juce::int64 length, int bits, juce::String& error)
+{
+    close();
+    numChannels = channels;
+    bitsPerSample = bits;
+    bytesPerFrame = numChannels*bitsPerSample/8;
+    lengthInSamples = length;
+    const juce::int64 dataSize = lengthInSamples*bytesPerFrame;
+    const juce::int64 fileSize = headerSize + dataSize + (dataSize & 1);
+    // Sizes that do not fit the 32-bit RIFF fields go in a ds64 chunk
+    const bool rf64 = fileSize - 8 > 0xffffffff;
+
+    file.deleteFile();
+    {
+        juce::FileOutputStream stream(file);
+        if (stream.failedToOpen()) {
+            error = "cannot write " + file.getFullPathName();
+            return false;
+        }
+        stream.write(rf64 ? "RF64" : "RIFF", 4);
+        stream.writeInt(rf64 ? -1 : static_cast<int>(fileSize - 8));
+        stream.write("WAVE", 4);
+        stream.write(rf64 ? "ds64" : "JUNK", 4);
+        stream.writeInt(28);
+        stream.writeInt64(rf64 ? fileSize - 8 : 0);
+        stream.writeInt64(rf64 ? dataSize : 0);
+        stream.writeInt64(rf64 ? lengthInSamples : 0);
+        stream.writeInt(0);
+        stream.write("fmt ", 4);
+        stream.writeInt(16);
+        stream.writeShort(static_cast<short>(bitsPerSample == 32 ? formatFloat : formatPCM));
+        stream.writeShort(static_cast<short>(numChannels));
+        stream.writeInt(static_cast<int>(sampleRate));
+        stream.writeInt(static_cast<int>(sampleRate)*bytesPerFrame);
+        stream.writeShort(static_cast<short>(bytesPerFrame));
+        stream.writeShort(static_cast<short>(bitsPerSample));
+        stream.write("data", 4);
+        stream.writeInt(rf64 ? -1 : static_cast<int>(dataSize));
+        // Extends the file to its full size, leaving the samples to the mapping
+        if (dataSize > 0) {
+            stream.setPosition(fileSize - 1);
+            stream.writeByte(0);
+        }
+        stream.flush();
+        if (stream.getStatus().failed()) {
+            error = "cannot write " + file.getFullPathName() + ": " + stream.getStatus().getErrorMessage();
+            return false;
+        }
+    }
+    if (dataSize == 0) {
+        return true;
+    }
+    data = mapRange<char*>(map, file, headerSize, dataSize, juce::MemoryMappedFile::readWrite);
+    if (data == nullptr) {
+        error = "cannot map " + file.getFullPathName() + " into memory";
+        return false;
+    }
+   #if JUCE_LITTLE_ENDIAN
+    if (bitsPerSample == 32) {
+        floatData = reinterpret_cast<float*>(data);
+    }
+   #endif
+    return true;
+}
+
+void MappedWavWriter::write(const juce::AudioBuffer<float>& source, int sourceStart, juce::int64 startSample, int numSamples)
+{
+    const int bytesPerSample = bitsPerSample/8;
+    const double scale = bitsPerSample == 16 ? 32768.0 : 8388608.0;
+    for (int ch = 0; ch < numChannels; ch++) {
+        const float* in = source.getReadPointer(juce::jmin(ch, source.getNumChannels() - 1), sourceStart);
+        char* out = data + startSample*bytesPerFrame + ch*bytesPerSample;
+        for (int i = 0; i < numSamples; i++, out += bytesPerFrame) {
+            if (bitsPerSample == 32) {
+                juce::uint32 bits;
+                memcpy(&bits, &in[i], sizeof(float));
+                bits = juce::ByteOrder::swapIfBigEndian(bits);
+                memcpy(out, &bits, sizeof(bits));
+                continue;
+            }
+            auto value = static_cast<int>(juce::jlimit(-scale, scale - 1.0, std::round(in[i]*scale)));
+            if (bitsPerSample == 16) {
+                auto bits = juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint16>(value));
+                memcpy(out, &bits, sizeof(bits));
+            }
+            else {
+                juce::ByteOrder::littleEndian24BitToChars(value, out);
+            }
+        }
+    }
+}
+
+void MappedWavWriter::release(juce::int64 startSample, juce::int64 numSamples)
+{
+    startSample = juce::jlimit<juce::int64>(0, lengthInSamples, startSample);
+    numSamples = juce::jlimit<juce::int64>(0, lengthInSamples - startSample, numSamples);
+    if (data != nullptr) {
+        releasePages(data + startSample*bytesPerFrame, numSamples*bytesPerFrame, true);
+    }
+}
+
+void MappedWavWriter::close()
+{
+    // Unmapping leaves the written pages to the system to flush
+    map.reset();
+    data = nullptr;
+    floatData = nullptr;
+}
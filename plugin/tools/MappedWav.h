@@ -0,0 +1,76 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+using namespace juce;
+using namespace std;
+
+// PCM and float WAV files (RIFF or RF64) accessed through memory mapping, so
+// that the offline tools never hold more than the blocks they are working on.
+// Samples stay interleaved in the file: 32-bit float data is handed to the
+// engine in place as strided channels, and other formats are converted a
+// block at a time. Both classes are safe to use from several threads at
+// once as long as the threads work on different samples.
+class MappedWavReader
+{
+public:
+    bool open(const juce::File& file, juce::String& error);
+
+    double getSampleRate() const { return sampleRate; }
+    int getNumChannels() const { return numChannels; }
+    juce::int64 getLengthInSamples() const { return lengthInSamples; }
+
+    // The file's samples in place when they are 32-bit float, nullptr
+    // otherwise. Channel ch of sample i is at [i*getNumChannels() + ch].
+    const float* getFloatData() const { return floatData; }
+
+    // Converts numSamples of every channel from startSample on into dest,
+    // with silence outside the file
+    void read(juce::AudioBuffer<float>& dest, int destStart, juce::int64 startSample, int numSamples) const;
+
+    // Lets the system drop the pages holding these samples from memory, as
+    // they are not needed again soon. They are read back if they are.
+    void release(juce::int64 startSample, juce::int64 numSamples) const;
+
+private:
+    std::unique_ptr<juce::MemoryMappedFile> map;
+    const char* data = nullptr;
+    const float* floatData = nullptr;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    int bitsPerSample = 0;
+    int bytesPerFrame = 0;
+    bool isFloat = false;
+    juce::int64 lengthInSamples = 0;
+};
+
+class MappedWavWriter
+{
+public:
+    ~MappedWavWriter();
+
+    // Creates the file at its final size, 16 or 24-bit PCM or 32-bit float
+    bool create(const juce::File& file, double sampleRate, int numChannels, juce::int64 lengthInSamples, int bitsPerSample, juce::String& error);
+
+    // The file's samples in place for 32-bit float output, laid out as in
+    // MappedWavReader::getFloatData, nullptr otherwise
+    float* getFloatData() const { return floatData; }
+
+    // Converts numSamples of every channel of source into the file
+    void write(const juce::AudioBuffer<float>& source, int sourceStart, juce::int64 startSample, int numSamples);
+
+    // Starts writing these samples to disk and drops them from memory
+    void release(juce::int64 startSample, juce::int64 numSamples);
+
+    // Unmaps the file; the system writes out what is still in memory
+    void close();
+
+private:
+    std::unique_ptr<juce::MemoryMappedFile> map;
+    char* data = nullptr;
+    float* floatData = nullptr;
+    int numChannels = 0;
+    int bitsPerSample = 0;
+    int bytesPerFrame = 0;
+    juce::int64 lengthInSamples = 0;
+};
@@ -0,0 +1,132 @@
+#include "RenderContext.h"
+#include "ExcitationLoader.h"
+
+bool applyPresetSetting(const juce::String& setting, RenderPreset& preset, juce::String& error)
+{
+    auto key = setting.upToFirstOccurrenceOf("=", false, false).trim();
+    auto value = setting.fromFirstOccurrenceOf("=", false, false).trim();
+    if (key.isEmpty() || !setting.containsChar('=')) {
+        error = "expected parameterID = value, got \"" + setting + "\"";
+        return false;
+    }
+    auto& params = preset.parameters;
+    // Clamped to the ranges in ParameterHelper
+    if (key == "wetGain") {
+        params.wetGain = juce::jlimit(-40.f, 20.f, value.getFloatValue());
+    }
+    else if (key == "lpcMix") {
+        params.lpcMix = juce::jlimit(0.f, 1.f, value.getFloatValue());
+    }
+    else if (key == "exLen") {
+        params.exLen = juce::jlimit(0.0001f, 1.f, value.getFloatValue());
+    }
+    else if (key == "exStartPos") {
+        params.exStartPos = juce::jlimit(0.f, 1.f, value.getFloatValue());
+    }
+    else if (key == "exType") {
+        params.exType = juce::jlimit(0, 11, value.getIntValue());
+    }
+    else if (key == "lpcOrder") {
+        params.lpcOrder = juce::jlimit(1, MAX_ORDER, value.getIntValue());
+    }
+    else if (key == "frameDur") {
+        params.frameDur = juce::jlimit(0.1f, (float)MAX_FRAME_DUR, value.getFloatValue());
+    }
+    else if (key == "useSidechain") {
+        params.useSidechain = value.getIntValue() != 0 || value.equalsIgnoreCase("true");
+    }
+    else if (key == "excitation") {
+        preset.excitationFile = juce::File::getCurrentWorkingDirectory().getChildFile(value.unquoted());
+    }
+    else {
+        error = "unknown parameter \"" + key + "\"";
+        return false;
+    }
+    return true;
+}
+
+bool loadPreset(const juce::File& file, RenderPreset& preset, juce::String& error)
+{
+    if (!file.existsAsFile()) {
+        error = "preset " + file.getFullPathName() + " does not exist";
+        return false;
+    }
+    juce::StringArray lines;
+    file.readLines(lines);
+    for (int i = 0; i < lines.size(); i++) {
+        auto line = lines[i].upToFirstOccurrenceOf("#", false, false).trim();
+        if (line.isEmpty()) {
+            continue;
+        }
+        if (!applyPresetSetting(line, preset, error)) {
+            error = file.getFileName() + ":" + juce::String(i + 1) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+RenderContext::RenderContext(const RenderPreset& p) : preset(p)
+{
+    formatManager.registerBasicFormats();
+}
+
+bool RenderContext::prepareSampleRate(double sampleRate, juce::String& error)
+{
+    int key = juce::roundToInt(sampleRate);
+    if (excitations.count(key) > 0) {
+        return true;
+    }
+
+    // Factory tables are resampled in the background, as in the plugin; wait
+    // for them rather than render with the fallback
+    auto* entry = excitationCache->request(sampleRate);
+    auto deadline = juce::Time::getMillisecondCounter() + 60000;
+    while (!entry->ready.load(std::memory_order_acquire)) {
+        if (juce::Time::getMillisecondCounter() > deadline) {
+            error = "timed out resampling the factory excitations to " + juce::String(key) + " Hz";
+            return false;
+        }
+        juce::Thread::sleep(1);
+    }
+    const auto& factoryTables = excitationCache->getTables(entry);
+
+    LPCExcitation excitation;
+    excitation.numFactoryTables = static_cast<int>(factoryTables.size());
+    if (preset.excitationFile != juce::File()) {
+        auto& samples = customExcitations[key];
+        samples = ExcitationLoader::decodeFile(formatManager, preset.excitationFile, sampleRate);
+        if (samples.empty()) {
+            error = "cannot decode excitation " + preset.excitationFile.getFullPathName();
+            customExcitations.erase(key);
+            return false;
+        }
+        excitation.table = &samples;
+        excitation.custom = true;
+    }
+    else if (preset.parameters.exType >= 0 && preset.parameters.exType < excitation.numFactoryTables) {
+        excitation.table = &factoryTables[preset.parameters.exType];
+    }
+    excitations[key] = excitation;
+    return true;
+}
+
+LPCExcitation RenderContext::getExcitation(double sampleRate) const
+{
+    auto it = excitations.find(juce::roundToInt(sampleRate));
+    jassert(it != excitations.end());
+    return it != excitations.end() ? it->second : LPCExcitation();
+}
+
+void RenderContext::prepareEngine(LPCEngine& engine, double sampleRate) const
+{
+    auto excitation = getExcitation(sampleRate);
+    engine.prepare(sampleRate, preset.parameters, excitation);
+    engine.buildExcitationSegment(excitation.table, preset.parameters);
+    engine.lpc.beginBlock();
+}
+
+void RenderContext::beginBlock(LPCEngine& engine, double sampleRate) const
+{
+    engine.beginBlock(preset.parameters, getExcitation(sampleRate));
+}
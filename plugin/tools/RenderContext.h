@@ -0,0 +1,52 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "lpc_engine.h"
+#include "ExcitationCache.h"
+#include <map>
+
+using namespace juce;
+using namespace std;
+
+// Plugin parameters for an offline render, read from "parameterID = value"
+// lines using the plugin's parameter IDs. Anything not given keeps the
+// plugin's default. "excitation = <file>" selects a custom excitation.
+struct RenderPreset {
+    LPCParameters parameters;
+    juce::File excitationFile;
+};
+
+bool applyPresetSetting(const juce::String& setting, RenderPreset& preset, juce::String& error);
+bool loadPreset(const juce::File& file, RenderPreset& preset, juce::String& error);
+
+// Sets up LPCEngine instances the way VoicemorphAudioProcessor does in a
+// host, with the same excitation tables, so that offline renders match the
+// plugin sample for sample at block sizes that are multiples of the hop.
+class RenderContext
+{
+public:
+    explicit RenderContext(const RenderPreset& preset);
+
+    const RenderPreset& getPreset() const { return preset; }
+    // Between blocks, for parameters other than exType; a different
+    // excitation needs a new context
+    void setParameters(const LPCParameters& parameters) { preset.parameters = parameters; }
+
+    // Builds the excitations for a sample rate, waiting for the resampled
+    // factory tables. Call for every rate before rendering at it.
+    bool prepareSampleRate(double sampleRate, juce::String& error);
+
+    // Safe from any number of threads once the rate is prepared
+    LPCExcitation getExcitation(double sampleRate) const;
+    // Mirrors prepareToPlay
+    void prepareEngine(LPCEngine& engine, double sampleRate) const;
+    // Mirrors the parameter update at the start of processBlock
+    void beginBlock(LPCEngine& engine, double sampleRate) const;
+
+private:
+    RenderPreset preset;
+    juce::SharedResourcePointer<ExcitationCache> excitationCache;
+    juce::AudioFormatManager formatManager;
+    std::map<int, LPCExcitation> excitations;
+    std::map<int, vector<double>> customExcitations;
+};
@@ -0,0 +1,663 @@
+// Renders audio files offline through the LP Morph engine. Files, and
+// segments of long files, are spread over worker threads that each own an
+// engine.
+//
+//   lpmorph-render [options] <file | directory | pattern>...
+//
+// Where a hop's output starts within its block depends on the block size,
+// unless the block size is a multiple of the hop: those all render alike, and
+// as the plugin does at any such host block size. -b is rounded up to one.
+//
+// Segments start on hop boundaries. Each segment engine is seeked to the
+// segment's start: the input history and the excitation position are restored
+// exactly, by counting the frames that would have been synthesised before it.
+// What cannot be restored is the memory of the lattice synthesis filter, so
+// every segment is preceded by a pre-roll of --preroll synthesised frames
+// whose output is discarded. Silent frames are skipped by the engine and do
+// not count towards it.
+//
+// The remaining difference from a sequential render is the filter's response
+// to its missing initial state, which decays with every synthesised frame. In
+// our tests the maximum difference falls by about an order of magnitude every
+// two frames: around 1e-4 after 8 frames, 1e-6 after 16, and none at all in
+// float output from 32 frames on, at any order. The default of 64 frames
+// leaves a wide margin; filters held at the reflection coefficient clamp
+// decay slowest. --verify renders each file sequentially as well and reports
+// the actual maximum difference, in blocks a hop longer than -b so that their
+// boundaries fall elsewhere than the render's and the segments'.
+//
+// Files are read and written through memory mapping (MappedWav). 32-bit float
+// samples go from the input mapping through the engine into the output
+// mapping without intermediate copies, other formats are converted a block at
+// a time, and pages behind the render are released as it goes, so resident
+// memory stays flat however long the files. Segments write straight into
+// their part of the preallocated output. Inputs in other formats JUCE can
+// read are first decoded into a temporary float WAV.
+//
+// --two-pass renders each file whole instead, bit-exact: every frame's
+// reflection coefficients and gain are analysed in parallel first, then a
+// single engine synthesises from them. Analysis is about half the per-frame
+// work, so this roughly halves the sequential time of a file; the track takes
+// ORDER*8 bytes per hop and channel, about 60 MB per channel-hour at order 25.
+
+#include <JuceHeader.h>
+#include "RenderContext.h"
+#include "MappedWav.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Segment {
+    juce::int64 start = 0;
+    juce::int64 end = 0;
+    // Where rendering starts, pre-roll included
+    juce::int64 preRollStart = 0;
+    // Per channel, frames synthesised before preRollStart
+    std::vector<long long> activeFrames;
+};
+
+struct RenderJob {
+    juce::File input;
+    juce::File output;
+    // A float WAV decoded from an input in another format, deleted at the end
+    juce::File decoded;
+    MappedWavReader reader;
+    MappedWavWriter writer;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    juce::int64 lengthInSamples = 0;
+    int frameLength = 0;
+    int hopSize = 0;
+    std::vector<Segment> segments;
+    // Per channel and hop, whether the frame ending at hop*hopSize has energy
+    std::vector<std::vector<char>> activity;
+    // Per channel, for two-pass rendering
+    std::vector<LPCCoefficientTrack> tracks;
+
+    std::atomic<int> segmentsLeft{0};
+    // Summed over the rendered part of every segment, and the analysis
+    DSPDiagnostics diagnostics;
+    std::atomic<bool> failed{false};
+    std::mutex lock;
+    juce::String error;
+    Clock::time_point started = Clock::time_point::max();
+    Clock::time_point finished = Clock::time_point::min();
+
+    void fail(const juce::String& message)
+    {
+        const std::lock_guard<std::mutex> sl(lock);
+        if (!failed.exchange(true)) {
+            error = message;
+        }
+    }
+};
+
+struct RenderOptions {
+    juce::File outputDir;
+    int numThreads = 0;
+    int numSegments = 0;
+    int preRollFrames = 64;
+    int blockSize = 512;
+    int bitsPerSample = 32;
+    bool twoPass = false;
+    bool verify = false;
+};
+
+// Everything a worker thread owns
+struct Worker {
+    explicit Worker(int maxChannels) : engine(maxChannels) {}
+    LPCEngine engine;
+    juce::AudioBuffer<float> buffer;
+};
+
+std::mutex printLock;
+
+void printUsage()
+{
+    std::cout << "usage: lpmorph-render [options] <file | directory | pattern>...\n"
+                 "  -p, --preset FILE      parameters, one \"parameterID = value\" per line\n"
+                 "  -s, --set ID=VALUE     set one parameter, after the preset\n"
+                 "  -o, --output DIR       output folder (default: next to each input)\n"
+                 "  -j, --threads N        worker threads (default: one per core)\n"
+                 "      --segments N       split each file into N segments rendered in\n"
+                 "                         parallel (default: enough to use every thread)\n"
+                 "      --preroll N        synthesised frames of pre-roll per segment (default: 64)\n"
+                 "      --two-pass         analyse every frame in parallel, then synthesise each\n"
+                 "                         file whole; exact, instead of segments\n"
+                 "  -b, --block N          block size in samples, rounded up to a multiple of the\n"
+                 "                         hop; the output matches the plugin's at host block\n"
+                 "                         sizes that are multiples of the hop (default: 512)\n"
+                 "      --bits 16|24|32    output format, 32 is float (default: 32)\n"
+                 "      --verify           also render sequentially, in blocks a hop longer than\n"
+                 "                         -b, and report the difference\n";
+}
+
+// Directories contribute their WAV files, and arguments with wildcards are
+// matched in their parent directory, for shells that do not expand them
+void collectInputs(const juce::String& arg, juce::Array<juce::File>& inputs)
+{
+    auto path = juce::File::getCurrentWorkingDirectory().getChildFile(arg);
+    if (path.isDirectory()) {
+        auto found = path.findChildFiles(juce::File::findFiles, false, "*.wav;*.WAV");
+        found.sort();
+        inputs.addArray(found);
+    }
+    else if (arg.containsAnyOf("*?")) {
+        auto found = path.getParentDirectory().findChildFiles(juce::File::findFiles, false, path.getFileName());
+        found.sort();
+        inputs.addArray(found);
+    }
+    else {
+        inputs.add(path);
+    }
+}
+
+template <typename Task>
+void runParallel(int numThreads, size_t numTasks, Task&& task)
+{
+    std::atomic<size_t> nextTask{0};
+    std::vector<std::thread> threads;
+    for (int w = 0; w < numThreads; w++) {
+        threads.emplace_back([&, w] {
+            // The plugin renders with denormals flushed, and so must we to match it
+            juce::ScopedNoDenormals noDenormals;
+            for (size_t i = nextTask++; i < numTasks; i = nextTask++) {
+                task(i, w);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Formats other than PCM and float WAV are decoded into a temporary float
+// WAV next to the output first
+bool decodeToWav(juce::AudioFormatManager& formatManager, RenderJob& job, juce::String& error)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(job.input));
+    if (reader == nullptr) {
+        error = "cannot read input";
+        return false;
+    }
+    job.decoded = job.output.getSiblingFile(job.output.getFileNameWithoutExtension() + ".decoded.wav");
+    MappedWavWriter writer;
+    if (!writer.create(job.decoded, reader->sampleRate, static_cast<int>(reader->numChannels), reader->lengthInSamples, 32, error)) {
+        return false;
+    }
+    const int blockSize = 1 << 16;
+    juce::AudioBuffer<float> buffer(static_cast<int>(reader->numChannels), blockSize);
+    for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += blockSize) {
+        int numSamples = static_cast<int>(juce::jmin<juce::int64>(blockSize, reader->lengthInSamples - pos));
+        reader->read(&buffer, 0, numSamples, pos, true, true);
+        writer.write(buffer, 0, pos, numSamples);
+        writer.release(pos, numSamples);
+    }
+    writer.close();
+    return job.reader.open(job.decoded, error);
+}
+
+// Hops are numbered from 1; hop j analyses the frame that ends at j*hopSize.
+// Calls frameFn(ch, hop, frame) for every channel of hops firstHop to lastHop,
+// with the worker's engine prepared for the file.
+template <typename FrameFn>
+void forEachFrame(RenderJob& job, juce::int64 firstHop, juce::int64 lastHop, const RenderContext& context, Worker& worker, FrameFn&& frameFn)
+{
+    context.prepareEngine(worker.engine, job.sampleRate);
+    const int hopsPerChunk = 256;
+    worker.buffer.setSize(job.numChannels, job.frameLength + hopsPerChunk*job.hopSize, false, false, true);
+    for (juce::int64 hop = firstHop; hop <= lastHop; hop += hopsPerChunk) {
+        int numHops = static_cast<int>(juce::jmin<juce::int64>(hopsPerChunk, lastHop - hop + 1));
+        juce::int64 from = hop*job.hopSize - job.frameLength;
+        job.reader.read(worker.buffer, 0, from, job.frameLength + (numHops - 1)*job.hopSize);
+        for (int ch = 0; ch < job.numChannels; ch++) {
+            const float* samples = worker.buffer.getReadPointer(ch);
+            for (int h = 0; h < numHops; h++) {
+                frameFn(ch, hop + h, samples + h*job.hopSize);
+            }
+        }
+        job.reader.release(from, numHops*job.hopSize);
+    }
+}
+
+void findActiveFrames(RenderJob& job, int k, const RenderContext& context, Worker& worker)
+{
+    forEachFrame(job, job.segments[k].start/job.hopSize + 1, job.segments[k + 1].start/job.hopSize, context, worker,
+                 [&](int ch, juce::int64 hop, const float* frame) {
+        job.activity[ch][hop] = worker.engine.lpc.isActiveFrame(frame) ? 1 : 0;
+    });
+}
+
+const juce::int64 hopsPerAnalysisTask = 4096;
+
+void analyseFrames(RenderJob& job, int task, const RenderContext& context, Worker& worker)
+{
+    juce::int64 numHops = static_cast<juce::int64>(job.tracks[0].gains.size());
+    juce::int64 firstHop = task*hopsPerAnalysisTask + 1;
+    DSPDiagnostics::Snapshot before;
+    worker.engine.lpc.diagnostics.read(before);
+    forEachFrame(job, firstHop, juce::jmin(numHops, firstHop + hopsPerAnalysisTask - 1), context, worker,
+                 [&](int ch, juce::int64 hop, const float* frame) {
+        auto& track = job.tracks[ch];
+        juce::int64 i = hop - 1;
+        track.active[i] = worker.engine.lpc.analyseFrame(frame, track.reflection.data() + i*track.order, track.gains[i]) ? 1 : 0;
+    });
+    DSPDiagnostics::Snapshot counts;
+    worker.engine.lpc.diagnostics.read(counts);
+    job.diagnostics.add(counts.since(before));
+}
+
+// Walks back from each segment start until every channel has seen the
+// pre-roll's worth of synthesised frames, and counts the frames before that
+void placePreRolls(RenderJob& job, int preRollFrames)
+{
+    for (size_t k = 1; k < job.segments.size(); k++) {
+        auto& segment = job.segments[k];
+        juce::int64 hop = segment.start/job.hopSize;
+        std::vector<int> seen(job.numChannels, 0);
+        auto settled = [&] {
+            // The overlap-add buffer and the dry signal also need a frame and a hop
+            if (segment.start - hop*job.hopSize < job.frameLength + job.hopSize) {
+                return false;
+            }
+            for (int count : seen) {
+                if (count < preRollFrames) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        while (hop > 0 && !settled()) {
+            for (int ch = 0; ch < job.numChannels; ch++) {
+                seen[ch] += job.activity[ch][hop];
+            }
+            hop--;
+        }
+        segment.preRollStart = hop*job.hopSize;
+        segment.activeFrames.assign(job.numChannels, 0);
+        for (int ch = 0; ch < job.numChannels; ch++) {
+            for (juce::int64 j = 1; j <= hop; j++) {
+                segment.activeFrames[ch] += job.activity[ch][j];
+            }
+        }
+    }
+}
+
+// How far a render gets before the pages behind it are released
+const juce::int64 samplesPerRelease = 1 << 16;
+
+void renderSegment(RenderJob& job, int k, const RenderContext& context, Worker& worker, const RenderOptions& options)
+{
+    auto& segment = job.segments[k];
+    auto started = Clock::now();
+    auto& engine = worker.engine;
+    auto& buffer = worker.buffer;
+    buffer.setSize(job.numChannels, juce::jmax(options.blockSize, job.frameLength), false, false, true);
+    context.prepareEngine(engine, job.sampleRate);
+    for (int ch = 0; ch < job.numChannels; ch++) {
+        engine.lpc.setCoefficientTrack(ch, job.tracks.empty() ? nullptr : &job.tracks[ch]);
+    }
+    if (segment.preRollStart > 0) {
+        int historyLength = static_cast<int>(juce::jmin<juce::int64>(job.frameLength, segment.preRollStart));
+        job.reader.read(buffer, 0, segment.preRollStart - historyLength, historyLength);
+        for (int ch = 0; ch < job.numChannels; ch++) {
+            engine.lpc.seek(ch, buffer.getReadPointer(ch), historyLength, segment.activeFrames[ch]);
+        }
+    }
+    // Float files are read and written in place, as interleaved channels
+    const float* input = job.reader.getFloatData();
+    float* output = job.writer.getFloatData();
+    const int stride = job.numChannels;
+    juce::int64 releasedTo = segment.preRollStart;
+    DSPDiagnostics::Snapshot before;
+    for (juce::int64 pos = segment.preRollStart; pos < segment.end;) {
+        // Blocks break at the segment start, so the pre-roll is discarded whole.
+        // Both are on hops and blocks are whole hops, so every block starts on
+        // a hop, as in a sequential render.
+        jassert(pos % job.hopSize == 0);
+        juce::int64 blockEnd = pos < segment.start ? segment.start : segment.end;
+        int numSamples = static_cast<int>(juce::jmin<juce::int64>(options.blockSize, blockEnd - pos));
+        bool writing = pos >= segment.start;
+        bool writeInPlace = writing && output != nullptr;
+        if (input == nullptr) {
+            job.reader.read(buffer, 0, pos, numSamples);
+        }
+        // What the pre-roll counts is discarded with its output
+        if (pos == segment.start) {
+            engine.lpc.diagnostics.read(before);
+        }
+        context.beginBlock(engine, job.sampleRate);
+        for (int ch = 0; ch < job.numChannels; ch++) {
+            const float* in = input != nullptr ? input + pos*stride + ch : buffer.getReadPointer(ch);
+            float* out = writeInPlace ? output + pos*stride + ch : buffer.getWritePointer(ch);
+            engine.processChannel(in, out, numSamples, ch, nullptr, input != nullptr ? stride : 1, writeInPlace ? stride : 1);
+        }
+        engine.endBlock();
+        if (writing && !writeInPlace) {
+            job.writer.write(buffer, 0, pos, numSamples);
+        }
+        pos += numSamples;
+        // Nothing behind the render is needed again, so resident memory
+        // stays flat however long the file
+        if (pos - releasedTo >= samplesPerRelease || pos == segment.end) {
+            job.reader.release(releasedTo, pos - releasedTo);
+            juce::int64 written = juce::jmax(releasedTo, segment.start);
+            job.writer.release(written, pos - written);
+            releasedTo = pos;
+        }
+    }
+
+    DSPDiagnostics::Snapshot counts;
+    engine.lpc.diagnostics.read(counts);
+    job.diagnostics.add(counts.since(before));
+
+    const std::lock_guard<std::mutex> sl(job.lock);
+    job.started = juce::jmin(job.started, started);
+    job.finished = juce::jmax(job.finished, Clock::now());
+}
+
+void printJob(RenderJob& job)
+{
+    const std::lock_guard<std::mutex> lock(printLock);
+    if (job.failed) {
+        std::cerr << job.input.getFullPathName() << ": " << job.error << std::endl;
+        return;
+    }
+    double audioSeconds = job.lengthInSamples/job.sampleRate;
+    double renderSeconds = std::chrono::duration<double>(job.finished - job.started).count();
+    std::cout << job.output.getFileName() << ": " << juce::String(audioSeconds, 2) << " s in "
+              << juce::String(renderSeconds, 2) << " s ("
+              << juce::String(audioSeconds/juce::jmax(renderSeconds, 1e-9), 1) << "x real time";
+    if (job.segments.size() > 1) {
+        std::cout << ", " << job.segments.size() << " segments";
+    }
+    std::cout << ")";
+    DSPDiagnostics::Snapshot counts;
+    job.diagnostics.read(counts);
+    for (int c = 0; c < DSPDiagnostics::numCounters; c++) {
+        auto counter = static_cast<DSPDiagnostics::Counter>(c);
+        // Silent frames and loop wraps are part of normal rendering
+        if (counts[counter] > 0 && counter != DSPDiagnostics::zeroEnergyFrames && counter != DSPDiagnostics::excitationWraps) {
+            std::cout << ", " << counts[counter] << " " << DSPDiagnostics::label(counter);
+        }
+    }
+    std::cout << std::endl;
+}
+
+// Renders the whole file on one engine and compares it with the output, in
+// blocks of another size, which must not change the result
+void verifyJob(RenderJob& job, const RenderContext& context, Worker& worker, const RenderOptions& options)
+{
+    const int blockSize = options.blockSize + job.hopSize;
+    MappedWavReader output;
+    juce::String error;
+    if (!output.open(job.output, error)) {
+        std::cerr << job.output.getFileName() << ": cannot verify, " << error << std::endl;
+        return;
+    }
+    juce::AudioBuffer<float> rendered(job.numChannels, blockSize);
+    worker.buffer.setSize(job.numChannels, blockSize, false, false, true);
+    context.prepareEngine(worker.engine, job.sampleRate);
+    for (int ch = 0; ch < job.numChannels; ch++) {
+        worker.engine.lpc.setCoefficientTrack(ch, nullptr);
+    }
+    double maxDifference = 0.0;
+    juce::int64 maxAt = 0;
+    for (juce::int64 pos = 0; pos < job.lengthInSamples; pos += blockSize) {
+        int numSamples = static_cast<int>(juce::jmin<juce::int64>(blockSize, job.lengthInSamples - pos));
+        job.reader.read(worker.buffer, 0, pos, numSamples);
+        output.read(rendered, 0, pos, numSamples);
+        context.beginBlock(worker.engine, job.sampleRate);
+        for (int ch = 0; ch < job.numChannels; ch++) {
+            worker.engine.processChannel(worker.buffer.getReadPointer(ch), worker.buffer.getWritePointer(ch), numSamples, ch, nullptr);
+            const float* expected = worker.buffer.getReadPointer(ch);
+            const float* actual = rendered.getReadPointer(ch);
+            for (int i = 0; i < numSamples; i++) {
+                double difference = std::abs(static_cast<double>(expected[i]) - actual[i]);
+                if (difference > maxDifference) {
+                    maxDifference = difference;
+                    maxAt = pos + i;
+                }
+            }
+        }
+        worker.engine.endBlock();
+    }
+    std::cout << job.output.getFileName() << ": ";
+    if (maxDifference == 0.0) {
+        std::cout << "identical to the sequential render" << std::endl;
+    }
+    else {
+        std::cout << "max difference from the sequential render " << juce::String(juce::Decibels::gainToDecibels(maxDifference), 1)
+                  << " dBFS at sample " << maxAt << std::endl;
+    }
+}
+}
+
+int main(int argc, char* argv[])
+{
+    RenderPreset preset;
+    RenderOptions options;
+    juce::Array<juce::File> inputs;
+    juce::String error;
+
+    for (int i = 1; i < argc; i++) {
+        juce::String arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if ((arg == "-p" || arg == "--preset") && hasValue) {
+            if (!loadPreset(juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]), preset, error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        }
+        else if ((arg == "-s" || arg == "--set") && hasValue) {
+            if (!applyPresetSetting(argv[++i], preset, error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        }
+        else if ((arg == "-o" || arg == "--output") && hasValue) {
+            options.outputDir = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+        }
+        else if ((arg == "-j" || arg == "--threads") && hasValue) {
+            options.numThreads = juce::String(argv[++i]).getIntValue();
+        }
+        else if (arg == "--segments" && hasValue) {
+            options.numSegments = juce::jmax(0, juce::String(argv[++i]).getIntValue());
+        }
+        else if (arg == "--preroll" && hasValue) {
+            options.preRollFrames = juce::jmax(0, juce::String(argv[++i]).getIntValue());
+        }
+        else if ((arg == "-b" || arg == "--block") && hasValue) {
+            options.blockSize = juce::jlimit(1, 1 << 16, juce::String(argv[++i]).getIntValue());
+        }
+        else if (arg == "--bits" && hasValue) {
+            options.bitsPerSample = juce::String(argv[++i]).getIntValue();
+        }
+        else if (arg == "--two-pass") {
+            options.twoPass = true;
+        }
+        else if (arg == "--verify") {
+            options.verify = true;
+        }
+        else if (arg.startsWith("-")) {
+            printUsage();
+            return 1;
+        }
+        else {
+            collectInputs(arg, inputs);
+        }
+    }
+    if (inputs.isEmpty()) {
+        printUsage();
+        return 1;
+    }
+    if (options.bitsPerSample != 16 && options.bitsPerSample != 24 && options.bitsPerSample != 32) {
+        std::cerr << "--bits must be 16, 24 or 32" << std::endl;
+        return 1;
+    }
+    if (options.outputDir != juce::File() && !options.outputDir.createDirectory()) {
+        std::cerr << "cannot create " << options.outputDir.getFullPathName() << std::endl;
+        return 1;
+    }
+    int numThreads = options.numThreads > 0 ? options.numThreads : static_cast<int>(std::thread::hardware_concurrency());
+    numThreads = juce::jmax(1, numThreads);
+
+    // Read every header up front, so that excitations are ready for each
+    // sample rate and engines are sized for the widest file
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    RenderContext context(preset);
+    std::vector<std::unique_ptr<RenderJob>> jobs;
+    int numUnreadable = 0;
+    int maxChannels = 1;
+    for (auto& input : inputs) {
+        auto job = std::make_unique<RenderJob>();
+        job->input = input;
+        auto folder = options.outputDir != juce::File() ? options.outputDir : input.getParentDirectory();
+        job->output = folder.getChildFile(input.getFileNameWithoutExtension() + "_lpmorph.wav");
+        if (!job->reader.open(input, error) && !decodeToWav(formatManager, *job, error)) {
+            job->fail(error);
+            job->decoded.deleteFile();
+            printJob(*job);
+            numUnreadable++;
+            continue;
+        }
+        job->sampleRate = job->reader.getSampleRate();
+        job->numChannels = job->reader.getNumChannels();
+        job->lengthInSamples = job->reader.getLengthInSamples();
+        if (!context.prepareSampleRate(job->sampleRate, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        maxChannels = juce::jmax(maxChannels, job->numChannels);
+        jobs.push_back(std::move(job));
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int w = 0; w < numThreads; w++) {
+        workers.push_back(std::make_unique<Worker>(maxChannels));
+    }
+
+    // Split files into hop-aligned segments, by default into as many as it
+    // takes to give every thread work, but never shorter than a few pre-rolls
+    std::vector<std::pair<RenderJob*, int>> analysisTasks;
+    std::vector<std::pair<RenderJob*, int>> renderTasks;
+    for (auto& job : jobs) {
+        context.prepareEngine(workers[0]->engine, job->sampleRate);
+        job->frameLength = workers[0]->engine.lpc.FRAMELEN;
+        job->hopSize = workers[0]->engine.lpc.HOPSIZE;
+        if (options.blockSize % job->hopSize != 0) {
+            options.blockSize = (options.blockSize/job->hopSize + 1)*job->hopSize;
+            std::cerr << "block size rounded up to " << options.blockSize << ", a multiple of the hop" << std::endl;
+        }
+        int numSegments = options.numSegments > 0 ? options.numSegments : juce::jmax(1, numThreads/static_cast<int>(jobs.size()));
+        if (options.twoPass) {
+            numSegments = 1;
+            juce::int64 numHops = job->lengthInSamples/job->hopSize;
+            job->tracks.resize(job->numChannels);
+            for (auto& track : job->tracks) {
+                track.resize(numHops, workers[0]->engine.lpc.ORDER);
+            }
+            for (juce::int64 task = 0; task*hopsPerAnalysisTask < numHops; task++) {
+                analysisTasks.emplace_back(job.get(), static_cast<int>(task));
+            }
+        }
+        juce::int64 minLength = 4*(juce::jmax(1, options.preRollFrames) + 2)*static_cast<juce::int64>(job->hopSize);
+        numSegments = static_cast<int>(juce::jlimit<juce::int64>(1, juce::jmax<juce::int64>(1, job->lengthInSamples/minLength), numSegments));
+        for (int k = 0; k < numSegments; k++) {
+            Segment segment;
+            segment.start = job->lengthInSamples*k/numSegments/job->hopSize*job->hopSize;
+            segment.end = k + 1 < numSegments ? job->lengthInSamples*(k + 1)/numSegments/job->hopSize*job->hopSize : job->lengthInSamples;
+            job->segments.push_back(segment);
+            renderTasks.emplace_back(job.get(), k);
+            if (k + 1 < numSegments) {
+                analysisTasks.emplace_back(job.get(), k);
+            }
+        }
+        job->segmentsLeft = numSegments;
+        // Segments write straight into their part of the output
+        if (!job->writer.create(job->output, job->sampleRate, job->numChannels, job->lengthInSamples, options.bitsPerSample, error)) {
+            job->fail(error);
+        }
+        if (numSegments > 1) {
+            job->activity.assign(job->numChannels, std::vector<char>(job->segments.back().start/job->hopSize + 1, 0));
+        }
+    }
+
+    auto start = Clock::now();
+    // Finding which frames have energy is a small fraction of the render and
+    // parallel too; only placing the pre-rolls runs on one thread
+    runParallel(numThreads, analysisTasks.size(), [&](size_t i, int w) {
+        auto& job = *analysisTasks[i].first;
+        if (!job.tracks.empty()) {
+            analyseFrames(job, analysisTasks[i].second, context, *workers[w]);
+        }
+        else {
+            findActiveFrames(job, analysisTasks[i].second, context, *workers[w]);
+        }
+    });
+    for (auto& job : jobs) {
+        if (job->segments.size() > 1 && !job->failed) {
+            placePreRolls(*job, options.preRollFrames);
+        }
+    }
+    runParallel(numThreads, renderTasks.size(), [&](size_t i, int w) {
+        auto& job = *renderTasks[i].first;
+        if (!job.failed) {
+            renderSegment(job, renderTasks[i].second, context, *workers[w], options);
+        }
+        if (--job.segmentsLeft == 0) {
+            job.writer.close();
+            if (job.failed) {
+                job.output.deleteFile();
+            }
+            job.tracks.clear();
+            job.tracks.shrink_to_fit();
+            printJob(job);
+        }
+    });
+    double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double audioSeconds = 0.0;
+    int numFailed = numUnreadable;
+    for (auto& job : jobs) {
+        if (job->failed) {
+            numFailed++;
+        }
+        else {
+            audioSeconds += job->lengthInSamples/job->sampleRate;
+        }
+    }
+    std::cout << inputs.size() - numFailed << " of " << inputs.size() << " files, " << juce::String(audioSeconds, 2)
+              << " s of audio in " << juce::String(wallSeconds, 2) << " s on " << numThreads << " threads ("
+              << juce::String(audioSeconds/juce::jmax(wallSeconds, 1e-9), 1) << "x real time)" << std::endl;
+
+    if (options.verify) {
+        juce::ScopedNoDenormals noDenormals;
+        for (auto& job : jobs) {
+            if (!job->failed) {
+                verifyJob(*job, context, *workers[0], options);
+            }
+        }
+    }
+    // Decoded copies go once nothing maps them any more
+    juce::Array<juce::File> decoded;
+    for (auto& job : jobs) {
+        decoded.add(job->decoded);
+    }
+    jobs.clear();
+    for (auto& file : decoded) {
+        file.deleteFile();
+    }
+    return numFailed > 0 ? 1 : 0;
+}
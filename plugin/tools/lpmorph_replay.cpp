@@ -0,0 +1,413 @@
+// Replays a session captured by the plugin (see session_capture.h) through
+// the engine offline, block by block with the block sizes, parameters, MIDI
+// and excitation loop of the session, and checks that every block's output
+// matches the capture. A block that was slow in the host can then be
+// reproduced, profiled and compared before and after a change.
+//
+//   lpmorph-replay [options] <capture.lpcap>
+//
+//   --repeat N             replay the session N times, keeping each block's
+//                          fastest time (default: 1)
+//   --slowest N            blocks listed, slowest first (default: 10)
+//   --json FILE            also write the results as JSON
+//   --trace FILE           also write a Chrome trace of the replay's spans
+//
+// Blocks after dropped ones, and blocks rendered with a custom excitation,
+// which a capture does not hold, are replayed but not expected to match.
+// Captured times are the host's, including whatever else it ran on the
+// audio thread's core; replayed times are the engine's alone.
+
+#include <JuceHeader.h>
+#include "ExcitationCache.h"
+#include "session_capture.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct BlockResult {
+    int index = 0;
+    SessionBlock info;
+    double replayUs = 0.0;
+    double capturedUs = 0.0;
+    bool matched = true;
+};
+
+struct Summary {
+    int blocks = 0;
+    int mismatches = 0;
+    int unreliable = 0;
+    int firstMismatch = -1;
+    double replayMeanUs = 0.0;
+    double replayP99Us = 0.0;
+    double replayMaxUs = 0.0;
+    double capturedMeanUs = 0.0;
+    double capturedP99Us = 0.0;
+    double capturedMaxUs = 0.0;
+};
+
+// Whether a replay is expected to match this block bit for bit
+bool isReproducible(const SessionBlock& block)
+{
+    return (block.flags & (SessionBlock::afterGap | SessionBlock::customExcitation)) == 0;
+}
+
+// Mirrors the MIDI handling in processBlock
+void applyMidi(LPC& lpc, const SessionBlock& block)
+{
+    for (const auto& event : block.midi) {
+        auto message = juce::MidiMessage(event.data, event.size);
+        if (message.isNoteOn()) {
+            lpc.voices.noteOn(message.getNoteNumber(), message.getFloatVelocity());
+        }
+        else if (message.isNoteOff()) {
+            lpc.voices.noteOff(message.getNoteNumber());
+        }
+        else if (message.isAllNotesOff() || message.isAllSoundOff()) {
+            lpc.voices.allNotesOff();
+        }
+    }
+}
+
+// Mirrors resolveExcitation in the plugin for the tables a block read
+LPCExcitation resolveExcitation(const SessionBlock& block, const vector<vector<double>>& tables)
+{
+    LPCExcitation excitation;
+    excitation.numFactoryTables = static_cast<int>(tables.size());
+    excitation.custom = (block.flags & SessionBlock::customExcitation) != 0;
+    if (block.parameters.exType >= 0 && block.parameters.exType < excitation.numFactoryTables) {
+        excitation.table = &tables[block.parameters.exType];
+    }
+    return excitation;
+}
+
+class Replay
+{
+public:
+    Replay()
+    {
+        scratch.resize(2);
+    }
+
+    bool run(const juce::String& path, std::vector<BlockResult>& results, bool firstRun, juce::String& error)
+    {
+        SessionReader reader;
+        std::string readError;
+        if (!reader.open(path.toStdString(), readError)) {
+            error = juce::String(readError);
+            return false;
+        }
+        const double sampleRate = reader.getSampleRate();
+        const auto* entry = excitationCache->request(sampleRate);
+        auto deadline = juce::Time::getMillisecondCounter() + 60000;
+        while (!entry->ready.load(std::memory_order_acquire)) {
+            if (juce::Time::getMillisecondCounter() > deadline) {
+                error = "timed out resampling the factory excitations to " + juce::String(sampleRate) + " Hz";
+                return false;
+            }
+            juce::Thread::sleep(1);
+        }
+        const auto& resampledTables = excitationCache->getTables(entry);
+        const auto& nativeTables = excitationCache->getNativeTables();
+
+        // Mirrors the constructor and prepareToPlay. The plugin's first
+        // segment is replaced before the first block anyway.
+        const auto& prepareParameters = reader.getPrepareParameters();
+        LPCEngine engine(reader.getNumChannels());
+        engine.lpc.noise = &nativeTables[6];
+        engine.lpc.trace = trace;
+        SessionBlock block;
+        block.parameters = prepareParameters;
+        auto excitation = resolveExcitation(block, resampledTables);
+        engine.prepare(sampleRate, prepareParameters, excitation);
+        engine.buildExcitationSegment(excitation.table, prepareParameters);
+        engine.lpc.beginBlock();
+
+        for (auto& channel : scratch) {
+            channel.assign(reader.getMaxBlockSize(), 0.f);
+        }
+        for (int index = 0; ; index++) {
+            if (!reader.next(block, readError)) {
+                if (!readError.empty()) {
+                    error = "block " + juce::String(index) + ": " + juce::String(readError);
+                    return false;
+                }
+                break;
+            }
+            if (block.numChannels > static_cast<int>(scratch.size()) || block.numSamples > reader.getMaxBlockSize()) {
+                error = "block " + juce::String(index) + " is larger than the capture announced";
+                return false;
+            }
+            const bool nativeTablesUsed = (block.flags & SessionBlock::nativeFactoryTables) != 0;
+            const auto& tables = nativeTablesUsed ? nativeTables : resampledTables;
+            const auto& segmentTables = (block.flags & SessionBlock::nativeSegmentTable) != 0 ? nativeTables : resampledTables;
+            if (block.segmentTable >= 0 && block.segmentTable < static_cast<int>(segmentTables.size())) {
+                engine.lpc.buildExcitationSegmentAt(&segmentTables[block.segmentTable], block.segmentStart, block.segmentLength);
+            }
+
+            const float* inputs[2] = {};
+            float* outputs[2] = {};
+            const float* sidechains[2] = {};
+            const bool hasSidechain = (block.flags & SessionBlock::hasSidechain) != 0;
+            for (int ch = 0; ch < block.numChannels; ch++) {
+                const float* input = block.audio.data() + ch*block.numSamples;
+                std::copy(input, input + block.numSamples, scratch[ch].begin());
+                inputs[ch] = scratch[ch].data();
+                outputs[ch] = scratch[ch].data();
+                if (hasSidechain) {
+                    sidechains[ch] = block.audio.data() + (block.numChannels + ch)*block.numSamples;
+                }
+            }
+
+            // Timed as the plugin times a block in a capture
+            juce::ScopedNoDenormals noDenormals;
+            const auto start = Clock::now();
+            {
+                DSPTrace::Span span(trace, DSPTrace::processBlock, -1, block.numSamples);
+                engine.beginBlock(block.parameters, resolveExcitation(block, tables));
+                applyMidi(engine.lpc, block);
+                for (int ch = 0; ch < block.numChannels; ch++) {
+                    engine.processChannel(inputs[ch], outputs[ch], block.numSamples, ch, sidechains[ch]);
+                }
+                engine.endBlock();
+            }
+            const double replayUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+            const bool matched = hashAudio(outputs, block.numChannels, block.numSamples) == block.outputHash;
+            if (firstRun) {
+                BlockResult result;
+                result.index = index;
+                result.info = block;
+                result.info.audio.clear();
+                result.info.midi.clear();
+                result.info.midi.shrink_to_fit();
+                result.replayUs = replayUs;
+                result.capturedUs = block.processingNs/1000.0;
+                result.matched = matched;
+                results.push_back(result);
+            }
+            else if (index < static_cast<int>(results.size())) {
+                results[index].replayUs = std::min(results[index].replayUs, replayUs);
+                results[index].matched = results[index].matched && matched;
+            }
+        }
+        if (firstRun) {
+            engine.lpc.diagnostics.read(diagnostics);
+        }
+        return true;
+    }
+
+    // Spans of every run go to trace, when not null
+    void setTrace(DSPTrace* traceTo) { trace = traceTo; }
+
+    // What the engine counted during the first run
+    const DSPDiagnostics::Snapshot& getDiagnostics() const { return diagnostics; }
+
+private:
+    juce::SharedResourcePointer<ExcitationCache> excitationCache;
+    std::vector<std::vector<float>> scratch;
+    DSPDiagnostics::Snapshot diagnostics;
+    DSPTrace* trace = nullptr;
+};
+
+double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[juce::jmin(values.size() - 1, static_cast<size_t>(fraction*values.size()))];
+}
+
+Summary summarise(const std::vector<BlockResult>& results)
+{
+    Summary summary;
+    summary.blocks = static_cast<int>(results.size());
+    std::vector<double> replayed, captured;
+    for (const auto& result : results) {
+        if (!isReproducible(result.info)) {
+            summary.unreliable++;
+        }
+        else if (!result.matched) {
+            summary.mismatches++;
+            if (summary.firstMismatch < 0) {
+                summary.firstMismatch = result.index;
+            }
+        }
+        replayed.push_back(result.replayUs);
+        captured.push_back(result.capturedUs);
+        summary.replayMeanUs += result.replayUs;
+        summary.capturedMeanUs += result.capturedUs;
+        summary.replayMaxUs = juce::jmax(summary.replayMaxUs, result.replayUs);
+        summary.capturedMaxUs = juce::jmax(summary.capturedMaxUs, result.capturedUs);
+    }
+    if (!results.empty()) {
+        summary.replayMeanUs /= results.size();
+        summary.capturedMeanUs /= results.size();
+    }
+    summary.replayP99Us = percentile(replayed, 0.99);
+    summary.capturedP99Us = percentile(captured, 0.99);
+    return summary;
+}
+
+juce::String describeFlags(uint32_t flags)
+{
+    juce::StringArray names;
+    if (flags & SessionBlock::hasSidechain) names.add("sidechain");
+    if (flags & SessionBlock::bouncing) names.add("bouncing");
+    if (flags & SessionBlock::customExcitation) names.add("custom");
+    if (flags & SessionBlock::afterGap) names.add("after-gap");
+    if (flags & (SessionBlock::nativeFactoryTables | SessionBlock::nativeSegmentTable)) names.add("native-tables");
+    return names.isEmpty() ? juce::String("-") : names.joinIntoString(",");
+}
+
+void writeJson(std::ostream& out, const juce::String& capture, int repeat, const Summary& summary, const DSPDiagnostics::Snapshot& diagnostics,
+               const std::vector<const BlockResult*>& slowest)
+{
+    out << "{\n  \"tool\": \"lpmorph-replay\",\n  \"version\": 1,\n"
+        << "  \"capture\": " << juce::JSON::toString(capture).toStdString() << ",\n"
+        << "  \"repeat\": " << repeat << ",\n"
+        << "  \"blocks\": " << summary.blocks << ",\n"
+        << "  \"mismatches\": " << summary.mismatches << ",\n"
+        << "  \"unreliable_blocks\": " << summary.unreliable << ",\n"
+        << "  \"replay_us\": {\"mean\": " << summary.replayMeanUs << ", \"p99\": " << summary.replayP99Us << ", \"max\": " << summary.replayMaxUs << "},\n"
+        << "  \"captured_us\": {\"mean\": " << summary.capturedMeanUs << ", \"p99\": " << summary.capturedP99Us << ", \"max\": " << summary.capturedMaxUs << "},\n"
+        << "  \"diagnostics\": {";
+    for (int c = 0; c < DSPDiagnostics::numCounters; c++) {
+        auto counter = static_cast<DSPDiagnostics::Counter>(c);
+        out << (c == 0 ? "" : ", ") << "\"" << DSPDiagnostics::key(counter) << "\": " << diagnostics[counter];
+    }
+    out << "},\n"
+        << "  \"slowest\": [";
+    for (size_t i = 0; i < slowest.size(); i++) {
+        const auto& result = *slowest[i];
+        const auto& params = result.info.parameters;
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"block\": " << result.index << ", \"samples\": " << result.info.numSamples
+            << ", \"channels\": " << result.info.numChannels << ", \"flags\": " << result.info.flags
+            << ", \"replay_us\": " << result.replayUs << ", \"captured_us\": " << result.capturedUs
+            << ", \"matched\": " << (result.matched ? "true" : "false")
+            << ", \"ex_type\": " << params.exType << ", \"lpc_order\": " << params.lpcOrder
+            << ", \"frame_dur\": " << params.frameDur << "}";
+    }
+    out << (slowest.empty() ? "]\n}\n" : "\n  ]\n}\n");
+}
+
+void printUsage()
+{
+    std::cout << "usage: lpmorph-replay [options] <capture.lpcap>\n"
+                 "      --repeat N         replay N times, keeping each block's fastest time (default: 1)\n"
+                 "      --slowest N        blocks listed, slowest first (default: 10)\n"
+                 "      --json FILE        also write the results as JSON\n"
+                 "      --trace FILE       also write a Chrome trace of the replay's spans\n";
+}
+}
+
+int main(int argc, char* argv[])
+{
+    juce::String capture;
+    juce::String jsonPath;
+    juce::String tracePath;
+    int repeat = 1;
+    int numSlowest = 10;
+
+    for (int i = 1; i < argc; i++) {
+        juce::String arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if (arg == "--repeat" && hasValue) {
+            repeat = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+        }
+        else if (arg == "--slowest" && hasValue) {
+            numSlowest = juce::jmax(0, juce::String(argv[++i]).getIntValue());
+        }
+        else if (arg == "--json" && hasValue) {
+            jsonPath = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]).getFullPathName();
+        }
+        else if (arg == "--trace" && hasValue) {
+            tracePath = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]).getFullPathName();
+        }
+        else if (arg.startsWith("-") || capture.isNotEmpty()) {
+            printUsage();
+            return 1;
+        }
+        else {
+            capture = juce::File::getCurrentWorkingDirectory().getChildFile(arg).getFullPathName();
+        }
+    }
+    if (capture.isEmpty()) {
+        printUsage();
+        return 1;
+    }
+
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    Replay replay;
+    DSPTrace trace;
+    if (tracePath.isNotEmpty()) {
+        if (!trace.start(tracePath.toStdString())) {
+            std::cerr << "cannot write " << tracePath << std::endl;
+            return 1;
+        }
+        replay.setTrace(&trace);
+    }
+    std::vector<BlockResult> results;
+    for (int run = 0; run < repeat; run++) {
+        juce::String error;
+        if (!replay.run(capture, results, run == 0, error)) {
+            std::cerr << capture << ": " << error << std::endl;
+            return 1;
+        }
+    }
+
+    const auto summary = summarise(results);
+    std::vector<const BlockResult*> slowest;
+    for (const auto& result : results) {
+        slowest.push_back(&result);
+    }
+    std::sort(slowest.begin(), slowest.end(), [](const BlockResult* a, const BlockResult* b) { return a->replayUs > b->replayUs; });
+    slowest.resize(juce::jmin(slowest.size(), static_cast<size_t>(numSlowest)));
+
+    std::printf("%d blocks, %d mismatched", summary.blocks, summary.mismatches);
+    if (summary.firstMismatch >= 0) {
+        std::printf(" (first at block %d)", summary.firstMismatch);
+    }
+    if (summary.unreliable > 0) {
+        std::printf(", %d not comparable (after dropped blocks or with a custom excitation)", summary.unreliable);
+    }
+    std::printf("\n");
+    for (int c = 0; c < DSPDiagnostics::numCounters; c++) {
+        auto counter = static_cast<DSPDiagnostics::Counter>(c);
+        std::printf("%s%s %llu", c == 0 ? "" : ", ", DSPDiagnostics::label(counter),
+                    static_cast<unsigned long long>(replay.getDiagnostics()[counter]));
+    }
+    std::printf("\n%-10s %10s %10s %10s\n", "us", "mean", "p99", "max");
+    std::printf("%-10s %10.1f %10.1f %10.1f\n", "replayed", summary.replayMeanUs, summary.replayP99Us, summary.replayMaxUs);
+    std::printf("%-10s %10.1f %10.1f %10.1f\n", "captured", summary.capturedMeanUs, summary.capturedP99Us, summary.capturedMaxUs);
+    if (!slowest.empty()) {
+        std::printf("\nslowest blocks\n%8s %7s %3s %10s %10s %6s %5s %8s %s\n", "block", "samples", "ch", "replay_us", "capture_us", "exType",
+                    "order", "frame_ms", "flags");
+        for (const auto* result : slowest) {
+            const auto& params = result->info.parameters;
+            std::printf("%8d %7d %3d %10.1f %10.1f %6d %5d %8.1f %s%s\n", result->index, result->info.numSamples, result->info.numChannels,
+                        result->replayUs, result->capturedUs, params.exType, params.lpcOrder, params.frameDur,
+                        describeFlags(result->info.flags).toRawUTF8(), result->matched ? "" : " MISMATCH");
+        }
+    }
+
+    if (jsonPath.isNotEmpty()) {
+        std::ofstream json(jsonPath.toStdString());
+        writeJson(json, capture, repeat, summary, replay.getDiagnostics(), slowest);
+        if (!json) {
+            std::cerr << "cannot write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return summary.mismatches > 0 ? 2 : 0;
+}
@@ -0,0 +1,540 @@
+// Serves the LP Morph engine to other programs in a pipeline, without a
+// plugin host. Every stream gets its own engine, set up as the plugin sets
+// itself up, so the output matches the plugin's.
+//
+//   lpmorph-serve [options] --stdin             raw frames on stdin and stdout
+//   lpmorph-serve [options] --stdin --framed    messages on stdin and stdout
+//   lpmorph-serve [options] --socket PATH       messages from any number of
+//                                               clients on a Unix-domain socket
+//
+// Raw mode reads interleaved 32-bit float frames at --rate and --channels and
+// writes each processed run of frames back as soon as it has arrived, in
+// runs of at most one hop.
+//
+// Messages are a four-character type, a payload length as a 32-bit unsigned
+// integer and the payload, all little-endian:
+//
+//   OPEN  rate and channels as two uint32. Starts or restarts the stream;
+//         replied to with OPEN carrying the hop size and the latency in
+//         samples as two uint32.
+//   SET   "parameterID = value" as in lpmorph-render presets, before or
+//         between audio messages. Replied to with OK.
+//   AUDI  interleaved float frames, replied to with the same number of
+//         processed frames.
+//   BYE   ends the stream.
+//
+// Anything refused is answered with ERR and a message. The server adds no
+// buffering of its own, so clients sending a hop per AUDI message wait no
+// more than a hop for each reply. The audio itself comes back one frame
+// late, though, not one hop: the engine analyses frames of 1024 samples,
+// two hops, and overlap-adds their synthesis, so a sample's output is
+// complete only once the frame after it is in. That is the latency in the
+// OPEN reply, and the plugin reports the same to its host.
+//
+// Socket clients are served by a pool of worker threads: the main thread
+// polls every idle client and hands those with a message waiting to a
+// worker, which handles one message and hands the client back.
+//
+// With --metrics LABEL, every stream publishes its engine's metrics to
+// shared memory under LABEL from the time it is opened, for lpmorph-metrics.
+
+#include <JuceHeader.h>
+#include "RenderContext.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+// Large enough for a second of 32 channels at 384 kHz
+const juce::uint32 maxPayloadSize = 64 << 20;
+
+// Set from --metrics, before any stream is opened
+juce::String metricsLabel;
+
+struct Message {
+    char type[4];
+    juce::uint32 size = 0;
+    // Floats, so that audio can be processed where it was read
+    std::vector<float> payload;
+
+    bool is(const char* name) const { return memcmp(type, name, 4) == 0; }
+    char* bytes() { return reinterpret_cast<char*>(payload.data()); }
+};
+
+volatile sig_atomic_t stopRequested = 0;
+int stopPipe[2] = { -1, -1 };
+
+void requestStop(int)
+{
+    stopRequested = 1;
+    if (stopPipe[1] >= 0) {
+        char byte = 0;
+        (void) !write(stopPipe[1], &byte, 1);
+    }
+}
+
+bool readFully(int fd, void* data, size_t size)
+{
+    auto* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeFully(int fd, const void* data, size_t size)
+{
+    auto* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, bytes, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readMessage(int fd, Message& message)
+{
+    char header[8];
+    if (!readFully(fd, header, sizeof(header))) {
+        return false;
+    }
+    memcpy(message.type, header, 4);
+    message.size = juce::ByteOrder::littleEndianInt(header + 4);
+    if (message.size > maxPayloadSize) {
+        return false;
+    }
+    // Only grows, so a client streaming fixed-size blocks stops allocating
+    if (message.payload.size()*sizeof(float) < message.size) {
+        message.payload.resize((message.size + sizeof(float) - 1)/sizeof(float));
+    }
+    return readFully(fd, message.bytes(), message.size);
+}
+
+bool writeMessage(int fd, const char* type, const void* payload, juce::uint32 size)
+{
+    char header[8];
+    memcpy(header, type, 4);
+    auto littleEndianSize = juce::ByteOrder::swapIfBigEndian(size);
+    memcpy(header + 4, &littleEndianSize, 4);
+    return writeFully(fd, header, sizeof(header)) && (size == 0 || writeFully(fd, payload, size));
+}
+
+// One stream: an engine and the parameters it runs with
+class Session
+{
+public:
+    explicit Session(const RenderPreset& p) : preset(p) {}
+
+    bool isOpen() const { return engine != nullptr; }
+    int getNumChannels() const { return numChannels; }
+    int getHopSize() const { return engine->lpc.HOPSIZE; }
+    int getLatency() const { return engine->lpc.FRAMELEN; }
+
+    bool open(double rate, int channels, juce::String& error)
+    {
+        if (rate < 8000.0 || rate > 384000.0 || channels < 1 || channels > 32) {
+            error = "unsupported format: " + juce::String(rate) + " Hz, " + juce::String(channels) + " channels";
+            return false;
+        }
+        auto newContext = std::make_unique<RenderContext>(preset);
+        if (!newContext->prepareSampleRate(rate, error)) {
+            return false;
+        }
+        engine = std::make_unique<LPCEngine>(channels);
+        newContext->prepareEngine(*engine, rate);
+        // A new segment per engine, whose totals start from zero
+        if (metricsLabel.isNotEmpty()) {
+            if (metrics.start(metricsLabel.toStdString())) {
+                engine->metrics = &metrics;
+            }
+            else {
+                std::cerr << "cannot publish metrics" << std::endl;
+            }
+        }
+        context = std::move(newContext);
+        sampleRate = rate;
+        numChannels = channels;
+        return true;
+    }
+
+    bool set(const juce::String& setting, juce::String& error)
+    {
+        RenderPreset updated = preset;
+        if (!applyPresetSetting(setting, updated, error)) {
+            return false;
+        }
+        if (isOpen()) {
+            if (updated.excitationFile != preset.excitationFile || updated.parameters.exType != preset.parameters.exType) {
+                auto newContext = std::make_unique<RenderContext>(updated);
+                if (!newContext->prepareSampleRate(sampleRate, error)) {
+                    return false;
+                }
+                // Rebuilt while the previous excitation is still alive, so the
+                // segment cannot mistake a new table at a reused address for
+                // the one it holds
+                engine->buildExcitationSegment(newContext->getExcitation(sampleRate).table, updated.parameters);
+                context = std::move(newContext);
+            }
+            else {
+                context->setParameters(updated.parameters);
+                engine->buildExcitationSegment(context->getExcitation(sampleRate).table, updated.parameters);
+            }
+        }
+        preset = updated;
+        return true;
+    }
+
+    // Interleaved frames, processed in place
+    void process(float* frames, int numFrames)
+    {
+        if (numFrames <= 0) {
+            return;
+        }
+        context->beginBlock(*engine, sampleRate);
+        for (int ch = 0; ch < numChannels; ch++) {
+            engine->processChannel(frames + ch, frames + ch, numFrames, ch, nullptr, numChannels, numChannels);
+        }
+        engine->endBlock();
+    }
+
+private:
+    RenderPreset preset;
+    std::unique_ptr<RenderContext> context;
+    // Outlives the engine that points to it
+    MetricsPublisher metrics;
+    std::unique_ptr<LPCEngine> engine;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+};
+
+// Replies to one message on fd. Returns false when the stream is over.
+bool handleMessage(Session& session, Message& message, int fd)
+{
+    juce::String error;
+    if (message.is("OPEN")) {
+        if (message.size != 8) {
+            error = "OPEN takes a sample rate and a channel count";
+        }
+        else if (session.open(juce::ByteOrder::littleEndianInt(message.bytes()),
+                              static_cast<int>(juce::ByteOrder::littleEndianInt(message.bytes() + 4)), error)) {
+            juce::uint32 reply[2] = { juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint32>(session.getHopSize())),
+                                      juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint32>(session.getLatency())) };
+            return writeMessage(fd, "OPEN", reply, sizeof(reply));
+        }
+    }
+    else if (message.is("SET ")) {
+        if (session.set(juce::String::fromUTF8(message.bytes(), static_cast<int>(message.size)), error)) {
+            return writeMessage(fd, "OK  ", nullptr, 0);
+        }
+    }
+    else if (message.is("AUDI")) {
+        const juce::uint32 frameSize = static_cast<juce::uint32>(session.getNumChannels()*sizeof(float));
+        if (!session.isOpen()) {
+            error = "AUDI before OPEN";
+        }
+        else if (message.size % frameSize != 0) {
+            error = "AUDI must hold whole frames of " + juce::String(session.getNumChannels()) + " channels";
+        }
+        else {
+            session.process(message.payload.data(), static_cast<int>(message.size/frameSize));
+            return writeMessage(fd, "AUDI", message.payload.data(), message.size);
+        }
+    }
+    else if (message.is("BYE ")) {
+        return false;
+    }
+    else {
+        error = "unknown message " + juce::String(message.type, 4).quoted();
+    }
+    return writeMessage(fd, "ERR ", error.toRawUTF8(), static_cast<juce::uint32>(error.getNumBytesAsUTF8()));
+}
+
+int serveRaw(const RenderPreset& preset, double sampleRate, int numChannels)
+{
+    Session session(preset);
+    juce::String error;
+    if (!session.open(sampleRate, numChannels, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    const size_t frameSize = numChannels*sizeof(float);
+    std::vector<float> block(static_cast<size_t>(session.getHopSize()*numChannels));
+    auto* bytes = reinterpret_cast<char*>(block.data());
+    size_t filled = 0;
+    for (;;) {
+        // Whatever has arrived is processed at once, up to a hop
+        ssize_t n = read(STDIN_FILENO, bytes + filled, block.size()*sizeof(float) - filled);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        filled += static_cast<size_t>(n);
+        size_t numFrames = filled/frameSize;
+        session.process(block.data(), static_cast<int>(numFrames));
+        if (!writeFully(STDOUT_FILENO, bytes, numFrames*frameSize)) {
+            return 1;
+        }
+        // Keeps the start of a frame split across reads
+        memmove(bytes, bytes + numFrames*frameSize, filled - numFrames*frameSize);
+        filled -= numFrames*frameSize;
+    }
+    return 0;
+}
+
+int serveFramed(const RenderPreset& preset)
+{
+    Session session(preset);
+    Message message;
+    while (readMessage(STDIN_FILENO, message) && handleMessage(session, message, STDOUT_FILENO)) {
+    }
+    return 0;
+}
+
+struct Client {
+    Client(int socket, const RenderPreset& preset) : fd(socket), session(preset) {}
+    ~Client() { close(fd); }
+    int fd;
+    Session session;
+    Message message;
+    // Handed to a worker, and not polled until it comes back
+    bool busy = false;
+};
+
+int serveSocket(const juce::String& path, const RenderPreset& preset, int numThreads)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (path.getNumBytesAsUTF8() >= sizeof(address.sun_path)) {
+        std::cerr << "socket path too long: " << path << std::endl;
+        return 1;
+    }
+    strcpy(address.sun_path, path.toRawUTF8());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(address.sun_path);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        std::cerr << "cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    // Workers hand clients back through a pipe that wakes the poll, and a
+    // vanished client shows up as a failed write rather than a signal
+    int wakePipe[2];
+    if (pipe(wakePipe) != 0 || pipe(stopPipe) != 0) {
+        std::cerr << "cannot create pipes" << std::endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+
+    std::map<int, std::unique_ptr<Client>> clients;
+    std::mutex lock;
+    std::condition_variable clientReady;
+    std::deque<Client*> readyClients;
+    std::vector<std::pair<Client*, bool>> handledClients;
+    bool stopping = false;
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < numThreads; w++) {
+        workers.emplace_back([&] {
+            // The plugin renders with denormals flushed, and so must we to match it
+            juce::ScopedNoDenormals noDenormals;
+            for (;;) {
+                Client* client = nullptr;
+                {
+                    std::unique_lock<std::mutex> sl(lock);
+                    clientReady.wait(sl, [&] { return stopping || !readyClients.empty(); });
+                    if (readyClients.empty()) {
+                        return;
+                    }
+                    client = readyClients.front();
+                    readyClients.pop_front();
+                }
+                bool keep = readMessage(client->fd, client->message) && handleMessage(client->session, client->message, client->fd);
+                {
+                    const std::lock_guard<std::mutex> sl(lock);
+                    handledClients.emplace_back(client, keep);
+                }
+                char byte = 0;
+                (void) !write(wakePipe[1], &byte, 1);
+            }
+        });
+    }
+
+    std::cout << "lpmorph-serve listening on " << path << " with " << numThreads << " workers" << std::endl;
+    std::vector<pollfd> polled;
+    while (!stopRequested) {
+        polled.clear();
+        polled.push_back({ listener, POLLIN, 0 });
+        polled.push_back({ wakePipe[0], POLLIN, 0 });
+        polled.push_back({ stopPipe[0], POLLIN, 0 });
+        for (auto& entry : clients) {
+            if (!entry.second->busy) {
+                polled.push_back({ entry.first, POLLIN, 0 });
+            }
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (polled[1].revents != 0) {
+            char drained[64];
+            (void) !read(wakePipe[0], drained, sizeof(drained));
+            const std::lock_guard<std::mutex> sl(lock);
+            for (auto& handled : handledClients) {
+                handled.first->busy = false;
+                if (!handled.second) {
+                    clients.erase(handled.first->fd);
+                }
+            }
+            handledClients.clear();
+        }
+        for (size_t i = 3; i < polled.size(); i++) {
+            if (polled[i].revents != 0) {
+                auto* client = clients[polled[i].fd].get();
+                client->busy = true;
+                const std::lock_guard<std::mutex> sl(lock);
+                readyClients.push_back(client);
+                clientReady.notify_one();
+            }
+        }
+        if (polled[0].revents != 0) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                // A client that stops halfway through a message loses its worker
+                // for no longer than this
+                timeval timeout { 5, 0 };
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                clients[fd] = std::make_unique<Client>(fd, preset);
+            }
+        }
+    }
+
+    {
+        const std::lock_guard<std::mutex> sl(lock);
+        stopping = true;
+        readyClients.clear();
+    }
+    clientReady.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    clients.clear();
+    close(listener);
+    unlink(address.sun_path);
+    return 0;
+}
+
+void printUsage()
+{
+    std::cout << "usage: lpmorph-serve [options] --stdin | --socket PATH\n"
+                 "  -p, --preset FILE      parameters, one \"parameterID = value\" per line\n"
+                 "  -s, --set ID=VALUE     set one parameter, after the preset\n"
+                 "      --stdin            process stdin to stdout\n"
+                 "      --framed           with --stdin, exchange messages instead of raw frames\n"
+                 "      --socket PATH      serve clients on a Unix-domain socket\n"
+                 "  -r, --rate HZ          raw mode sample rate (default: 48000)\n"
+                 "  -c, --channels N       raw mode channels (default: 2)\n"
+                 "  -j, --threads N        socket worker threads (default: one per core)\n"
+                 "      --metrics LABEL    publish each stream's metrics for lpmorph-metrics\n"
+                 "Output is one frame (1024 samples, two hops) behind the input, the engine's\n"
+                 "latency; the server adds none, replying to each block as it arrives.\n";
+}
+}
+
+int main(int argc, char* argv[])
+{
+    RenderPreset preset;
+    juce::String error;
+    juce::String socketPath;
+    bool useStdin = false;
+    bool framed = false;
+    double sampleRate = 48000.0;
+    int numChannels = 2;
+    int numThreads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        juce::String arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if ((arg == "-p" || arg == "--preset") && hasValue) {
+            if (!loadPreset(juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]), preset, error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        }
+        else if ((arg == "-s" || arg == "--set") && hasValue) {
+            if (!applyPresetSetting(argv[++i], preset, error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--stdin") {
+            useStdin = true;
+        }
+        else if (arg == "--framed") {
+            framed = true;
+        }
+        else if (arg == "--socket" && hasValue) {
+            socketPath = argv[++i];
+        }
+        else if ((arg == "-r" || arg == "--rate") && hasValue) {
+            sampleRate = juce::String(argv[++i]).getDoubleValue();
+        }
+        else if ((arg == "-c" || arg == "--channels") && hasValue) {
+            numChannels = juce::String(argv[++i]).getIntValue();
+        }
+        else if ((arg == "-j" || arg == "--threads") && hasValue) {
+            numThreads = juce::String(argv[++i]).getIntValue();
+        }
+        else if (arg == "--metrics" && hasValue) {
+            metricsLabel = argv[++i];
+        }
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (useStdin == socketPath.isNotEmpty()) {
+        printUsage();
+        return 1;
+    }
+
+    if (useStdin) {
+        juce::ScopedNoDenormals noDenormals;
+        return framed ? serveFramed(preset) : serveRaw(preset, sampleRate, numChannels);
+    }
+    numThreads = numThreads > 0 ? numThreads : static_cast<int>(std::thread::hardware_concurrency());
+    return serveSocket(socketPath, preset, juce::jmax(1, numThreads));
+}